@@ -6,6 +6,9 @@
 
 #include <clientversion.h>
 #include <common/args.h>
+#include <crypto/flex/cnfiles/cnfn.h>
+#include <crypto/flex/sph/sph_dispatch.h>
+#include <crypto/sha3.h>
 #include <crypto/sha256.h>
 #include <util/fs.h>
 #include <util/strencodings.h>
@@ -64,6 +67,9 @@ int main(int argc, char** argv)
     ArgsManager argsman;
     SetupBenchArgs(argsman);
     SHA256AutoDetect();
+    SHA3AutoDetect();
+    CNFNAutoDetect();
+    SPHAutoDetect();
     std::string error;
     if (!argsman.ParseParameters(argc, argv, error)) {
         tfm::format(std::cerr, "Error parsing command line arguments: %s\n", error);
@@ -51,5 +51,32 @@ static void DeserializeAndCheckBlockTest(benchmark::Bench& bench)
     });
 }
 
+// Computing the txids and wtxids of a full block's transactions, one
+// transaction at a time or in one batched multi-lane pass.
+static void BlockTxHashes(benchmark::Bench& bench, bool batched)
+{
+    DataStream stream(benchmark::data::block413567);
+    CBlock block;
+    stream >> TX_WITH_WITNESS(block);
+    std::vector<CMutableTransaction> mtxs;
+    for (const auto& tx : block.vtx) mtxs.emplace_back(*tx);
+
+    bench.unit("block").run([&] {
+        std::vector<CMutableTransaction> txs{mtxs};
+        std::vector<CTransactionRef> refs;
+        if (batched) {
+            refs = MakeTransactionRefs(std::move(txs));
+        } else {
+            for (auto& tx : txs) refs.push_back(MakeTransactionRef(std::move(tx)));
+        }
+        assert(refs.back()->GetWitnessHash() == block.vtx.back()->GetWitnessHash());
+    });
+}
+
+static void BlockTxHashesSerial(benchmark::Bench& bench) { BlockTxHashes(bench, /*batched=*/false); }
+static void BlockTxHashesBatched(benchmark::Bench& bench) { BlockTxHashes(bench, /*batched=*/true); }
+
 BENCHMARK(DeserializeBlockTest, benchmark::PriorityLevel::HIGH);
 BENCHMARK(DeserializeAndCheckBlockTest, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTxHashesSerial, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BlockTxHashesBatched, benchmark::PriorityLevel::HIGH);
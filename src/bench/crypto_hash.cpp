@@ -12,6 +12,7 @@
 #include <crypto/sha512.h>
 #include <crypto/siphash.h>
 #include <hash.h>
+#include <primitives/block.h>
 #include <random.h>
 #include <tinyformat.h>
 #include <uint256.h>
@@ -90,6 +91,73 @@ static void SHA3_256_1M(benchmark::Bench& bench)
     });
 }
 
+static void SHA3_256D80_1024_STANDARD(benchmark::Bench& bench)
+{
+    bench.name(strprintf("%s using the '%s' SHA3 implementation", __func__, SHA3AutoDetect(sha3_implementation::STANDARD)));
+    std::vector<uint8_t> in(80 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    bench.batch(in.size()).unit("byte").run([&] {
+        SHA3_256d_Many(out.data(), in.data(), 80, 1024);
+    });
+    SHA3AutoDetect();
+}
+
+static void SHA3_256D80_1024_AVX2(benchmark::Bench& bench)
+{
+    bench.name(strprintf("%s using the '%s' SHA3 implementation", __func__, SHA3AutoDetect(sha3_implementation::USE_AVX2)));
+    std::vector<uint8_t> in(80 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    bench.batch(in.size()).unit("byte").run([&] {
+        SHA3_256d_Many(out.data(), in.data(), 80, 1024);
+    });
+    SHA3AutoDetect();
+}
+
+static void SHA3_256D80_1024_AVX512(benchmark::Bench& bench)
+{
+    bench.name(strprintf("%s using the '%s' SHA3 implementation", __func__, SHA3AutoDetect(sha3_implementation::USE_ALL)));
+    std::vector<uint8_t> in(80 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    bench.batch(in.size()).unit("byte").run([&] {
+        SHA3_256d_Many(out.data(), in.data(), 80, 1024);
+    });
+    SHA3AutoDetect();
+}
+
+static void SHA3_256D_80b_STREAM(benchmark::Bench& bench)
+{
+    CBlockHeader header;
+    bench.batch(80).unit("byte").run([&] {
+        ++header.nNonce;
+        ankerl::nanobench::doNotOptimizeAway((Hash3Writer{} << header).GetHash());
+    });
+}
+
+static void SHA3_256D_80b_FIXED(benchmark::Bench& bench)
+{
+    CBlockHeader header;
+    bench.batch(80).unit("byte").run([&] {
+        ++header.nNonce;
+        ankerl::nanobench::doNotOptimizeAway(header.GetHash());
+    });
+}
+
+static void SHA3_256D_32b_STREAM(benchmark::Bench& bench)
+{
+    uint256 in;
+    bench.batch(in.size()).unit("byte").run([&] {
+        in = (Hash3Writer{} << in).GetHash();
+    });
+}
+
+static void SHA3_256D_32b_FIXED(benchmark::Bench& bench)
+{
+    uint256 in;
+    bench.batch(in.size()).unit("byte").run([&] {
+        SHA3_256d_32(in.data(), in.data());
+    });
+}
+
 static void SHA256_32b_STANDARD(benchmark::Bench& bench)
 {
     bench.name(strprintf("%s using the '%s' SHA256 implementation", __func__, SHA256AutoDetect(sha256_implementation::STANDARD)));
@@ -248,6 +316,10 @@ BENCHMARK(SHA256_AVX2, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA256_SHANI, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA512, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA3_256_1M, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D_80b_STREAM, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D_80b_FIXED, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D_32b_STREAM, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D_32b_FIXED, benchmark::PriorityLevel::HIGH);
 
 BENCHMARK(SHA256_32b_STANDARD, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA256_32b_SSE4, benchmark::PriorityLevel::HIGH);
@@ -258,6 +330,9 @@ BENCHMARK(SHA256D64_1024_STANDARD, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA256D64_1024_SSE4, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA256D64_1024_AVX2, benchmark::PriorityLevel::HIGH);
 BENCHMARK(SHA256D64_1024_SHANI, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D80_1024_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D80_1024_AVX2, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SHA3_256D80_1024_AVX512, benchmark::PriorityLevel::HIGH);
 
 BENCHMARK(MuHash, benchmark::PriorityLevel::HIGH);
 BENCHMARK(MuHashMul, benchmark::PriorityLevel::HIGH);
@@ -0,0 +1,99 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <common/args.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <uint256.h>
+#include <util/chaintype.h>
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+//! Headers in the synthetic chain, spaced 38 seconds apart on average like the current mainnet target.
+static constexpr int CHAIN_LENGTH{2'000'000};
+static constexpr int64_t SPACING{38};
+
+namespace {
+/** A mainnet-shaped header chain whose bits follow the difficulty rules, built once. */
+struct SyntheticChain {
+    const Consensus::Params& params;
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> blocks;
+
+    explicit SyntheticChain(const Consensus::Params& consensus) : params{consensus}, hashes(CHAIN_LENGTH), blocks(CHAIN_LENGTH)
+    {
+        FastRandomContext rng{/*fDeterministic=*/true};
+        for (int i = 0; i < CHAIN_LENGTH; ++i) {
+            CBlockHeader header;
+            header.nTime = i ? blocks[i - 1].nTime + rng.randrange(2 * SPACING + 1) : 1700000000;
+            header.nBits = i ? GetNextWorkRequired(&blocks[i - 1], &header, params) : 0x1e0fffff;
+            hashes[i] = uint256{uint64_t(i)};
+            blocks[i].phashBlock = &hashes[i];
+            blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+            blocks[i].nHeight = i;
+            blocks[i].nTime = header.nTime;
+            blocks[i].nBits = header.nBits;
+            blocks[i].BuildSkip();
+        }
+    }
+
+    CBlockHeader Header(int height) const
+    {
+        CBlockHeader header;
+        header.nVersion = 0x20008000;
+        header.nTime = blocks[height].nTime;
+        header.nBits = blocks[height].nBits;
+        return header;
+    }
+
+    static const SyntheticChain& Get()
+    {
+        static const auto chain_params{CreateChainParams(ArgsManager{}, ChainType::MAIN)};
+        static const SyntheticChain chain{chain_params->GetConsensus()};
+        return chain;
+    }
+};
+} // namespace
+
+// Checks the bits of every header of the chain by asking GetNextWorkRequired
+// about its parent, which looks the window start up among the ancestors.
+static void DifficultyAncestorLookup(benchmark::Bench& bench)
+{
+    const SyntheticChain& chain{SyntheticChain::Get()};
+    bench.batch(CHAIN_LENGTH - 1).unit("header").run([&] {
+        bool ok{true};
+        for (int i = 1; i < CHAIN_LENGTH; ++i) {
+            const CBlockHeader header{chain.Header(i)};
+            ok &= GetNextWorkRequired(&chain.blocks[i - 1], &header, chain.params) == header.nBits;
+        }
+        assert(ok);
+    });
+}
+
+// Checks the same headers through a DifficultyContext connected header by
+// header, as AcceptBlockHeader does for a run of new headers.
+static void DifficultyContextConnect(benchmark::Bench& bench)
+{
+    const SyntheticChain& chain{SyntheticChain::Get()};
+    bench.batch(CHAIN_LENGTH - 1).unit("header").run([&] {
+        DifficultyContext context{chain.params};
+        context.Reset(chain.blocks[0]);
+        bool ok{true};
+        for (int i = 1; i < CHAIN_LENGTH; ++i) {
+            const CBlockHeader header{chain.Header(i)};
+            ok &= context.GetNextWorkRequired(header) == header.nBits;
+            context.Connect(header, chain.hashes[i]);
+        }
+        assert(ok);
+    });
+}
+
+BENCHMARK(DifficultyAncestorLookup, benchmark::PriorityLevel::LOW);
+BENCHMARK(DifficultyContextConnect, benchmark::PriorityLevel::LOW);
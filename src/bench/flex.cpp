@@ -0,0 +1,238 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/common.h>
+#include <crypto/flex/cnfiles/cnfn.h>
+#include <crypto/flex/flex.h>
+#include <crypto/flex/sph/sph_blake.h>
+#include <crypto/flex/sph/sph_bmw.h>
+#include <crypto/flex/sph/sph_cubehash.h>
+#include <crypto/flex/sph/sph_dispatch.h>
+#include <crypto/flex/sph/sph_echo.h>
+#include <crypto/flex/sph/sph_fugue.h>
+#include <crypto/flex/sph/sph_groestl.h>
+#include <crypto/flex/sph/sph_hamsi.h>
+#include <crypto/flex/sph/sph_keccak.h>
+#include <crypto/flex/sph/sph_luffa.h>
+#include <crypto/flex/sph/sph_shabal.h>
+#include <crypto/flex/sph/sph_shavite.h>
+#include <crypto/flex/sph/sph_simd.h>
+#include <crypto/flex/sph/sph_skein.h>
+#include <crypto/flex/sph/sph_whirlpool.h>
+#include <pow_cache.h>
+#include <primitives/block.h>
+#include <span.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// The Flex proof of work hashes an 80-byte header with Keccak-512, runs 15
+// sph primitives and 3 CryptoNight variants on the 64-byte chaining value, and
+// finishes with Keccak-256. These benchmarks time each stage on its own and
+// the whole path, so changes to any part of it can be compared.
+
+static CBlockHeader FlexHeader()
+{
+    CBlockHeader header;
+    header.nVersion = 0x20008000;
+    header.hashPrevBlock = uint256S("0000000000000000000000000000000000000000000000000000000000000001");
+    header.hashMerkleRoot = uint256S("0000000000000000000000000000000000000000000000000000000000000002");
+    header.nTime = 1700000000;
+    header.nBits = 0x1d00ffff;
+    return header;
+}
+
+static std::array<unsigned char, 80> SerializeHeader(const CBlockHeader& header)
+{
+    std::array<unsigned char, 80> bytes;
+    DataStream stream{};
+    stream << header;
+    std::copy(UCharCast(stream.data()), UCharCast(stream.data()) + bytes.size(), bytes.begin());
+    return bytes;
+}
+
+static void FlexHash(benchmark::Bench& bench)
+{
+    auto header{SerializeHeader(FlexHeader())};
+    unsigned char hash[32];
+    uint32_t nonce{0};
+    bench.unit("header").run([&] {
+        WriteLE32(header.data() + 76, ++nonce);
+        flex_hash(reinterpret_cast<const char*>(header.data()), header.size(), hash);
+        ankerl::nanobench::doNotOptimizeAway(hash);
+    });
+}
+
+static void FlexHashMany(benchmark::Bench& bench)
+{
+    static const size_t HEADERS = 16;
+    std::array<unsigned char, 80 * HEADERS> headers;
+    const auto header{SerializeHeader(FlexHeader())};
+    for (size_t i = 0; i < HEADERS; ++i) std::copy(header.begin(), header.end(), headers.begin() + 80 * i);
+    unsigned char hashes[32 * HEADERS];
+    uint32_t nonce{0};
+    bench.batch(HEADERS).unit("header").run([&] {
+        for (size_t i = 0; i < HEADERS; ++i) WriteLE32(headers.data() + 80 * i + 76, ++nonce);
+        flex_hash_many(reinterpret_cast<const char*>(headers.data()), 80, HEADERS, hashes);
+        ankerl::nanobench::doNotOptimizeAway(hashes);
+    });
+}
+
+// Entry and exit rounds
+
+static void FlexKeccak512_80b(benchmark::Bench& bench)
+{
+    const auto header{SerializeHeader(FlexHeader())};
+    unsigned char hash[64];
+    bench.unit("header").run([&] {
+        sph_keccak512_context ctx;
+        sph_keccak512_init(&ctx);
+        sph_keccak512(&ctx, header.data(), header.size());
+        sph_keccak512_close(&ctx, hash);
+        ankerl::nanobench::doNotOptimizeAway(hash);
+    });
+}
+
+static void FlexKeccak256_64b(benchmark::Bench& bench)
+{
+    unsigned char hash[64] = {1};
+    bench.unit("hash").run([&] {
+        sph_keccak256_context ctx;
+        sph_keccak256_init(&ctx);
+        sph_keccak256(&ctx, hash, 64);
+        sph_keccak256_close(&ctx, hash);
+        ankerl::nanobench::doNotOptimizeAway(hash);
+    });
+}
+
+// sph primitives, chained on their own 64-byte output as in Flex
+
+template <typename Context, void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+static void SPHHash(benchmark::Bench& bench)
+{
+    unsigned char hash[64] = {1};
+    bench.unit("hash").run([&] {
+        Context ctx;
+        Init(&ctx);
+        Update(&ctx, hash, sizeof(hash));
+        Close(&ctx, hash);
+    });
+    ankerl::nanobench::doNotOptimizeAway(hash);
+}
+
+template <typename Context, void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+static void SPHHashImplementation(benchmark::Bench& bench, const char* name, sph_implementation::UseImplementation use_implementation)
+{
+    bench.name(strprintf("%s using the '%s' sph implementation", name, SPHAutoDetect(use_implementation)));
+    SPHHash<Context, Init, Update, Close>(bench);
+    SPHAutoDetect();
+}
+
+static void SPH_BLAKE512_64b(benchmark::Bench& bench) { SPHHash<sph_blake512_context, sph_blake512_init, sph_blake512, sph_blake512_close>(bench); }
+static void SPH_BMW512_64b(benchmark::Bench& bench) { SPHHash<sph_bmw512_context, sph_bmw512_init, sph_bmw512, sph_bmw512_close>(bench); }
+static void SPH_GROESTL512_64b(benchmark::Bench& bench) { SPHHash<sph_groestl512_context, sph_groestl512_init, sph_groestl512, sph_groestl512_close>(bench); }
+static void SPH_KECCAK512_64b(benchmark::Bench& bench) { SPHHash<sph_keccak512_context, sph_keccak512_init, sph_keccak512, sph_keccak512_close>(bench); }
+static void SPH_SKEIN512_64b(benchmark::Bench& bench) { SPHHash<sph_skein512_context, sph_skein512_init, sph_skein512, sph_skein512_close>(bench); }
+static void SPH_SIMD512_64b(benchmark::Bench& bench) { SPHHash<sph_simd512_context, sph_simd512_init, sph_simd512, sph_simd512_close>(bench); }
+static void SPH_HAMSI512_64b(benchmark::Bench& bench) { SPHHash<sph_hamsi512_context, sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close>(bench); }
+static void SPH_FUGUE512_64b(benchmark::Bench& bench) { SPHHash<sph_fugue512_context, sph_fugue512_init, sph_fugue512, sph_fugue512_close>(bench); }
+static void SPH_SHABAL512_64b(benchmark::Bench& bench) { SPHHash<sph_shabal512_context, sph_shabal512_init, sph_shabal512, sph_shabal512_close>(bench); }
+static void SPH_WHIRLPOOL_64b(benchmark::Bench& bench) { SPHHash<sph_whirlpool_context, sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close>(bench); }
+
+static void SPH_LUFFA512_64b_STANDARD(benchmark::Bench& bench) { SPHHashImplementation<sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close>(bench, __func__, sph_implementation::STANDARD); }
+static void SPH_LUFFA512_64b(benchmark::Bench& bench) { SPHHashImplementation<sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close>(bench, __func__, sph_implementation::USE_ALL); }
+static void SPH_CUBEHASH512_64b_STANDARD(benchmark::Bench& bench) { SPHHashImplementation<sph_cubehash512_context, sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>(bench, __func__, sph_implementation::STANDARD); }
+static void SPH_CUBEHASH512_64b(benchmark::Bench& bench) { SPHHashImplementation<sph_cubehash512_context, sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>(bench, __func__, sph_implementation::USE_ALL); }
+static void SPH_SHAVITE512_64b_STANDARD(benchmark::Bench& bench) { SPHHashImplementation<sph_shavite512_context, sph_shavite512_init, sph_shavite512, sph_shavite512_close>(bench, __func__, sph_implementation::STANDARD); }
+static void SPH_SHAVITE512_64b(benchmark::Bench& bench) { SPHHashImplementation<sph_shavite512_context, sph_shavite512_init, sph_shavite512, sph_shavite512_close>(bench, __func__, sph_implementation::USE_ALL); }
+static void SPH_ECHO512_64b_STANDARD(benchmark::Bench& bench) { SPHHashImplementation<sph_echo512_context, sph_echo512_init, sph_echo512, sph_echo512_close>(bench, __func__, sph_implementation::STANDARD); }
+static void SPH_ECHO512_64b(benchmark::Bench& bench) { SPHHashImplementation<sph_echo512_context, sph_echo512_init, sph_echo512, sph_echo512_close>(bench, __func__, sph_implementation::USE_ALL); }
+
+// CryptoNight variants, on the 64-byte chaining value as in Flex
+
+template <void (*Hash)(const char*, char*, uint32_t, int)>
+static void CNFNHash(benchmark::Bench& bench, const char* name, cnfn_implementation::UseImplementation use_implementation)
+{
+    bench.name(strprintf("%s using the '%s' CryptoNight implementation", name, CNFNAutoDetect(use_implementation)));
+    char hash[64] = {1};
+    bench.unit("hash").run([&] {
+        Hash(hash, hash, 64, 1);
+    });
+    ankerl::nanobench::doNotOptimizeAway(hash);
+    CNFNAutoDetect();
+}
+
+static void CNFN_DARK(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_dark_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_DARKLITE(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_darklite_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_FAST(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_cnfast_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_LITE(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_cnlite_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_TURTLE(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_turtle_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_TURTLELITE(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_turtlelite_hash>(bench, __func__, cnfn_implementation::USE_ALL); }
+static void CNFN_DARK_STANDARD(benchmark::Bench& bench) { CNFNHash<crypto::cnfn_dark_hash>(bench, __func__, cnfn_implementation::STANDARD); }
+
+// CBlockHeader::GetPoWHash through the PoW cache. Cold runs change the nonce
+// every time, so each lookup misses and computes Flex; warm runs repeat one
+// header, cached up front.
+
+static void GetPoWHashCold(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    CBlockHeader header{FlexHeader()};
+    bench.unit("header").run([&] {
+        ++header.nNonce;
+        ankerl::nanobench::doNotOptimizeAway(header.GetPoWHash());
+    });
+}
+
+static void GetPoWHashWarm(benchmark::Bench& bench)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    const CBlockHeader header{FlexHeader()};
+    // Lookups never insert, so seed the cache the way validation does
+    PowCache::Instance().Put(header.GetHash(), header.ComputePoWHash());
+    bench.unit("header").run([&] {
+        ankerl::nanobench::doNotOptimizeAway(header.GetPoWHash());
+    });
+}
+
+BENCHMARK(FlexHash, benchmark::PriorityLevel::HIGH);
+BENCHMARK(FlexHashMany, benchmark::PriorityLevel::HIGH);
+BENCHMARK(FlexKeccak512_80b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(FlexKeccak256_64b, benchmark::PriorityLevel::HIGH);
+
+BENCHMARK(SPH_BLAKE512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_BMW512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_GROESTL512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_KECCAK512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_SKEIN512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_LUFFA512_64b_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_LUFFA512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_CUBEHASH512_64b_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_CUBEHASH512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_SHAVITE512_64b_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_SHAVITE512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_SIMD512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_ECHO512_64b_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_ECHO512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_HAMSI512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_FUGUE512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_SHABAL512_64b, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SPH_WHIRLPOOL_64b, benchmark::PriorityLevel::HIGH);
+
+BENCHMARK(CNFN_DARK_STANDARD, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_DARK, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_DARKLITE, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_FAST, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_LITE, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_TURTLE, benchmark::PriorityLevel::HIGH);
+BENCHMARK(CNFN_TURTLELITE, benchmark::PriorityLevel::HIGH);
+
+BENCHMARK(GetPoWHashCold, benchmark::PriorityLevel::HIGH);
+BENCHMARK(GetPoWHashWarm, benchmark::PriorityLevel::HIGH);
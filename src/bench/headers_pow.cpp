@@ -0,0 +1,56 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <common/system.h>
+#include <consensus/params.h>
+#include <primitives/block.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <vector>
+
+//! Headers per HEADERS-sized batch. Kept small because each Flex hash is expensive.
+static const size_t HEADERS = 16;
+
+// Measures HasValidProofOfWork throughput over Flex headers for a given number
+// of additional worker threads. Nonces change on every run so each header is a
+// PoW cache miss, as during headers sync.
+static void HeadersPoW(benchmark::Bench& bench, int worker_threads_num)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+
+    // A target wide enough that practically every header passes, so early abort
+    // never shortens a run.
+    Consensus::Params params{Params().GetConsensus()};
+    params.powLimit = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+
+    std::vector<CBlockHeader> headers(HEADERS);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        headers[i].nVersion = 0x20008000;
+        headers[i].nTime = 1700000000 + i;
+        headers[i].nBits = 0x2100ffff;
+    }
+
+    CCheckQueue<CHeaderPoWCheck> queue{/*batch_size=*/8, worker_threads_num, "powcheck"};
+    uint32_t nonce{0};
+    bench.batch(HEADERS).unit("header").run([&] {
+        for (CBlockHeader& header : headers) header.nNonce = ++nonce;
+        ankerl::nanobench::doNotOptimizeAway(HasValidProofOfWork(headers, params, &queue));
+    });
+}
+
+static void HeadersPoWSerial(benchmark::Bench& bench) { HeadersPoW(bench, 0); }
+static void HeadersPoW2Threads(benchmark::Bench& bench) { HeadersPoW(bench, std::clamp(GetNumCores() - 1, 0, 1)); }
+static void HeadersPoW4Threads(benchmark::Bench& bench) { HeadersPoW(bench, std::clamp(GetNumCores() - 1, 0, 3)); }
+static void HeadersPoWAllCores(benchmark::Bench& bench) { HeadersPoW(bench, std::max(0, GetNumCores() - 1)); }
+
+BENCHMARK(HeadersPoWSerial, benchmark::PriorityLevel::HIGH);
+BENCHMARK(HeadersPoW2Threads, benchmark::PriorityLevel::HIGH);
+BENCHMARK(HeadersPoW4Threads, benchmark::PriorityLevel::HIGH);
+BENCHMARK(HeadersPoWAllCores, benchmark::PriorityLevel::HIGH);
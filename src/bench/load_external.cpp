@@ -6,6 +6,9 @@
 #include <bench/data.h>
 #include <chainparams.h>
 #include <clientversion.h>
+#include <consensus/validation.h>
+#include <primitives/block.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <util/chaintype.h>
 #include <validation.h>
@@ -61,4 +64,42 @@ static void LoadExternalBlockFile(benchmark::Bench& bench)
     fs::remove(blkfile);
 }
 
+/**
+ * Measures -reindex throughput: a regtest chain mined up front is written to a
+ * block file, which is then imported into a fresh chainstate and connected, as
+ * ImportBlocks() does. Unlike the benchmark above, each block's parent is
+ * known, so every block goes through the full read, decode and connect
+ * pipeline.
+ */
+static void LoadExternalBlockFileChain(benchmark::Bench& bench)
+{
+    constexpr int CHAIN_LENGTH{300};
+    const auto chain_setup{MakeNoLogFileContext<TestChain100Setup>()};
+    chain_setup->mineBlocks(CHAIN_LENGTH - chain_setup->m_node.chainman->ActiveHeight());
+
+    const fs::path blkfile{chain_setup->m_path_root / "blk.dat"};
+    {
+        AutoFile file{fsbridge::fopen(blkfile, "wb+")};
+        const auto& chainman{*chain_setup->m_node.chainman};
+        LOCK(cs_main);
+        for (int height{1}; height <= chainman.ActiveHeight(); ++height) {
+            CBlock block;
+            assert(chainman.m_blockman.ReadBlockFromDisk(block, *chainman.ActiveChain()[height]));
+            file << chainman.GetParams().MessageStart() << static_cast<uint32_t>(GetSerializeSize(TX_WITH_WITNESS(block)));
+            file << TX_WITH_WITNESS(block);
+        }
+    }
+
+    bench.batch(CHAIN_LENGTH).unit("block").run([&] {
+        const auto testing_setup{MakeNoLogFileContext<const TestingSetup>(ChainType::REGTEST)};
+        AutoFile file{fsbridge::fopen(blkfile, "rb")};
+        testing_setup->m_node.chainman->LoadExternalBlockFile(file);
+        BlockValidationState state;
+        assert(testing_setup->m_node.chainman->ActiveChainstate().ActivateBestChain(state));
+        assert(WITH_LOCK(cs_main, return testing_setup->m_node.chainman->ActiveHeight()) == CHAIN_LENGTH);
+    });
+    fs::remove(blkfile);
+}
+
 BENCHMARK(LoadExternalBlockFile, benchmark::PriorityLevel::HIGH);
+BENCHMARK(LoadExternalBlockFileChain, benchmark::PriorityLevel::HIGH);
@@ -0,0 +1,80 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <pow_cache.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+
+#include <thread>
+#include <vector>
+
+//! Operations per thread and run; large enough to amortize thread start-up.
+static const size_t OPS = 20000;
+static const int THREADS = 4;
+
+static std::vector<uint256> RandomKeys(size_t count)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    std::vector<uint256> keys(count);
+    for (auto& key : keys) key = rng.rand256();
+    return keys;
+}
+
+// Inserts fresh entries from several threads into a cache persisted in the
+// datadir, as header sync does. Each run commits once, like a HEADERS batch.
+static void PowCacheInsert(benchmark::Bench& bench, int threads)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    PowCache cache{DEFAULT_POW_CACHE_SIZE << 20, testing_setup->m_args.GetDataDirNet() / POW_CACHE_FILENAME};
+    const auto keys{RandomKeys(OPS * threads)};
+    uint64_t round{0};
+
+    bench.batch(OPS * threads).unit("insert").run([&] {
+        ++round;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (size_t i = t * OPS; i < (t + 1) * OPS; ++i) {
+                    uint256 key{keys[i]};
+                    key.data()[0] ^= round;
+                    key.data()[1] ^= round >> 8;
+                    cache.Put(key, keys[i]);
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        cache.Commit();
+    });
+}
+
+// Looks up cached entries from several threads, as header and block
+// validation threads do for headers they have seen before.
+static void PowCacheLookup(benchmark::Bench& bench, int threads)
+{
+    PowCache cache{DEFAULT_POW_CACHE_SIZE << 20, /*path=*/{}};
+    const auto keys{RandomKeys(OPS)};
+    for (const auto& key : keys) cache.Put(key, key);
+
+    bench.batch(OPS * threads).unit("lookup").run([&] {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&] {
+                for (const auto& key : keys) ankerl::nanobench::doNotOptimizeAway(cache.Get(key));
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    });
+}
+
+static void PowCacheInsertSingle(benchmark::Bench& bench) { PowCacheInsert(bench, 1); }
+static void PowCacheInsertConcurrent(benchmark::Bench& bench) { PowCacheInsert(bench, THREADS); }
+static void PowCacheLookupSingle(benchmark::Bench& bench) { PowCacheLookup(bench, 1); }
+static void PowCacheLookupConcurrent(benchmark::Bench& bench) { PowCacheLookup(bench, THREADS); }
+
+BENCHMARK(PowCacheInsertSingle, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PowCacheInsertConcurrent, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PowCacheLookupSingle, benchmark::PriorityLevel::HIGH);
+BENCHMARK(PowCacheLookupConcurrent, benchmark::PriorityLevel::HIGH);
@@ -5,10 +5,17 @@
 #include <bench/bench.h>
 #include <bench/data.h>
 
+#include <arith_uint256.h>
+#include <chainparams.h>
 #include <consensus/validation.h>
 #include <node/blockstorage.h>
+#include <netmessagemaker.h>
+#include <node/kernel_notifications.h>
+#include <pow.h>
+#include <protocol.h>
 #include <streams.h>
 #include <test/util/setup_common.h>
+#include <tinyformat.h>
 #include <util/chaintype.h>
 #include <validation.h>
 
@@ -49,5 +56,112 @@ static void ReadRawBlockFromDiskTest(benchmark::Bench& bench)
     });
 }
 
+// Reads a Flex block back for a known block hash, as when serving getdata or
+// reconnecting blocks, either trusting the indexed header or re-checking its
+// proof of work on every read.
+static void ReadBlockFromDiskIndexed(benchmark::Bench& bench, bool paranoid_block_reads)
+{
+    const auto testing_setup{MakeNoLogFileContext<BasicTestingSetup>()};
+    auto& node{testing_setup->m_node};
+    node::KernelNotifications notifications{*Assert(node.shutdown), node.exit_status, *Assert(node.warnings)};
+    const node::BlockManager::Options blockman_opts{
+        .chainparams = Params(),
+        .paranoid_block_reads = paranoid_block_reads,
+        .blocks_dir = testing_setup->m_args.GetBlocksDirPath(),
+        .notifications = notifications,
+    };
+    node::BlockManager blockman{*Assert(node.shutdown), blockman_opts};
+
+    DataStream stream{benchmark::data::block413567};
+    CBlock block;
+    stream >> TX_WITH_WITNESS(block);
+    block.nVersion = 0x20008000;
+    block.nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+    while (!CheckProofOfWork(block.GetPoWHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+
+    const auto pos{blockman.SaveBlockToDisk(block, 0)};
+    const uint256 hash{block.GetHash()};
+
+    CBlock read_block;
+    bench.run([&] {
+        const auto success{blockman.ReadBlockFromDisk(read_block, pos, hash)};
+        assert(success);
+    });
+}
+
+static void ReadBlockFromDiskTrusted(benchmark::Bench& bench) { ReadBlockFromDiskIndexed(bench, /*paranoid_block_reads=*/false); }
+static void ReadBlockFromDiskParanoid(benchmark::Bench& bench) { ReadBlockFromDiskIndexed(bench, /*paranoid_block_reads=*/true); }
+
+// Serves a block to a peer from its bytes on disk, read with file I/O or from a
+// mapped block file and decoded straight into the network message.
+static void ServeRawBlock(benchmark::Bench& bench, size_t max_mapped_block_files)
+{
+    const auto testing_setup{MakeNoLogFileContext<BasicTestingSetup>()};
+    auto& node{testing_setup->m_node};
+    node::KernelNotifications notifications{*Assert(node.shutdown), node.exit_status, *Assert(node.warnings)};
+    const node::BlockManager::Options blockman_opts{
+        .chainparams = Params(),
+        .max_mapped_block_files = max_mapped_block_files,
+        .blocks_dir = testing_setup->m_args.GetBlocksDirPath(),
+        .notifications = notifications,
+    };
+    node::BlockManager blockman{*Assert(node.shutdown), blockman_opts};
+
+    DataStream stream{benchmark::data::block413567};
+    CBlock block;
+    stream >> TX_WITH_WITNESS(block);
+    const auto pos{blockman.SaveBlockToDisk(block, 0)};
+
+    bench.run([&] {
+        node::RawBlock raw;
+        const auto success{blockman.ReadRawBlockFromDisk(raw, pos)};
+        assert(success);
+        const CSerializedNetMsg msg{NetMsg::Make(NetMsgType::BLOCK, raw)};
+        ankerl::nanobench::doNotOptimizeAway(msg.data.size());
+    });
+}
+
+static void ServeRawBlockFileIO(benchmark::Bench& bench) { ServeRawBlock(bench, /*max_mapped_block_files=*/0); }
+static void ServeRawBlockMapped(benchmark::Bench& bench) { ServeRawBlock(bench, /*max_mapped_block_files=*/1); }
+
+// Reads a block back for a known block hash, stored as is or compressed as
+// with -compressblocks. The bytes the block takes on disk are added to the
+// benchmark's name.
+static void ReadBlockFromDiskStored(benchmark::Bench& bench, bool compress_blocks)
+{
+    const auto testing_setup{MakeNoLogFileContext<BasicTestingSetup>()};
+    auto& node{testing_setup->m_node};
+    node::KernelNotifications notifications{*Assert(node.shutdown), node.exit_status, *Assert(node.warnings)};
+    const node::BlockManager::Options blockman_opts{
+        .chainparams = Params(),
+        .compress_blocks = compress_blocks,
+        .blocks_dir = testing_setup->m_args.GetBlocksDirPath(),
+        .notifications = notifications,
+    };
+    node::BlockManager blockman{*Assert(node.shutdown), blockman_opts};
+
+    DataStream stream{benchmark::data::block413567};
+    CBlock block;
+    stream >> TX_WITH_WITNESS(block);
+    const auto pos{blockman.SaveBlockToDisk(block, 0)};
+    const uint256 hash{block.GetHash()};
+    bench.name(strprintf("%s (%u bytes on disk)", bench.name(), blockman.CalculateCurrentUsage()));
+
+    CBlock read_block;
+    bench.run([&] {
+        const auto success{blockman.ReadBlockFromDisk(read_block, pos, hash)};
+        assert(success);
+    });
+}
+
+static void ReadBlockFromDiskUncompressed(benchmark::Bench& bench) { ReadBlockFromDiskStored(bench, /*compress_blocks=*/false); }
+static void ReadBlockFromDiskCompressed(benchmark::Bench& bench) { ReadBlockFromDiskStored(bench, /*compress_blocks=*/true); }
+
 BENCHMARK(ReadBlockFromDiskTest, benchmark::PriorityLevel::HIGH);
 BENCHMARK(ReadRawBlockFromDiskTest, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ReadBlockFromDiskTrusted, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ReadBlockFromDiskParanoid, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ServeRawBlockFileIO, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ServeRawBlockMapped, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ReadBlockFromDiskUncompressed, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ReadBlockFromDiskCompressed, benchmark::PriorityLevel::HIGH);
@@ -5,6 +5,7 @@
 #include <config/bitcoin-config.h> // IWYU pragma: keep
 
 #include <arith_uint256.h>
+#include <blockcompression.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <chainparamsbase.h>
@@ -13,11 +14,16 @@
 #include <common/system.h>
 #include <compat/compat.h>
 #include <core_io.h>
+#include <crypto/common.h>
+#include <serialize.h>
 #include <streams.h>
 #include <util/exception.h>
+#include <util/fs.h>
 #include <util/strencodings.h>
 #include <util/translation.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdio>
 #include <functional>
@@ -35,6 +41,7 @@ static void SetupBitcoinUtilArgs(ArgsManager &argsman)
     argsman.AddArg("-version", "Print version and exit", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddCommand("grind", "Perform proof of work on hex header string");
+    argsman.AddCommand("convertblocks", "Rewrite the block files of a blocks directory into an empty directory, compressed or uncompressed: <blocksdir> <outdir> [compress|decompress]");
 
     SetupChainParamsBaseOptions(argsman);
 }
@@ -146,6 +153,98 @@ static int Grind(const std::vector<std::string>& args, std::string& strPrint)
     return EXIT_SUCCESS;
 }
 
+static int ConvertBlocks(const std::vector<std::string>& args, std::string& strPrint)
+{
+    if (args.size() < 2 || args.size() > 3 || (args.size() == 3 && args[2] != "compress" && args[2] != "decompress")) {
+        strPrint = "Must specify the blocks directory, the directory to write to and optionally compress (default) or decompress";
+        return EXIT_FAILURE;
+    }
+    const fs::path in_dir{fs::u8path(args[0])};
+    const fs::path out_dir{fs::u8path(args[1])};
+    const bool compress{args.size() < 3 || args[2] == "compress"};
+    if (!fs::is_directory(in_dir)) {
+        strPrint = strprintf("Blocks directory %s does not exist", fs::PathToString(in_dir));
+        return EXIT_FAILURE;
+    }
+    fs::create_directories(out_dir);
+    if (!fs::is_empty(out_dir)) {
+        strPrint = strprintf("Directory %s to write to is not empty", fs::PathToString(out_dir));
+        return EXIT_FAILURE;
+    }
+
+    // The converted files are obfuscated with the same key
+    std::array<std::byte, 8> xor_key{};
+    if (fs::exists(in_dir / "xor.dat")) {
+        AutoFile{fsbridge::fopen(in_dir / "xor.dat", "rb")} >> xor_key;
+    }
+    AutoFile{fsbridge::fopen(out_dir / "xor.dat", "wb")} << xor_key;
+    const std::vector<std::byte> key{xor_key.begin(), xor_key.end()};
+
+    const BlockFileCompressor in_records{in_dir, "blk", key};
+    BlockFileCompressor out_records{out_dir, "blk", key};
+    const MessageStartChars& message_start{Params().MessageStart()};
+    uint64_t blocks{0};
+    uint64_t in_bytes{0};
+    uint64_t out_bytes{0};
+    int file_num{0};
+    for (;; ++file_num) {
+        const fs::path file_name{fs::u8path(strprintf("blk%05u.dat", file_num))};
+        if (!fs::exists(in_dir / file_name)) break;
+        std::vector<uint8_t> data(fs::file_size(in_dir / file_name));
+        AutoFile{fsbridge::fopen(in_dir / file_name, "rb"), key}.read(MakeWritableByteSpan(data));
+        AutoFile out{fsbridge::fopen(out_dir / file_name, "wb"), key};
+        if (out.IsNull()) {
+            strPrint = strprintf("Cannot write %s", fs::PathToString(out_dir / file_name));
+            return EXIT_FAILURE;
+        }
+
+        // Look for records the way -reindex does, skipping anything else
+        size_t pos{0};
+        while (true) {
+            const auto start{std::search(data.begin() + pos, data.end(), message_start.begin(), message_start.end())};
+            if (data.end() - start < 8) break;
+            pos = start - data.begin() + message_start.size();
+            uint32_t size{ReadLE32(&data[pos])};
+            const bool compressed{(size & COMPRESSED_RECORD_FLAG) != 0};
+            size &= ~COMPRESSED_RECORD_FLAG;
+            if (size > MAX_SIZE || size > data.size() - pos - 4) continue;
+            pos += 4;
+            const Span<const uint8_t> record{data.data() + pos, size};
+            pos += size;
+
+            std::vector<uint8_t> block{record.begin(), record.end()};
+            if (compressed) {
+                auto decompressed{in_records.Decompress(record)};
+                if (!decompressed) {
+                    strPrint = strprintf("Cannot decompress the block at offset %u of %s", pos - size, fs::PathToString(file_name));
+                    return EXIT_FAILURE;
+                }
+                block = std::move(*decompressed);
+            }
+            const std::vector<uint8_t> payload{compress ? out_records.Compress(block) : std::vector<uint8_t>{}};
+            if (payload.empty()) {
+                out << message_start << uint32_t(block.size());
+                out.write(MakeByteSpan(block));
+            } else {
+                out << message_start << uint32_t(payload.size() | COMPRESSED_RECORD_FLAG);
+                out.write(MakeByteSpan(payload));
+            }
+            ++blocks;
+        }
+        if (!out.Commit() || out.fclose() != 0) {
+            strPrint = strprintf("Cannot write %s", fs::PathToString(out_dir / file_name));
+            return EXIT_FAILURE;
+        }
+        in_bytes += data.size();
+        out_bytes += fs::file_size(out_dir / file_name);
+    }
+
+    strPrint = strprintf("Converted %u blocks in %u files of %u bytes to %u bytes. "
+                         "Replace the blocks directory with %s and start with -reindex to use them.",
+                         blocks, file_num, in_bytes, out_bytes, fs::PathToString(out_dir));
+    return EXIT_SUCCESS;
+}
+
 MAIN_FUNCTION
 {
     ArgsManager& args = gArgs;
@@ -175,6 +274,8 @@ MAIN_FUNCTION
     try {
         if (cmd->command == "grind") {
             ret = Grind(cmd->args, strPrint);
+        } else if (cmd->command == "convertblocks") {
+            ret = ConvertBlocks(cmd->args, strPrint);
         } else {
             assert(false); // unknown command should be caught earlier
         }
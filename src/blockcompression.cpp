@@ -0,0 +1,315 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompression.h>
+
+#include <crypto/common.h>
+#include <logging.h>
+#include <serialize.h>
+#include <streams.h>
+#include <tinyformat.h>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace {
+//! Shortest match worth encoding
+constexpr size_t MIN_MATCH{4};
+//! Farthest back a match can refer
+constexpr size_t MAX_MATCH_OFFSET{0xffff};
+//! Lengths that do not fit in a sequence token's 4 bits are continued in extra bytes
+constexpr size_t TOKEN_LENGTH_MAX{15};
+constexpr int MATCH_HASH_BITS{16};
+
+//! Substring length counted by the dictionary trainer
+constexpr size_t TRAINING_DMER_SIZE{8};
+//! Length of the segments dictionaries are built from
+constexpr size_t TRAINING_SEGMENT_SIZE{64};
+constexpr int TRAINING_HASH_BITS{20};
+
+uint32_t HashSequence(const uint8_t* p) { return (ReadLE32(p) * 2654435761U) >> (32 - MATCH_HASH_BITS); }
+
+void WriteLength(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255) out.push_back(255);
+    out.push_back(length);
+}
+
+/**
+ * Write a sequence: a token holding the literal and match lengths, the
+ * literals, and, unless this is the last sequence, the match offset.
+ */
+void WriteSequence(std::vector<uint8_t>& out, Span<const uint8_t> literals, size_t offset, size_t match_length)
+{
+    const size_t match_code{match_length ? match_length - MIN_MATCH : 0};
+    out.push_back(std::min(literals.size(), TOKEN_LENGTH_MAX) << 4 | std::min(match_code, TOKEN_LENGTH_MAX));
+    if (literals.size() >= TOKEN_LENGTH_MAX) WriteLength(out, literals.size() - TOKEN_LENGTH_MAX);
+    out.insert(out.end(), literals.begin(), literals.end());
+    if (match_length) {
+        out.push_back(offset & 0xff);
+        out.push_back(offset >> 8);
+        if (match_code >= TOKEN_LENGTH_MAX) WriteLength(out, match_code - TOKEN_LENGTH_MAX);
+    }
+}
+} // namespace
+
+std::vector<uint8_t> CompressWithDictionary(Span<const uint8_t> data, Span<const uint8_t> dictionary)
+{
+    dictionary = dictionary.last(std::min(dictionary.size(), MAX_MATCH_OFFSET));
+    // Matches are searched for in the dictionary followed by the data
+    std::vector<uint8_t> buf;
+    buf.reserve(dictionary.size() + data.size());
+    buf.insert(buf.end(), dictionary.begin(), dictionary.end());
+    buf.insert(buf.end(), data.begin(), data.end());
+
+    // Last position each hashed sequence of MIN_MATCH bytes was seen at
+    constexpr uint32_t NONE{std::numeric_limits<uint32_t>::max()};
+    std::vector<uint32_t> table(1 << MATCH_HASH_BITS, NONE);
+    for (size_t pos{0}; pos < dictionary.size() && pos + MIN_MATCH <= buf.size(); ++pos) {
+        table[HashSequence(&buf[pos])] = pos;
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(data.size() / 2 + 16);
+    size_t literal_start{dictionary.size()};
+    size_t pos{dictionary.size()};
+    while (pos + MIN_MATCH <= buf.size()) {
+        uint32_t& slot{table[HashSequence(&buf[pos])]};
+        const size_t candidate{slot};
+        slot = pos;
+        if (candidate == NONE || pos - candidate > MAX_MATCH_OFFSET || ReadLE32(&buf[candidate]) != ReadLE32(&buf[pos])) {
+            ++pos;
+            continue;
+        }
+        size_t length{MIN_MATCH};
+        while (pos + length < buf.size() && buf[candidate + length] == buf[pos + length]) ++length;
+        WriteSequence(out, Span{buf}.subspan(literal_start, pos - literal_start), pos - candidate, length);
+        pos += length;
+        literal_start = pos;
+        // Let later matches start inside this one
+        if (pos >= 2 && pos - 2 + MIN_MATCH <= buf.size()) table[HashSequence(&buf[pos - 2])] = pos - 2;
+    }
+    WriteSequence(out, Span{buf}.subspan(literal_start), 0, 0);
+    return out;
+}
+
+std::optional<std::vector<uint8_t>> DecompressWithDictionary(Span<const uint8_t> compressed, Span<const uint8_t> dictionary, size_t size)
+{
+    std::vector<uint8_t> out;
+    out.reserve(size);
+    size_t in{0};
+    const auto read_length{[&](size_t length) -> std::optional<size_t> {
+        if (length < TOKEN_LENGTH_MAX) return length;
+        while (in < compressed.size()) {
+            const uint8_t extra{compressed[in++]};
+            length += extra;
+            if (extra != 255) return length;
+        }
+        return std::nullopt;
+    }};
+
+    while (true) {
+        if (in == compressed.size()) return std::nullopt;
+        const uint8_t token{compressed[in++]};
+        const auto literals{read_length(token >> 4)};
+        if (!literals || *literals > compressed.size() - in || *literals > size - out.size()) return std::nullopt;
+        out.insert(out.end(), compressed.begin() + in, compressed.begin() + in + *literals);
+        in += *literals;
+        // The last sequence has no match
+        if (in == compressed.size()) break;
+
+        if (compressed.size() - in < 2) return std::nullopt;
+        const size_t offset{compressed[in] | size_t{compressed[in + 1]} << 8};
+        in += 2;
+        const auto match_code{read_length(token & 0xf)};
+        if (!match_code || offset == 0 || offset > out.size() + dictionary.size()) return std::nullopt;
+        const size_t length{*match_code + MIN_MATCH};
+        if (length > size - out.size()) return std::nullopt;
+        // Byte by byte, as a match may overlap the bytes it produces
+        for (size_t i{0}; i < length; ++i) {
+            const uint8_t byte{offset > out.size() ? dictionary[dictionary.size() - (offset - out.size())] : out[out.size() - offset]};
+            out.push_back(byte);
+        }
+    }
+    if (out.size() != size) return std::nullopt;
+    return out;
+}
+
+std::vector<uint8_t> TrainDictionary(const std::vector<Span<const uint8_t>>& samples, size_t max_size)
+{
+    // Approximate counts of every substring of TRAINING_DMER_SIZE bytes
+    std::vector<uint32_t> counts(1 << TRAINING_HASH_BITS);
+    const auto dmer_index{[](const uint8_t* p) { return (ReadLE64(p) * 0x9e3779b97f4a7c15ULL) >> (64 - TRAINING_HASH_BITS); }};
+    for (const auto& sample : samples) {
+        for (size_t pos{0}; pos + TRAINING_DMER_SIZE <= sample.size(); ++pos) {
+            ++counts[dmer_index(&sample[pos])];
+        }
+    }
+    // A segment is worth the counts of the substrings in it that recur and
+    // are not in the dictionary yet
+    const auto score{[&](Span<const uint8_t> segment) {
+        uint64_t total{0};
+        for (size_t pos{0}; pos + TRAINING_DMER_SIZE <= segment.size(); ++pos) {
+            const uint32_t count{counts[dmer_index(&segment[pos])]};
+            if (count > 1) total += count;
+        }
+        return total;
+    }};
+
+    struct Candidate {
+        uint64_t score;
+        Span<const uint8_t> segment;
+        bool operator<(const Candidate& other) const { return score < other.score; }
+    };
+    std::priority_queue<Candidate> candidates;
+    for (const auto& sample : samples) {
+        for (size_t pos{0}; pos + TRAINING_SEGMENT_SIZE <= sample.size(); pos += TRAINING_SEGMENT_SIZE / 2) {
+            const auto segment{sample.subspan(pos, TRAINING_SEGMENT_SIZE)};
+            if (const uint64_t segment_score{score(segment)}) candidates.push({segment_score, segment});
+        }
+    }
+
+    // Greedily pick the best segment, rescoring candidates lazily as the
+    // substrings of picked segments stop counting
+    std::vector<Span<const uint8_t>> picked;
+    size_t picked_size{0};
+    while (!candidates.empty() && picked_size < max_size) {
+        Candidate candidate{candidates.top()};
+        candidates.pop();
+        candidate.score = score(candidate.segment);
+        if (candidate.score == 0) continue;
+        if (!candidates.empty() && candidate.score < candidates.top().score) {
+            candidates.push(candidate);
+            continue;
+        }
+        for (size_t pos{0}; pos + TRAINING_DMER_SIZE <= candidate.segment.size(); ++pos) {
+            counts[dmer_index(&candidate.segment[pos])] = 0;
+        }
+        picked.push_back(candidate.segment);
+        picked_size += candidate.segment.size();
+    }
+
+    std::vector<uint8_t> dictionary;
+    dictionary.reserve(picked_size);
+    for (auto it{picked.rbegin()}; it != picked.rend(); ++it) {
+        dictionary.insert(dictionary.end(), it->begin(), it->end());
+    }
+    if (dictionary.size() > max_size) dictionary.erase(dictionary.begin(), dictionary.end() - max_size);
+    return dictionary;
+}
+
+BlockFileCompressor::BlockFileCompressor(fs::path dir, std::string prefix, std::vector<std::byte> xor_key, size_t sample_bytes, size_t retrain_bytes)
+    : m_dir{std::move(dir)}, m_prefix{std::move(prefix)}, m_xor_key{std::move(xor_key)}, m_sample_bytes{sample_bytes}, m_retrain_bytes{retrain_bytes}
+{
+    // Continue with the last dictionary trained before
+    LOCK(m_mutex);
+    while (fs::exists(DictionaryPath(m_current_dictionary + 1))) ++m_current_dictionary;
+}
+
+fs::path BlockFileCompressor::DictionaryPath(uint32_t id) const
+{
+    return m_dir / fs::u8path(strprintf("%sdict%05u.dat", m_prefix, id));
+}
+
+std::shared_ptr<const std::vector<uint8_t>> BlockFileCompressor::GetDictionary(uint32_t id) const
+{
+    AssertLockHeld(m_mutex);
+    if (const auto it{m_dictionaries.find(id)}; it != m_dictionaries.end()) return it->second;
+
+    const fs::path path{DictionaryPath(id)};
+    AutoFile file{fsbridge::fopen(path, "rb"), m_xor_key};
+    std::error_code ec;
+    const auto size{fs::file_size(path, ec)};
+    if (file.IsNull() || ec || size > MAX_COMPRESSION_DICTIONARY_SIZE) {
+        LogPrintLevel(BCLog::BLOCKSTORAGE, BCLog::Level::Error, "Cannot read compression dictionary %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    std::vector<uint8_t> dictionary(size);
+    try {
+        file.read(MakeWritableByteSpan(dictionary));
+    } catch (const std::ios_base::failure& e) {
+        LogPrintLevel(BCLog::BLOCKSTORAGE, BCLog::Level::Error, "Cannot read compression dictionary %s: %s\n", fs::PathToString(path), e.what());
+        return nullptr;
+    }
+    return m_dictionaries.emplace(id, std::make_shared<const std::vector<uint8_t>>(std::move(dictionary))).first->second;
+}
+
+void BlockFileCompressor::Train()
+{
+    AssertLockHeld(m_mutex);
+    m_bytes_since_training = 0;
+    std::vector<uint8_t> dictionary{TrainDictionary({m_samples.begin(), m_samples.end()}, MAX_COMPRESSION_DICTIONARY_SIZE)};
+
+    // Records may only be compressed with a dictionary once it is on disk
+    const uint32_t id{m_current_dictionary + 1};
+    const fs::path path{DictionaryPath(id)};
+    AutoFile file{fsbridge::fopen(path, "wb"), m_xor_key};
+    try {
+        if (file.IsNull()) throw std::ios_base::failure{"cannot open file"};
+        file.write(MakeByteSpan(dictionary));
+        if (!file.Commit() || file.fclose() != 0) throw std::ios_base::failure{"cannot commit file"};
+    } catch (const std::ios_base::failure& e) {
+        LogPrintLevel(BCLog::BLOCKSTORAGE, BCLog::Level::Warning, "Cannot write compression dictionary %s: %s\n", fs::PathToString(path), e.what());
+        return;
+    }
+    LogPrint(BCLog::BLOCKSTORAGE, "Trained compression dictionary %s of %u bytes on %u recent records\n", fs::PathToString(path), dictionary.size(), m_samples.size());
+    m_dictionaries.emplace(id, std::make_shared<const std::vector<uint8_t>>(std::move(dictionary)));
+    m_current_dictionary = id;
+}
+
+std::vector<uint8_t> BlockFileCompressor::Compress(Span<const uint8_t> data)
+{
+    std::shared_ptr<const std::vector<uint8_t>> dictionary;
+    uint32_t id;
+    {
+        LOCK(m_mutex);
+        m_samples.emplace_back(data.begin(), data.end());
+        m_sample_size += data.size();
+        while (m_samples.size() > 1 && m_sample_size - m_samples.front().size() >= m_sample_bytes) {
+            m_sample_size -= m_samples.front().size();
+            m_samples.pop_front();
+        }
+        m_bytes_since_training += data.size();
+        if (m_sample_size >= m_sample_bytes && (m_current_dictionary == 0 || m_bytes_since_training >= m_retrain_bytes)) Train();
+        id = m_current_dictionary;
+        if (id != 0) dictionary = GetDictionary(id);
+        // A dictionary that cannot be read back is not used
+        if (!dictionary) id = 0;
+    }
+
+    std::vector<uint8_t> payload;
+    VectorWriter writer{payload, 0, COMPRESSED_RECORD_VERSION, id};
+    WriteCompactSize(writer, data.size());
+    const auto compressed{CompressWithDictionary(data, dictionary ? Span{*dictionary} : Span<const uint8_t>{})};
+    payload.insert(payload.end(), compressed.begin(), compressed.end());
+    if (payload.size() >= data.size()) payload.clear();
+    return payload;
+}
+
+std::optional<std::vector<uint8_t>> BlockFileCompressor::Decompress(Span<const uint8_t> payload) const
+{
+    try {
+        SpanReader reader{payload};
+        uint8_t version;
+        uint32_t id;
+        reader >> version >> id;
+        if (version != COMPRESSED_RECORD_VERSION) return std::nullopt;
+        const uint64_t size{ReadCompactSize(reader)};
+        std::shared_ptr<const std::vector<uint8_t>> dictionary;
+        if (id != 0) {
+            dictionary = WITH_LOCK(m_mutex, return GetDictionary(id));
+            if (!dictionary) return std::nullopt;
+        }
+        return DecompressWithDictionary({reader.data(), reader.size()}, dictionary ? Span{*dictionary} : Span<const uint8_t>{}, size);
+    } catch (const std::ios_base::failure&) {
+        return std::nullopt;
+    }
+}
+
+uint32_t BlockFileCompressor::CurrentDictionary() const
+{
+    LOCK(m_mutex);
+    return m_current_dictionary;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCOMPRESSION_H
+#define BITCOIN_BLOCKCOMPRESSION_H
+
+#include <span.h>
+#include <sync.h>
+#include <util/fs.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Set in the size field of a block or undo file record whose payload is
+ * compressed. The size without it is the size of the payload on disk.
+ */
+static constexpr uint32_t COMPRESSED_RECORD_FLAG{0x80000000};
+/** Version of the compressed record payload format. */
+static constexpr uint8_t COMPRESSED_RECORD_VERSION{1};
+/** Largest compression dictionary, small enough for matches to reach past it into the data. */
+static constexpr size_t MAX_COMPRESSION_DICTIONARY_SIZE{32 << 10};
+/** Bytes of recent records a dictionary is trained on. */
+static constexpr size_t DEFAULT_DICTIONARY_SAMPLE_BYTES{1 << 20};
+/** Bytes of records compressed before the dictionary is trained again. */
+static constexpr size_t DEFAULT_DICTIONARY_RETRAIN_BYTES{128 << 20};
+
+/**
+ * LZ77-compress data. Matches may refer back into the dictionary, as if it
+ * preceded the data.
+ */
+std::vector<uint8_t> CompressWithDictionary(Span<const uint8_t> data, Span<const uint8_t> dictionary);
+
+/**
+ * Decompress data compressed with the same dictionary. Returns std::nullopt if
+ * it is malformed or does not decompress to exactly size bytes.
+ */
+std::optional<std::vector<uint8_t>> DecompressWithDictionary(Span<const uint8_t> compressed, Span<const uint8_t> dictionary, size_t size);
+
+/**
+ * Build a dictionary of at most max_size bytes out of the segments of the
+ * samples whose substrings recur the most across all of them, most useful
+ * segments last.
+ */
+std::vector<uint8_t> TrainDictionary(const std::vector<Span<const uint8_t>>& samples, size_t max_size);
+
+/**
+ * Compresses the records of block or undo files, with dictionaries trained on
+ * the records compressed most recently, and decompresses them again.
+ *
+ * Dictionaries are stored in dir as <prefix>dict<n>.dat, obfuscated like the
+ * files they belong to, and never change once written. A compressed payload
+ * starts with the format version, the number of the dictionary it was
+ * compressed with, 0 for none, and its decompressed size.
+ */
+class BlockFileCompressor
+{
+public:
+    BlockFileCompressor(fs::path dir, std::string prefix, std::vector<std::byte> xor_key,
+                        size_t sample_bytes = DEFAULT_DICTIONARY_SAMPLE_BYTES,
+                        size_t retrain_bytes = DEFAULT_DICTIONARY_RETRAIN_BYTES);
+
+    /**
+     * The compressed payload for a record, or nothing if compressing does not
+     * make it smaller. Trains a new dictionary when it is due.
+     */
+    std::vector<uint8_t> Compress(Span<const uint8_t> data) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** The record a payload decompresses to, or std::nullopt if it is malformed or its dictionary is missing. */
+    std::optional<std::vector<uint8_t>> Decompress(Span<const uint8_t> payload) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Number of the dictionary new records are compressed with, 0 for none. */
+    uint32_t CurrentDictionary() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    fs::path DictionaryPath(uint32_t id) const;
+    std::shared_ptr<const std::vector<uint8_t>> GetDictionary(uint32_t id) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    void Train() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    const fs::path m_dir;
+    const std::string m_prefix;
+    const std::vector<std::byte> m_xor_key;
+    const size_t m_sample_bytes;
+    const size_t m_retrain_bytes;
+
+    mutable Mutex m_mutex;
+    //! Dictionaries read or trained so far
+    mutable std::map<uint32_t, std::shared_ptr<const std::vector<uint8_t>>> m_dictionaries GUARDED_BY(m_mutex);
+    uint32_t m_current_dictionary GUARDED_BY(m_mutex){0};
+    //! Most recently compressed records, oldest first
+    std::deque<std::vector<uint8_t>> m_samples GUARDED_BY(m_mutex);
+    size_t m_sample_size GUARDED_BY(m_mutex){0};
+    size_t m_bytes_since_training GUARDED_BY(m_mutex){0};
+};
+
+#endif // BITCOIN_BLOCKCOMPRESSION_H
@@ -65,7 +65,7 @@ public:
 
     SERIALIZE_METHODS(BlockTransactions, obj)
     {
-        READWRITE(obj.blockhash, TX_WITH_WITNESS(Using<VectorFormatter<TransactionCompression>>(obj.txn)));
+        READWRITE(obj.blockhash, TX_WITH_WITNESS(Using<BatchHashedTransactions>(obj.txn)));
     }
 };
 
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -130,6 +131,8 @@ enum BlockStatus : uint32_t {
 
     BLOCK_STATUS_RESERVED    =   256, //!< Unused flag that was previously set on assumeutxo snapshot blocks and their
                                       //!< ancestors before they were validated, and unset when they were validated.
+
+    BLOCK_HAVE_POW_HASH      =   512, //!< Flex proof-of-work hash of the header is stored in hashPoW
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -190,6 +193,10 @@ public:
     uint32_t nBits{0};
     uint32_t nNonce{0};
 
+    //! Flex proof-of-work hash of the header, recorded when the header was
+    //! accepted. Only meaningful if nStatus has BLOCK_HAVE_POW_HASH.
+    uint256 hashPoW{};
+
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     int32_t nSequenceId{0};
 
@@ -246,6 +253,19 @@ public:
         return *phashBlock;
     }
 
+    /**
+     * The proof-of-work hash of this header without recomputing it, or
+     * std::nullopt if a Flex header was indexed before it was recorded.
+     * Non-Flex headers use their block hash as proof of work.
+     */
+    std::optional<uint256> GetPoWHash() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+    {
+        AssertLockHeld(::cs_main);
+        if (!(nVersion & 0x8000)) return GetBlockHash();
+        if (nStatus & BLOCK_HAVE_POW_HASH) return hashPoW;
+        return std::nullopt;
+    }
+
     /**
      * Check whether this block and all previous blocks back to the genesis block or an assumeutxo snapshot block have
      * reached VALID_TRANSACTIONS and had transactions downloaded (and stored to disk) at some point.
@@ -361,6 +381,13 @@ class CDiskBlockIndex : public CBlockIndex
      **/
     static constexpr int DUMMY_VERSION = 259900;
 
+    /** Entries written with at least this version carry hashPoW when
+     * BLOCK_HAVE_POW_HASH is set. Older clients rewrite entries with
+     * DUMMY_VERSION and drop the field, so the flag is only trusted on
+     * entries that were last written by a client that knows about it.
+     **/
+    static constexpr int POW_HASH_VERSION = 260000;
+
 public:
     uint256 hashPrev;
 
@@ -377,7 +404,7 @@ public:
     SERIALIZE_METHODS(CDiskBlockIndex, obj)
     {
         LOCK(::cs_main);
-        int _nVersion = DUMMY_VERSION;
+        int _nVersion = POW_HASH_VERSION;
         READWRITE(VARINT_MODE(_nVersion, VarIntMode::NONNEGATIVE_SIGNED));
 
         READWRITE(VARINT_MODE(obj.nHeight, VarIntMode::NONNEGATIVE_SIGNED));
@@ -394,6 +421,10 @@ public:
         READWRITE(obj.nTime);
         READWRITE(obj.nBits);
         READWRITE(obj.nNonce);
+
+        // Flex proof-of-work hash, appended so older clients can still read the entry
+        SER_READ(obj, if (_nVersion < POW_HASH_VERSION) obj.nStatus &= ~BLOCK_HAVE_POW_HASH);
+        if (obj.nStatus & BLOCK_HAVE_POW_HASH) READWRITE(obj.hashPoW);
     }
 
     uint256 ConstructBlockHash() const
@@ -5,6 +5,8 @@
 #include <consensus/merkle.h>
 #include <hash.h>
 
+#include <algorithm>
+
 /*     WARNING! If you're reading this because you're learning about crypto
        and/or designing a new system that will use merkle trees, keep in mind
        that the following merkle tree algorithm has a serious flaw related to
@@ -83,3 +85,75 @@ uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated)
     return ComputeMerkleRoot(std::move(leaves), mutated);
 }
 
+std::vector<uint256> TransactionMerklePath(const CBlock& block, uint32_t position)
+{
+    std::vector<uint256> leaves;
+    leaves.resize(block.vtx.size());
+    for (size_t s = 0; s < block.vtx.size(); s++) {
+        leaves[s] = block.vtx[s]->GetHash();
+    }
+    std::vector<uint256> path;
+    while (leaves.size() > 1) {
+        if (leaves.size() & 1) {
+            leaves.push_back(leaves.back());
+        }
+        path.push_back(leaves[position ^ 1]);
+        SHA256D64(leaves[0].begin(), leaves[0].begin(), leaves.size() / 2);
+        leaves.resize(leaves.size() / 2);
+        position >>= 1;
+    }
+    return path;
+}
+
+uint256 MerkleTree::Update(std::vector<uint256> leaves)
+{
+    if (m_levels.empty()) m_levels.emplace_back();
+    std::vector<bool> changed(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++) {
+        changed[i] = i >= m_levels[0].size() || leaves[i] != m_levels[0][i];
+    }
+    size_t old_size = m_levels[0].size();
+    m_levels[0] = std::move(leaves);
+
+    size_t level = 0;
+    while (m_levels[level].size() > 1) {
+        if (m_levels.size() == level + 1) m_levels.emplace_back();
+        const std::vector<uint256>& hashes = m_levels[level];
+        std::vector<uint256>& parents = m_levels[level + 1];
+        const size_t size = hashes.size();
+        const size_t old_parents = parents.size();
+        parents.resize((size + 1) / 2);
+        std::vector<bool> parent_changed(parents.size());
+        for (size_t j = 0; j < parents.size(); j++) {
+            const size_t left = 2 * j, right = std::min(2 * j + 1, size - 1);
+            // Near the old or new end of the level, the pairing itself may differ
+            if (j >= old_parents || changed[left] || changed[right] || 2 * j + 1 >= std::min(size, old_size)) {
+                parents[j] = Hash(hashes[left], hashes[right]);
+                parent_changed[j] = true;
+            }
+        }
+        changed = std::move(parent_changed);
+        old_size = old_parents;
+        level++;
+    }
+    m_levels.resize(level + 1);
+    return Root();
+}
+
+uint256 MerkleTree::Root() const
+{
+    if (m_levels.empty() || m_levels.back().empty()) return uint256();
+    return m_levels.back()[0];
+}
+
+std::vector<uint256> MerkleTree::Path(size_t position) const
+{
+    std::vector<uint256> path;
+    for (size_t level = 0; level + 1 < m_levels.size(); level++) {
+        // The last hash of an odd-sized level is paired with itself
+        const std::vector<uint256>& hashes = m_levels[level];
+        path.push_back(hashes[std::min(position ^ 1, hashes.size() - 1)]);
+        position >>= 1;
+    }
+    return path;
+}
@@ -24,4 +24,29 @@ uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = nullptr);
  */
 uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated = nullptr);
 
+/*
+ * Compute the Merkle branch (sibling hashes from the leaf upwards) linking the
+ * transaction at position to the Merkle root of the block.
+ */
+std::vector<uint256> TransactionMerklePath(const CBlock& block, uint32_t position);
+
+/*
+ * A Merkle tree kept in memory, so that a list of leaves sharing most of its
+ * hashes with the previous one (a block template after mempool changes) only
+ * rehashes the nodes above leaves that changed. Roots match ComputeMerkleRoot.
+ */
+class MerkleTree
+{
+public:
+    /* Replace the leaves, returning the new root. */
+    uint256 Update(std::vector<uint256> leaves);
+    uint256 Root() const;
+    /* The hashes needed to link the leaf at position to the root, as TransactionMerklePath returns them. */
+    std::vector<uint256> Path(size_t position) const;
+
+private:
+    // Leaves first, the root last
+    std::vector<std::vector<uint256>> m_levels;
+};
+
 #endif // BITCOIN_CONSENSUS_MERKLE_H
@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -20,12 +21,9 @@
 #include "crypto/int-util.h"
 #include "crypto/variant2_int_sqrt.h"
 
-#if defined(_MSC_VER)
-#include <malloc.h>
-#endif
-
 #define AES_BLOCK_SIZE  16
 #define AES_KEY_SIZE    32 /*16*/
+#define AES_EXP_KEY_SIZE 240
 #define INIT_SIZE_BLK   8
 #define INIT_SIZE_BYTE  (INIT_SIZE_BLK * AES_BLOCK_SIZE)
 
@@ -186,49 +184,40 @@ static inline void xor_blocks_dst(const uint8_t* a, const uint8_t* b, uint8_t* d
     ((uint64_t*) dst)[1] = ((uint64_t*) a)[1] ^ ((uint64_t*) b)[1];
 }
 
-void cnfn_slow_hash(const char* input, char* output, int len, int variant, uint32_t page_size, uint32_t iterations, size_t aes_rounds)
+/* Portable implementation of the memory-hard part of the hash: scratchpad
+ * explode, main loop and implode, using the table-based AES rounds. It handles
+ * every variant and is the reference the accelerated kernels are tested
+ * against. */
+static void cnfn_memhard_portable(uint8_t* hs, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds)
 {
-  union cnfn_slow_hash_state state;
+  union cnfn_slow_hash_state* state = (union cnfn_slow_hash_state*) hs;
   uint8_t text[INIT_SIZE_BYTE];
   uint8_t a[AES_BLOCK_SIZE];
   uint8_t b[AES_BLOCK_SIZE * 2];
   uint8_t c[AES_BLOCK_SIZE];
-  uint8_t aes_key[AES_KEY_SIZE];
-  oaes_ctx* aes_ctx;
+  uint8_t aes_exp_key[AES_EXP_KEY_SIZE];
+  size_t aes_exp_key_len = sizeof(aes_exp_key);
 
   size_t init_rounds = (page_size / INIT_SIZE_BYTE);
 
-#if defined(_MSC_VER)
-  uint8_t *long_state = (uint8_t *)_malloca(page_size);
-#else
-#if defined(__APPLE__)
-  uint8_t *long_state = (uint8_t *)calloc(page_size, sizeof(uint8_t));
-#else
-  uint8_t *long_state = (uint8_t *)malloc(page_size);
-#endif
-#endif
-  hash_process(&state.hs, (const uint8_t*) input, len);
-  memcpy(text, state.init, INIT_SIZE_BYTE);
-  memcpy(aes_key, state.hs.b, AES_KEY_SIZE);
-  aes_ctx = (oaes_ctx*) oaes_alloc();
+  memcpy(text, state->init, INIT_SIZE_BYTE);
   size_t i, j;
 
-  VARIANT1_INIT();
-  VARIANT2_INIT(b, state);
+  VARIANT2_INIT(b, (*state));
 
-  oaes_key_import_data(aes_ctx, aes_key, AES_KEY_SIZE);
+  oaes_key_expand_data(state->hs.b, AES_KEY_SIZE, aes_exp_key, &aes_exp_key_len);
   for (i = 0; i < init_rounds; i++) {
     for (j = 0; j < INIT_SIZE_BLK; j++) {
       aesb_pseudo_round(&text[AES_BLOCK_SIZE * j],
       &text[AES_BLOCK_SIZE * j],
-      aes_ctx->key->exp_data);
+      aes_exp_key);
     }
     memcpy(&long_state[i * INIT_SIZE_BYTE], text, INIT_SIZE_BYTE);
   }
 
   for (i = 0; i < 16; i++) {
-    a[i] = state.k[i] ^ state.k[32 + i];
-    b[i] = state.k[16 + i] ^ state.k[48 + i];
+    a[i] = state->k[i] ^ state->k[32 + i];
+    b[i] = state->k[16 + i] ^ state->k[48 + i];
   }
 
   for (i = 0; i < iterations; i++) {
@@ -273,20 +262,51 @@ void cnfn_slow_hash(const char* input, char* output, int len, int variant, uint3
     copy_block(b, c);
   }
 
-  memcpy(text, state.init, INIT_SIZE_BYTE);
-  oaes_key_import_data(aes_ctx, &state.hs.b[32], AES_KEY_SIZE);
+  memcpy(text, state->init, INIT_SIZE_BYTE);
+  aes_exp_key_len = sizeof(aes_exp_key);
+  oaes_key_expand_data(&state->hs.b[32], AES_KEY_SIZE, aes_exp_key, &aes_exp_key_len);
   for (i = 0; i < init_rounds; i++) {
     for (j = 0; j < INIT_SIZE_BLK; j++) {
       xor_blocks(&text[j * AES_BLOCK_SIZE], &long_state[i * INIT_SIZE_BYTE + j * AES_BLOCK_SIZE]);
-      aesb_pseudo_round(&text[j * AES_BLOCK_SIZE], &text[j * AES_BLOCK_SIZE], aes_ctx->key->exp_data);
+      aesb_pseudo_round(&text[j * AES_BLOCK_SIZE], &text[j * AES_BLOCK_SIZE], aes_exp_key);
     }
   }
-  memcpy(state.init, text, INIT_SIZE_BYTE);
+  memcpy(state->init, text, INIT_SIZE_BYTE);
+}
+
+/* Memory-hard kernel used for variants 0 and 1. Defaults to the portable code
+ * and is replaced by CNFNAutoDetect() when hardware AES is available. */
+static cnfn_memhard_fn cnfn_memhard = cnfn_memhard_portable;
+
+void cnfn_slow_hash(const char* input, char* output, uint32_t len, int variant, uint32_t page_size, uint32_t iterations, size_t aes_rounds)
+{
+  union cnfn_slow_hash_state state;
+
+  /* Every variant fits the per-thread scratchpad; anything larger falls back
+   * to the heap. The explode phase overwrites the whole page, so neither needs
+   * clearing. */
+  uint8_t *long_state = page_size <= CNFN_PAGE_SIZE ? cnfn_scratchpad() : (uint8_t *)malloc(page_size);
+  hash_process(&state.hs, (const uint8_t*) input, len);
+
+  VARIANT1_INIT();
+
+  if (variant >= 2) {
+    cnfn_memhard_portable(state.hs.b, long_state, variant, tweak1_2, page_size, iterations, aes_rounds);
+  } else {
+    cnfn_memhard(state.hs.b, long_state, variant, tweak1_2, page_size, iterations, aes_rounds);
+  }
+
   hash_permutation(&state.hs);
   /*memcpy(hash, &state, 32);*/
   extra_hashes[state.hs.b[0] & 2](&state, 200, output);
-  oaes_free((OAES_CTX **) &aes_ctx);
-  free(long_state);
+  if (page_size > CNFN_PAGE_SIZE) {
+    free(long_state);
+  }
+}
+
+void cnfn_set_memhard(cnfn_memhard_fn fn)
+{
+  cnfn_memhard = fn ? fn : cnfn_memhard_portable;
 }
 
 void cnfn_fast_hash(const char* input, char* output, uint32_t len) {
@@ -28,6 +28,27 @@
 
 #define CNFN_TURTLE_LITE_AES_ROUNDS 8192
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Memory-hard part of cnfn_slow_hash (scratchpad explode, main loop and
+ * implode) for variants 0 and 1. state is the 200-byte Keccak state, which is
+ * updated in place; long_state is the page_size-byte scratchpad. */
+typedef void (*cnfn_memhard_fn)(uint8_t* state, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds);
+
+/* Select the memory-hard kernel. Passing NULL restores the portable one. */
+void cnfn_set_memhard(cnfn_memhard_fn fn);
+
+/* Calling thread's CNFN_PAGE_SIZE-byte scratchpad. It is allocated on first
+ * use, cache-line aligned, advised for transparent huge pages where the OS
+ * supports them, and released when the thread exits. */
+uint8_t* cnfn_scratchpad(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 typedef unsigned char BitSequence;
 typedef unsigned long long DataLength;
 
@@ -103,4 +124,17 @@ extern "C" {
 } // extern
 } // namespace
 
+namespace cnfn_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_AES = 1 << 0,
+    USE_ALL = USE_AES,
+};
+}
+
+/** Autodetect the best available CryptoNight implementation.
+ *  Returns the name of the implementation.
+ */
+std::string CNFNAutoDetect(cnfn_implementation::UseImplementation use_implementation = cnfn_implementation::USE_ALL);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// ARMv8 crypto extension version of the CryptoNight memory-hard loop used by
+// cnfn_slow_hash.
+
+#if defined(ENABLE_ARM_AES)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <arm_acle.h>
+#include <arm_neon.h>
+
+#include <attributes.h>
+
+namespace {
+
+constexpr size_t AES_BLOCK_SIZE = 16;
+constexpr size_t INIT_SIZE_BLK = 8;
+constexpr size_t INIT_SIZE_BYTE = INIT_SIZE_BLK * AES_BLOCK_SIZE;
+//! Offset of the scratchpad init blocks in the Keccak state.
+constexpr size_t STATE_INIT_OFFSET = 64;
+
+/** One x86-style AES round (SubBytes, ShiftRows, MixColumns, AddRoundKey). */
+uint8x16_t ALWAYS_INLINE Round(uint8x16_t x, uint8x16_t key)
+{
+    return veorq_u8(vaesmcq_u8(vaeseq_u8(x, vdupq_n_u8(0))), key);
+}
+
+/** AES SubWord applied to every 32-bit lane holding the same word. */
+uint32_t ALWAYS_INLINE SubWord(uint32_t w)
+{
+    // With identical columns ShiftRows is a no-op, leaving only SubBytes.
+    const uint8x16_t x = vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(w)), vdupq_n_u8(0));
+    return vgetq_lane_u32(vreinterpretq_u32_u8(x), 0);
+}
+
+/** First ten AES-256 round keys of a 32-byte key, as used by the pseudo rounds. */
+void ExpandKey(const uint8_t* key, uint8x16_t (&k)[10])
+{
+    static const uint32_t RCON[4] = {0x01, 0x02, 0x04, 0x08};
+    uint32_t w[40];
+    memcpy(w, key, 32);
+    for (int i = 8; i < 40; ++i) {
+        uint32_t t = w[i - 1];
+        if (i % 8 == 0) {
+            t = SubWord((t >> 8) | (t << 24)) ^ RCON[i / 8 - 1];
+        } else if (i % 8 == 4) {
+            t = SubWord(t);
+        }
+        w[i] = w[i - 8] ^ t;
+    }
+    for (int r = 0; r < 10; ++r) {
+        k[r] = vreinterpretq_u8_u32(vld1q_u32(w + 4 * r));
+    }
+}
+
+/** Ten full AES rounds without the initial key whitening (aesb_pseudo_round). */
+uint8x16_t ALWAYS_INLINE PseudoRound(uint8x16_t x, const uint8x16_t (&k)[10])
+{
+    for (int r = 0; r < 10; ++r) x = Round(x, k[r]);
+    return x;
+}
+
+uint64_t ALWAYS_INLINE Mul128(uint64_t a, uint64_t b, uint64_t& hi)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    hi = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#else
+    const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+uint64_t ALWAYS_INLINE Low64(uint8x16_t x) { return vgetq_lane_u64(vreinterpretq_u64_u8(x), 0); }
+
+} // namespace
+
+namespace cnfn_arm_aes {
+void MemHard(uint8_t* state, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds)
+{
+    const size_t init_rounds = page_size / INIT_SIZE_BYTE;
+    const size_t mask = (aes_rounds - 1) * AES_BLOCK_SIZE;
+    uint8x16_t k[10];
+    uint8x16_t x[INIT_SIZE_BLK];
+
+    // Explode the Keccak state into the scratchpad.
+    ExpandKey(state, k);
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        x[j] = vld1q_u8(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE);
+    }
+    for (size_t i = 0; i < init_rounds; ++i) {
+        uint8_t* out = long_state + i * INIT_SIZE_BYTE;
+        for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+            x[j] = PseudoRound(x[j], k);
+            vst1q_u8(out + j * AES_BLOCK_SIZE, x[j]);
+        }
+    }
+
+    // Main loop.
+    uint8x16_t a = veorq_u8(vld1q_u8(state), vld1q_u8(state + 32));
+    uint8x16_t b = veorq_u8(vld1q_u8(state + 16), vld1q_u8(state + 48));
+    const uint8x16_t tweak = vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(0), vcreate_u64(variant == 1 ? tweak1_2 : 0)));
+    for (uint32_t i = 0; i < iterations; ++i) {
+        uint8_t* p = long_state + (Low64(a) & mask);
+        const uint8x16_t c = Round(vld1q_u8(p), a);
+        vst1q_u8(p, veorq_u8(b, c));
+        if (variant == 1) {
+            const uint8_t tmp = p[11];
+            static const uint32_t table = 0x75310;
+            const uint8_t index = (((tmp >> 3) & 6) | (tmp & 1)) << 1;
+            p[11] = tmp ^ ((table >> index) & 0x30);
+        }
+
+        const uint64_t c_lo = Low64(c);
+        p = long_state + (c_lo & mask);
+        const uint8x16_t t = vld1q_u8(p);
+        uint64_t hi;
+        const uint64_t lo = Mul128(c_lo, Low64(t), hi);
+        a = vreinterpretq_u8_u64(vaddq_u64(vreinterpretq_u64_u8(a), vcombine_u64(vcreate_u64(hi), vcreate_u64(lo))));
+        vst1q_u8(p, veorq_u8(a, tweak));
+        a = veorq_u8(a, t);
+        b = c;
+    }
+
+    // Implode the scratchpad back into the Keccak state.
+    ExpandKey(state + 32, k);
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        x[j] = vld1q_u8(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE);
+    }
+    for (size_t i = 0; i < init_rounds; ++i) {
+        const uint8_t* in = long_state + i * INIT_SIZE_BYTE;
+        for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+            x[j] = PseudoRound(veorq_u8(x[j], vld1q_u8(in + j * AES_BLOCK_SIZE)), k);
+        }
+    }
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        vst1q_u8(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE, x[j]);
+    }
+}
+} // namespace cnfn_arm_aes
+
+#endif
@@ -0,0 +1,109 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <config/bitcoin-config.h> // IWYU pragma: keep
+
+#include "cnfn.h"
+
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include <compat/cpuid.h>
+#if defined(__linux__) && defined(ENABLE_ARM_AES)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(__APPLE__) && defined(ENABLE_ARM_AES)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+
+namespace cnfn_x86_aesni
+{
+void MemHard(uint8_t* state, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds);
+}
+namespace cnfn_arm_aes
+{
+void MemHard(uint8_t* state, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds);
+}
+
+namespace {
+/** Compare the selected kernel against the portable one on a small scratchpad. */
+bool SelfTest(cnfn_memhard_fn fn)
+{
+    static const uint32_t PAGE_SIZE = 16384;
+    static const uint32_t ITERATIONS = 4096;
+    static const size_t AES_ROUNDS = 1024;
+
+    char input[80];
+    for (size_t i = 0; i < sizeof(input); ++i) input[i] = (char)(i * 0x9d + 1);
+
+    char expected[HASH_SIZE] = {}, actual[HASH_SIZE] = {};
+    for (int variant = 0; variant <= 1; ++variant) {
+        cnfn_set_memhard(nullptr);
+        crypto::cnfn_slow_hash(input, expected, sizeof(input), variant, PAGE_SIZE, ITERATIONS, AES_ROUNDS);
+        cnfn_set_memhard(fn);
+        crypto::cnfn_slow_hash(input, actual, sizeof(input), variant, PAGE_SIZE, ITERATIONS, AES_ROUNDS);
+        if (std::memcmp(expected, actual, sizeof(actual)) != 0) return false;
+    }
+    return true;
+}
+} // namespace
+
+std::string CNFNAutoDetect(cnfn_implementation::UseImplementation use_implementation)
+{
+    std::string ret = "standard";
+    cnfn_memhard_fn fn = nullptr;
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_X86_AESNI)
+    if (use_implementation & cnfn_implementation::USE_AES) {
+        uint32_t eax, ebx, ecx, edx;
+        GetCPUID(1, 0, eax, ebx, ecx, edx);
+        const bool have_sse41 = (ecx >> 19) & 1;
+        const bool have_aesni = (ecx >> 25) & 1;
+        if (have_sse41 && have_aesni) {
+            fn = cnfn_x86_aesni::MemHard;
+            ret = "x86_aesni";
+        }
+    }
+#endif
+
+#if defined(ENABLE_ARM_AES)
+    bool have_arm_aes = false;
+    if (use_implementation & cnfn_implementation::USE_AES) {
+#if defined(__linux__)
+#if defined(__arm__) // 32-bit
+        if (getauxval(AT_HWCAP2) & HWCAP2_AES) {
+            have_arm_aes = true;
+        }
+#endif
+#if defined(__aarch64__) // 64-bit
+        if (getauxval(AT_HWCAP) & HWCAP_AES) {
+            have_arm_aes = true;
+        }
+#endif
+#endif
+
+#if defined(__APPLE__)
+        int val = 0;
+        size_t len = sizeof(val);
+        if (sysctlbyname("hw.optional.arm.FEAT_AES", &val, &len, nullptr, 0) == 0) {
+            have_arm_aes = val != 0;
+        }
+#endif
+    }
+
+    if (have_arm_aes) {
+        fn = cnfn_arm_aes::MemHard;
+        ret = "arm_aes";
+    }
+#endif
+
+    if (fn != nullptr) {
+        assert(SelfTest(fn));
+    }
+    cnfn_set_memhard(fn);
+    return ret;
+}
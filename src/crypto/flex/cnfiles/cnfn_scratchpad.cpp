@@ -0,0 +1,73 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cnfn.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+namespace {
+//! Alignment of the heap fallback; keeps 16-byte blocks from straddling cache lines.
+constexpr size_t CACHE_LINE_SIZE = 64;
+//! Size of a transparent huge page on the platforms that offer them.
+[[maybe_unused]] constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/** A CNFN_PAGE_SIZE scratchpad, owned by a single thread for its lifetime. */
+class Scratchpad
+{
+    uint8_t* m_data{nullptr};
+    [[maybe_unused]] bool m_mapped{false};
+
+public:
+    Scratchpad()
+    {
+#if defined(MADV_HUGEPAGE) && defined(MAP_ANONYMOUS)
+        // Over-allocate so the scratchpad can start on a huge page boundary,
+        // then return the unused head and tail to the OS.
+        const size_t map_size = CNFN_PAGE_SIZE + HUGE_PAGE_SIZE;
+        void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map != MAP_FAILED) {
+            uint8_t* base = static_cast<uint8_t*>(map);
+            uint8_t* aligned = base + ((HUGE_PAGE_SIZE - reinterpret_cast<uintptr_t>(base) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE);
+            if (aligned != base) munmap(base, aligned - base);
+            const size_t tail = (base + map_size) - (aligned + CNFN_PAGE_SIZE);
+            if (tail > 0) munmap(aligned + CNFN_PAGE_SIZE, tail);
+            // Only advice: the kernel may still back the range with small pages.
+            madvise(aligned, CNFN_PAGE_SIZE, MADV_HUGEPAGE);
+            m_data = aligned;
+            m_mapped = true;
+            return;
+        }
+#endif
+        m_data = static_cast<uint8_t*>(::operator new(CNFN_PAGE_SIZE, std::align_val_t{CACHE_LINE_SIZE}));
+    }
+
+    ~Scratchpad()
+    {
+#if defined(MADV_HUGEPAGE) && defined(MAP_ANONYMOUS)
+        if (m_mapped) {
+            munmap(m_data, CNFN_PAGE_SIZE);
+            return;
+        }
+#endif
+        ::operator delete(m_data, std::align_val_t{CACHE_LINE_SIZE});
+    }
+
+    Scratchpad(const Scratchpad&) = delete;
+    Scratchpad& operator=(const Scratchpad&) = delete;
+
+    uint8_t* data() const { return m_data; }
+};
+} // namespace
+
+uint8_t* cnfn_scratchpad()
+{
+    static thread_local Scratchpad scratchpad;
+    return scratchpad.data();
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-NI version of the CryptoNight memory-hard loop used by cnfn_slow_hash.
+// Based on the CryptoNote reference slow-hash.c AES-NI code.
+
+#if defined(ENABLE_X86_AESNI)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <attributes.h>
+
+namespace {
+
+constexpr size_t AES_BLOCK_SIZE = 16;
+constexpr size_t INIT_SIZE_BLK = 8;
+constexpr size_t INIT_SIZE_BYTE = INIT_SIZE_BLK * AES_BLOCK_SIZE;
+//! Offset of the scratchpad init blocks in the Keccak state.
+constexpr size_t STATE_INIT_OFFSET = 64;
+
+__m128i ALWAYS_INLINE ShiftLeftXor(__m128i x)
+{
+    __m128i t = _mm_slli_si128(x, 4);
+    x = _mm_xor_si128(x, t);
+    t = _mm_slli_si128(t, 4);
+    x = _mm_xor_si128(x, t);
+    t = _mm_slli_si128(t, 4);
+    return _mm_xor_si128(x, t);
+}
+
+template <int RCON>
+void ALWAYS_INLINE GenKeySub(__m128i& k0, __m128i& k1)
+{
+    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, RCON), 0xFF);
+    k0 = _mm_xor_si128(ShiftLeftXor(k0), t);
+    t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k0, 0x00), 0xAA);
+    k1 = _mm_xor_si128(ShiftLeftXor(k1), t);
+}
+
+/** First ten AES-256 round keys of a 32-byte key, as used by the pseudo rounds. */
+void ExpandKey(const uint8_t* key, __m128i (&k)[10])
+{
+    k[0] = _mm_loadu_si128((const __m128i*)key);
+    k[1] = _mm_loadu_si128((const __m128i*)(key + 16));
+    k[2] = k[0]; k[3] = k[1];
+    GenKeySub<0x01>(k[2], k[3]);
+    k[4] = k[2]; k[5] = k[3];
+    GenKeySub<0x02>(k[4], k[5]);
+    k[6] = k[4]; k[7] = k[5];
+    GenKeySub<0x04>(k[6], k[7]);
+    k[8] = k[6]; k[9] = k[7];
+    GenKeySub<0x08>(k[8], k[9]);
+}
+
+/** Ten full AES rounds without the initial key whitening (aesb_pseudo_round). */
+__m128i ALWAYS_INLINE PseudoRound(__m128i x, const __m128i (&k)[10])
+{
+    for (int r = 0; r < 10; ++r) x = _mm_aesenc_si128(x, k[r]);
+    return x;
+}
+
+uint64_t ALWAYS_INLINE Mul128(uint64_t a, uint64_t b, uint64_t& hi)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    hi = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#else
+    const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+uint64_t ALWAYS_INLINE Low64(__m128i x) { uint64_t r; memcpy(&r, &x, 8); return r; }
+
+} // namespace
+
+namespace cnfn_x86_aesni {
+void MemHard(uint8_t* state, uint8_t* long_state, int variant, uint64_t tweak1_2, uint32_t page_size, uint32_t iterations, size_t aes_rounds)
+{
+    const size_t init_rounds = page_size / INIT_SIZE_BYTE;
+    const size_t mask = (aes_rounds - 1) * AES_BLOCK_SIZE;
+    __m128i k[10];
+    __m128i x[INIT_SIZE_BLK];
+
+    // Explode the Keccak state into the scratchpad.
+    ExpandKey(state, k);
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        x[j] = _mm_loadu_si128((const __m128i*)(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE));
+    }
+    for (size_t i = 0; i < init_rounds; ++i) {
+        __m128i* out = (__m128i*)(long_state + i * INIT_SIZE_BYTE);
+        for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+            x[j] = PseudoRound(x[j], k);
+            _mm_storeu_si128(out + j, x[j]);
+        }
+    }
+
+    // Main loop.
+    __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)state), _mm_loadu_si128((const __m128i*)(state + 32)));
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(state + 16)), _mm_loadu_si128((const __m128i*)(state + 48)));
+    const __m128i tweak = _mm_set_epi64x(variant == 1 ? (int64_t)tweak1_2 : 0, 0);
+    for (uint32_t i = 0; i < iterations; ++i) {
+        uint8_t* p = long_state + (Low64(a) & mask);
+        const __m128i c = _mm_aesenc_si128(_mm_loadu_si128((const __m128i*)p), a);
+        _mm_storeu_si128((__m128i*)p, _mm_xor_si128(b, c));
+        if (variant == 1) {
+            const uint8_t tmp = p[11];
+            static const uint32_t table = 0x75310;
+            const uint8_t index = (((tmp >> 3) & 6) | (tmp & 1)) << 1;
+            p[11] = tmp ^ ((table >> index) & 0x30);
+        }
+
+        const uint64_t c_lo = Low64(c);
+        p = long_state + (c_lo & mask);
+        const __m128i t = _mm_loadu_si128((const __m128i*)p);
+        uint64_t hi;
+        const uint64_t lo = Mul128(c_lo, Low64(t), hi);
+        a = _mm_add_epi64(a, _mm_set_epi64x((int64_t)lo, (int64_t)hi));
+        _mm_storeu_si128((__m128i*)p, _mm_xor_si128(a, tweak));
+        a = _mm_xor_si128(a, t);
+        b = c;
+    }
+
+    // Implode the scratchpad back into the Keccak state.
+    ExpandKey(state + 32, k);
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        x[j] = _mm_loadu_si128((const __m128i*)(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE));
+    }
+    for (size_t i = 0; i < init_rounds; ++i) {
+        const __m128i* in = (const __m128i*)(long_state + i * INIT_SIZE_BYTE);
+        for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+            x[j] = PseudoRound(_mm_xor_si128(x[j], _mm_loadu_si128(in + j)), k);
+        }
+    }
+    for (size_t j = 0; j < INIT_SIZE_BLK; ++j) {
+        _mm_storeu_si128((__m128i*)(state + STATE_INIT_OFFSET + j * AES_BLOCK_SIZE), x[j]);
+    }
+}
+} // namespace cnfn_x86_aesni
+
+#endif
@@ -192,6 +192,11 @@ OAES_API OAES_RET oaes_key_import( OAES_CTX * ctx,
 OAES_API OAES_RET oaes_key_import_data( OAES_CTX * ctx,
 		const uint8_t * data, size_t data_len );
 
+// expand 16, 24 or 32 bytes of key data into a caller-provided buffer
+// without allocating; set exp_data == NULL to get the required exp_data_len
+OAES_API OAES_RET oaes_key_expand_data( const uint8_t * data, size_t data_len,
+		uint8_t * exp_data, size_t * exp_data_len );
+
 // set c == NULL to get the required c_len
 OAES_API OAES_RET oaes_encrypt( OAES_CTX * ctx,
 		const uint8_t * m, size_t m_len, uint8_t * c, size_t * c_len );
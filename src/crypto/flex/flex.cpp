@@ -2,7 +2,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <vector>
 #include "cnfiles/cnfn.h"
+#include <crypto/sha3.h>
 #include "sph/extra.h"
 #include "sph/sph_blake.h"
 #include "sph/sph_bmw.h"
@@ -95,182 +97,148 @@ void print_hex_memory(void* mem, unsigned int size) {
     printf("\n");
 }
 
-void flex_hash(const char* input, int size, unsigned char* output) {
-    uint32_t hash[64 / 4];
-    sph_blake512_context ctx_blake;
-    sph_bmw512_context ctx_bmw;
-    sph_groestl512_context ctx_groestl;
-    sph_keccak512_context ctx_keccak;
-    sph_skein512_context ctx_skein;
-    sph_luffa512_context ctx_luffa;
-    sph_cubehash512_context ctx_cubehash;
-    sph_shavite512_context ctx_shavite;
-    sph_simd512_context ctx_simd;
-    sph_echo512_context ctx_echo;
-    sph_hamsi512_context ctx_hamsi;
-    sph_fugue512_context ctx_fugue;
-    sph_shabal512_context ctx_shabal;
-    sph_whirlpool_context ctx_whirlpool;
-
-    void* in = const_cast<void*>(static_cast<const void*>(input));
-    sph_keccak512_init(&ctx_keccak);
-    sph_keccak512(&ctx_keccak, in, size);
-    sph_keccak512_close(&ctx_keccak, hash);
+//! Scratch space for whichever sph primitive a stage runs; one is reused for all stages.
+union FlexContext {
+    sph_blake512_context blake;
+    sph_bmw512_context bmw;
+    sph_groestl512_context groestl;
+    sph_keccak512_context keccak;
+    sph_skein512_context skein;
+    sph_luffa512_context luffa;
+    sph_cubehash512_context cubehash;
+    sph_shavite512_context shavite;
+    sph_simd512_context simd;
+    sph_echo512_context echo;
+    sph_hamsi512_context hamsi;
+    sph_fugue512_context fugue;
+    sph_shabal512_context shabal;
+    sph_whirlpool_context whirlpool;
+};
 
-    uint8_t selectedAlgoOutput[15] = { 0 };
-    uint8_t selectedCNAlgoOutput[6] = { 0 };
-    getAlgoString(&hash, 64, selectedAlgoOutput, static_cast<int>(Algo::HASH_FUNC_COUNT));
-    getAlgoString(&hash, 64, selectedCNAlgoOutput, static_cast<int>(CNFNAlgo::CNFN_HASH_FUNC_COUNT));
+// One stage of Flex: hash size bytes at in into hash (which in may alias).
+typedef void (*FlexStage)(FlexContext& ctx, const void* in, int size, uint32_t (&hash)[64 / 4]);
 
-    for (int i = 0; i < 18; ++i) {
-        uint8_t algo;
-        uint8_t cnAlgo;
-        int coreSelection;
-        int cnSelection = -1;
+template <void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+static void CoreStage(FlexContext& ctx, const void* in, int size, uint32_t (&hash)[64 / 4]) {
+    Init(&ctx);
+    Update(&ctx, in, size);
+    Close(&ctx, hash);
+}
 
-        if (i < 5) {
-            coreSelection = i;
-        }
-        else if (i < 11) {
-            coreSelection = i - 1;
-        }
-        else {
-            coreSelection = i - 2;
-        }
+template <void (*Hash)(const char*, char*, uint32_t, int)>
+static void CNStage(FlexContext& ctx, const void* in, int size, uint32_t (&hash)[64 / 4]) {
+    Hash(static_cast<const char*>(in), reinterpret_cast<char*>(hash), size, 1);
+}
 
-        if (i == 5) {
-            coreSelection = -1;
-            cnSelection = 0;
-        }
-        if (i == 11) {
-            coreSelection = -1;
-            cnSelection = 1;
-        }
-        if (i == 17) {
-            coreSelection = -1;
-            cnSelection = 2;
-        }
+// Indexed by Algo
+static const FlexStage CORE_STAGES[static_cast<int>(Algo::HASH_FUNC_COUNT)] = {
+    CoreStage<sph_blake512_init, sph_blake512, sph_blake512_close>,
+    CoreStage<sph_bmw512_init, sph_bmw512, sph_bmw512_close>,
+    CoreStage<sph_groestl512_init, sph_groestl512, sph_groestl512_close>,
+    CoreStage<sph_keccak512_init, sph_keccak512, sph_keccak512_close>,
+    CoreStage<sph_skein512_init, sph_skein512, sph_skein512_close>,
+    CoreStage<sph_luffa512_init, sph_luffa512, sph_luffa512_close>,
+    CoreStage<sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>,
+    CoreStage<sph_shavite512_init, sph_shavite512, sph_shavite512_close>,
+    CoreStage<sph_simd512_init, sph_simd512, sph_simd512_close>,
+    CoreStage<sph_echo512_init, sph_echo512, sph_echo512_close>,
+    CoreStage<sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close>,
+    CoreStage<sph_fugue512_init, sph_fugue512, sph_fugue512_close>,
+    CoreStage<sph_shabal512_init, sph_shabal512, sph_shabal512_close>,
+    CoreStage<sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close>,
+};
 
-        if (coreSelection >= 0) {
-            algo = selectedAlgoOutput[static_cast<uint8_t>(coreSelection)];
-        }
-        else {
-            algo = static_cast<uint8_t>(Algo::HASH_FUNC_COUNT) + 1; // skip core hashing for this loop iteration
-        }
+// Indexed by CNFNAlgo
+static const FlexStage CN_STAGES[static_cast<int>(CNFNAlgo::CNFN_HASH_FUNC_COUNT)] = {
+    CNStage<crypto::cnfn_dark_hash>,
+    CNStage<crypto::cnfn_darklite_hash>,
+    CNStage<crypto::cnfn_cnfast_hash>,
+    CNStage<crypto::cnfn_cnlite_hash>,
+    CNStage<crypto::cnfn_turtle_hash>,
+    CNStage<crypto::cnfn_turtlelite_hash>,
+};
 
-        if (cnSelection >= 0) {
-            cnAlgo = selectedCNAlgoOutput[static_cast<uint8_t>(cnSelection)];
-        }
-        else {
-            cnAlgo = static_cast<uint8_t>(CNFNAlgo::CNFN_HASH_FUNC_COUNT) + 1; // skip cn hashing for this loop iteration
-        }
+static const int FLEX_STAGES = 18;
+
+// Derives the stage order from the Keccak-512 digest of the input: 15 core
+// primitives, with CryptoNight variants as stages 5, 11 and 17. Both orders
+// come from one pass over the digest nibbles, as getAlgoString would produce
+// them separately.
+static void flex_schedule(const uint32_t (&hash)[64 / 4], FlexStage (&schedule)[FLEX_STAGES]) {
+    const int core_count = static_cast<int>(Algo::HASH_FUNC_COUNT);
+    const int cn_count = static_cast<int>(CNFNAlgo::CNFN_HASH_FUNC_COUNT);
+    uint8_t core[15] = { 0 };
+    uint8_t cn[6] = { 0 };
+    bool core_selected[15] = { false };
+    bool cn_selected[15] = { false };
+    int core_selected_count = 0;
+    int cn_selected_count = 0;
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(hash);
+    for (unsigned int i = 0; i < 64 / 2; ++i) {
+        if (core_selected_count < core_count) selectAlgo(p[i], core_selected, core, core_count, core_selected_count);
+        if (cn_selected_count < cn_count) selectAlgo(p[i], cn_selected, cn, cn_count, cn_selected_count);
+        if (core_selected_count == core_count && cn_selected_count == cn_count) break;
+    }
+    for (uint8_t i = 0; i < core_count && core_selected_count < core_count; ++i) {
+        if (!core_selected[i]) core[core_selected_count++] = i;
+    }
+    for (uint8_t i = 0; i < cn_count && cn_selected_count < cn_count; ++i) {
+        if (!cn_selected[i]) cn[cn_selected_count++] = i;
+    }
 
-        // selection cnAlgo. if a CN algo is selected then core algo will not be selected
-        switch (static_cast<CNFNAlgo>(cnAlgo)) {
-            case CNFNAlgo::CNFNDark:
-                crypto::cnfn_dark_hash((char*)in, (char*)hash, size, 1);
-                break;
-            case CNFNAlgo::CNFNDarklite:
-                crypto::cnfn_darklite_hash((char*)in, (char*)hash, size, 1);
-                break;
-            case CNFNAlgo::CNFNFast:
-                crypto::cnfn_cnfast_hash((char*)in, (char*)hash, size, 1);
-                break;
-            case CNFNAlgo::CNFNLite:
-                crypto::cnfn_cnlite_hash((char*)in, (char*)hash, size, 1);
-                break;
-            case CNFNAlgo::CNFNTurtle:
-                crypto::cnfn_turtle_hash((char*)in, (char*)hash, size, 1);
-                break;
-            case CNFNAlgo::CNFNTurtlelite:
-                crypto::cnfn_turtlelite_hash((char*)in, (char*)hash, size, 1);
-                break;
-            default:
-                break;
+    for (int i = 0, next_core = 0, next_cn = 0; i < FLEX_STAGES; ++i) {
+        if (i == 5 || i == 11 || i == 17) {
+            schedule[i] = CN_STAGES[cn[next_cn++]];
+        } else {
+            schedule[i] = CORE_STAGES[core[next_core++]];
         }
+    }
+}
 
-        // selection core algo
-        switch (static_cast<Algo>(algo)) {
-            case Algo::BLAKE:
-                sph_blake512_init(&ctx_blake);
-                sph_blake512(&ctx_blake, in, size);
-                sph_blake512_close(&ctx_blake, hash);
-                break;
-            case Algo::BMW:
-                sph_bmw512_init(&ctx_bmw);
-                sph_bmw512(&ctx_bmw, in, size);
-                sph_bmw512_close(&ctx_bmw, hash);
-                break;
-            case Algo::GROESTL:
-                sph_groestl512_init(&ctx_groestl);
-                sph_groestl512(&ctx_groestl, in, size);
-                sph_groestl512_close(&ctx_groestl, hash);
-                break;
-            case Algo::KECCAK:
-                sph_keccak512_init(&ctx_keccak);
-                sph_keccak512(&ctx_keccak, in, size);
-                sph_keccak512_close(&ctx_keccak, hash);
-                break;
-            case Algo::SKEIN:
-                sph_skein512_init(&ctx_skein);
-                sph_skein512(&ctx_skein, in, size);
-                sph_skein512_close(&ctx_skein, hash);
-                break;
-            case Algo::LUFFA:
-                sph_luffa512_init(&ctx_luffa);
-                sph_luffa512(&ctx_luffa, in, size);
-                sph_luffa512_close(&ctx_luffa, hash);
-                break;
-            case Algo::CUBEHASH:
-                sph_cubehash512_init(&ctx_cubehash);
-                sph_cubehash512(&ctx_cubehash, in, size);
-                sph_cubehash512_close(&ctx_cubehash, hash);
-                break;
-            case Algo::SHAVITE:
-                sph_shavite512_init(&ctx_shavite);
-                sph_shavite512(&ctx_shavite, in, size);
-                sph_shavite512_close(&ctx_shavite, hash);
-                break;
-            case Algo::SIMD:
-                sph_simd512_init(&ctx_simd);
-                sph_simd512(&ctx_simd, in, size);
-                sph_simd512_close(&ctx_simd, hash);
-                break;
-            case Algo::ECHO:
-                sph_echo512_init(&ctx_echo);
-                sph_echo512(&ctx_echo, in, size);
-                sph_echo512_close(&ctx_echo, hash);
-                break;
-            case Algo::HAMSI:
-                sph_hamsi512_init(&ctx_hamsi);
-                sph_hamsi512(&ctx_hamsi, in, size);
-                sph_hamsi512_close(&ctx_hamsi, hash);
-                break;
-            case Algo::FUGUE:
-                sph_fugue512_init(&ctx_fugue);
-                sph_fugue512(&ctx_fugue, in, size);
-                sph_fugue512_close(&ctx_fugue, hash);
-                break;
-            case Algo::SHABAL:
-                sph_shabal512_init(&ctx_shabal);
-                sph_shabal512(&ctx_shabal, in, size);
-                sph_shabal512_close(&ctx_shabal, hash);
-                break;
-            case Algo::WHIRLPOOL:
-                sph_whirlpool_init(&ctx_whirlpool);
-                sph_whirlpool(&ctx_whirlpool, in, size);
-                sph_whirlpool_close(&ctx_whirlpool, hash);
-                break;
-            default:
-                break;
-        }
+// Runs the 18 selected stages. On entry hash holds the Keccak-512 digest of
+// the input, which drives the selection; on exit it holds the last stage.
+static void flex_rounds(FlexContext& ctx, const char* input, int size, uint32_t (&hash)[64 / 4]) {
+    FlexStage schedule[FLEX_STAGES];
+    flex_schedule(hash, schedule);
 
-        in = static_cast<void*>(hash);
+    const void* in = input;
+    for (int i = 0; i < FLEX_STAGES; ++i) {
+        schedule[i](ctx, in, size, hash);
+        in = hash;
         size = 64;
     }
+}
+
+void flex_hash(const char* input, int size, unsigned char* output) {
+    uint32_t hash[64 / 4];
+    sph_keccak512_context ctx_keccak;
+
+    sph_keccak512_init(&ctx_keccak);
+    sph_keccak512(&ctx_keccak, input, size);
+    sph_keccak512_close(&ctx_keccak, hash);
+
+    FlexContext ctx;
+    flex_rounds(ctx, input, size, hash);
 
     sph_keccak256_init(&ctx_keccak);
-    sph_keccak256(&ctx_keccak, in, size);
+    sph_keccak256(&ctx_keccak, hash, 64);
     sph_keccak256_close(&ctx_keccak, hash);
     std::memcpy(output, hash, 32);
 }
+
+void flex_hash_many(const char* input, int size, size_t count, unsigned char* output) {
+    // The sph Keccak used for the entry and exit rounds pads like SHA-3 (0x06),
+    // at rates of 72 and 136 bytes; with equally sized inputs they run several
+    // lanes at once.
+    std::vector<uint32_t> hashes(count * 64 / 4);
+    KeccakMany(reinterpret_cast<unsigned char*>(hashes.data()), 64, reinterpret_cast<const unsigned char*>(input), size, count, 72, 0x06);
+
+    FlexContext ctx;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t (&hash)[64 / 4] = *reinterpret_cast<uint32_t(*)[64 / 4]>(hashes.data() + i * 64 / 4);
+        flex_rounds(ctx, input + i * size, size, hash);
+    }
+
+    KeccakMany(output, 32, reinterpret_cast<const unsigned char*>(hashes.data()), 64, count, 136, 0x06);
+}
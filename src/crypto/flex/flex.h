@@ -1 +1,7 @@
-void flex_hash(const char* input, int size, unsigned char* output);
\ No newline at end of file
+#include <cstddef>
+
+void flex_hash(const char* input, int size, unsigned char* output);
+// Hashes count inputs of size bytes each, stored back to back, into count * 32
+// bytes of output. The Keccak entry and exit rounds run several inputs at once,
+// and all inputs share one set of scratch state for the stages in between.
+void flex_hash_many(const char* input, int size, size_t count, unsigned char* output);
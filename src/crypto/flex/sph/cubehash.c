@@ -531,6 +531,31 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+static void
+cubehash_rounds_portable(sph_u32 *state, unsigned n)
+{
+	struct {
+		sph_u32 *state;
+	} st, *sc;
+	DECL_STATE
+
+	st.state = state;
+	sc = &st;
+	READ_STATE(sc);
+	while (n -- > 0)
+		SIXTEEN_ROUNDS;
+	WRITE_STATE(sc);
+}
+
+static sph_cubehash_rounds_fn cubehash_rounds = cubehash_rounds_portable;
+
+/* see sph_cubehash.h */
+void
+sph_cubehash_set_rounds(sph_cubehash_rounds_fn fn)
+{
+	cubehash_rounds = fn ? fn : cubehash_rounds_portable;
+}
+
 static void
 cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 {
@@ -543,7 +568,7 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 {
 	unsigned char *buf;
 	size_t ptr;
-	DECL_STATE
+	unsigned z;
 
 	buf = sc->buf;
 	ptr = sc->ptr;
@@ -554,7 +579,6 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		return;
 	}
 
-	READ_STATE(sc);
 	while (len > 0) {
 		size_t clen;
 
@@ -566,12 +590,12 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
-			INPUT_BLOCK;
-			SIXTEEN_ROUNDS;
+			for (z = 0; z < 8; z ++)
+				sc->state[z] ^= sph_dec32le_aligned(buf + (z << 2));
+			cubehash_rounds(sc->state, 1);
 			ptr = 0;
 		}
 	}
-	WRITE_STATE(sc);
 	sc->ptr = ptr;
 }
 
@@ -583,21 +607,17 @@ cubehash_close(sph_cubehash_context *sc, unsigned ub, unsigned n,
 	size_t ptr;
 	unsigned z;
 	int i;
-	DECL_STATE
 
 	buf = sc->buf;
 	ptr = sc->ptr;
 	z = 0x80 >> n;
 	buf[ptr ++] = ((ub & -z) | z) & 0xFF;
 	memset(buf + ptr, 0, (sizeof sc->buf) - ptr);
-	READ_STATE(sc);
-	INPUT_BLOCK;
-	for (i = 0; i < 11; i ++) {
-		SIXTEEN_ROUNDS;
-		if (i == 0)
-			xv ^= SPH_C32(1);
-	}
-	WRITE_STATE(sc);
+	for (i = 0; i < 8; i ++)
+		sc->state[i] ^= sph_dec32le_aligned(buf + (i << 2));
+	cubehash_rounds(sc->state, 1);
+	sc->state[31] ^= SPH_C32(1);
+	cubehash_rounds(sc->state, 10);
 	out = dst;
 	for (z = 0; z < out_size_w32; z ++)
 		sph_enc32le(out + (z << 2), sc->state[z]);
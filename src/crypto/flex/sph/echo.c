@@ -720,13 +720,22 @@ echo_small_compress(sph_echo_small_context *sc)
 }
 
 static void
-echo_big_compress(sph_echo_big_context *sc)
+echo_big_compress_portable(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
 	COMPRESS_BIG(sc);
 }
 
+static sph_echo_big_compress_fn echo_big_compress = echo_big_compress_portable;
+
+/* see sph_echo.h */
+void
+sph_echo_set_big_compress(sph_echo_big_compress_fn fn)
+{
+	echo_big_compress = fn ? fn : echo_big_compress_portable;
+}
+
 static void
 echo_small_core(sph_echo_small_context *sc,
 	const unsigned char *data, size_t len)
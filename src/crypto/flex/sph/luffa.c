@@ -1215,12 +1215,36 @@ luffa4_close(sph_luffa384_context *sc, unsigned ub, unsigned n, void *dst)
 	}
 }
 
+static void
+luffa5_step_portable(sph_u32 V[5][8], const unsigned char *buf)
+{
+	struct {
+		sph_u32 (*V)[8];
+	} st, *sc;
+	DECL_STATE5
+
+	st.V = V;
+	sc = &st;
+	READ_STATE5(sc);
+	MI5;
+	P5;
+	WRITE_STATE5(sc);
+}
+
+static sph_luffa512_step_fn luffa5_step = luffa5_step_portable;
+
+/* see sph_luffa.h */
+void
+sph_luffa512_set_step(sph_luffa512_step_fn fn)
+{
+	luffa5_step = fn ? fn : luffa5_step_portable;
+}
+
 static void
 luffa5(sph_luffa512_context *sc, const void *data, size_t len)
 {
 	unsigned char *buf;
 	size_t ptr;
-	DECL_STATE5
 
 	buf = sc->buf;
 	ptr = sc->ptr;
@@ -1231,7 +1255,6 @@ luffa5(sph_luffa512_context *sc, const void *data, size_t len)
 		return;
 	}
 
-	READ_STATE5(sc);
 	while (len > 0) {
 		size_t clen;
 
@@ -1243,12 +1266,10 @@ luffa5(sph_luffa512_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
-			MI5;
-			P5;
+			luffa5_step(sc->V, buf);
 			ptr = 0;
 		}
 	}
-	WRITE_STATE5(sc);
 	sc->ptr = ptr;
 }
 
@@ -1259,7 +1280,6 @@ luffa5_close(sph_luffa512_context *sc, unsigned ub, unsigned n, void *dst)
 	size_t ptr;
 	unsigned z;
 	int i;
-	DECL_STATE5
 
 	buf = sc->buf;
 	ptr = sc->ptr;
@@ -1267,34 +1287,14 @@ luffa5_close(sph_luffa512_context *sc, unsigned ub, unsigned n, void *dst)
 	z = 0x80 >> n;
 	buf[ptr ++] = ((ub & -z) | z) & 0xFF;
 	memset(buf + ptr, 0, (sizeof sc->buf) - ptr);
-	READ_STATE5(sc);
 	for (i = 0; i < 3; i ++) {
-		MI5;
-		P5;
-		switch (i) {
-		case 0:
-			memset(buf, 0, sizeof sc->buf);
-			break;
-		case 1:
-			sph_enc32be(out +  0, V00 ^ V10 ^ V20 ^ V30 ^ V40);
-			sph_enc32be(out +  4, V01 ^ V11 ^ V21 ^ V31 ^ V41);
-			sph_enc32be(out +  8, V02 ^ V12 ^ V22 ^ V32 ^ V42);
-			sph_enc32be(out + 12, V03 ^ V13 ^ V23 ^ V33 ^ V43);
-			sph_enc32be(out + 16, V04 ^ V14 ^ V24 ^ V34 ^ V44);
-			sph_enc32be(out + 20, V05 ^ V15 ^ V25 ^ V35 ^ V45);
-			sph_enc32be(out + 24, V06 ^ V16 ^ V26 ^ V36 ^ V46);
-			sph_enc32be(out + 28, V07 ^ V17 ^ V27 ^ V37 ^ V47);
-			break;
-		case 2:
-			sph_enc32be(out + 32, V00 ^ V10 ^ V20 ^ V30 ^ V40);
-			sph_enc32be(out + 36, V01 ^ V11 ^ V21 ^ V31 ^ V41);
-			sph_enc32be(out + 40, V02 ^ V12 ^ V22 ^ V32 ^ V42);
-			sph_enc32be(out + 44, V03 ^ V13 ^ V23 ^ V33 ^ V43);
-			sph_enc32be(out + 48, V04 ^ V14 ^ V24 ^ V34 ^ V44);
-			sph_enc32be(out + 52, V05 ^ V15 ^ V25 ^ V35 ^ V45);
-			sph_enc32be(out + 56, V06 ^ V16 ^ V26 ^ V36 ^ V46);
-			sph_enc32be(out + 60, V07 ^ V17 ^ V27 ^ V37 ^ V47);
-			break;
+		luffa5_step(sc->V, buf);
+		memset(buf, 0, sizeof sc->buf);
+		if (i > 0) {
+			for (z = 0; z < 8; z ++)
+				sph_enc32be(out + ((i - 1) << 5) + (z << 2),
+					sc->V[0][z] ^ sc->V[1][z] ^ sc->V[2][z]
+					^ sc->V[3][z] ^ sc->V[4][z]);
 		}
 	}
 }
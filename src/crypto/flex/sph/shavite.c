@@ -726,7 +726,7 @@ c256(sph_shavite_small_context *sc, const void *msg)
  * This function assumes that "msg" is aligned for 32-bit access.
  */
 static void
-c512(sph_shavite_big_context *sc, const void *msg)
+c512_portable(sph_shavite_big_context *sc, const void *msg)
 {
 	sph_u32 p0, p1, p2, p3, p4, p5, p6, p7;
 	sph_u32 p8, p9, pA, pB, pC, pD, pE, pF;
@@ -897,7 +897,7 @@ c512(sph_shavite_big_context *sc, const void *msg)
  * This function assumes that "msg" is aligned for 32-bit access.
  */
 static void
-c512(sph_shavite_big_context *sc, const void *msg)
+c512_portable(sph_shavite_big_context *sc, const void *msg)
 {
 	sph_u32 p0, p1, p2, p3, p4, p5, p6, p7;
 	sph_u32 p8, p9, pA, pB, pC, pD, pE, pF;
@@ -1550,6 +1550,15 @@ shavite_small_close(sph_shavite_small_context *sc,
 		sph_enc32le((unsigned char *)dst + (u << 2), sc->h[u]);
 }
 
+static sph_shavite_big_compress_fn c512 = c512_portable;
+
+/* see sph_shavite.h */
+void
+sph_shavite_set_big_compress(sph_shavite_big_compress_fn fn)
+{
+	c512 = fn ? fn : c512_portable;
+}
+
 static void
 shavite_big_init(sph_shavite_big_context *sc, const sph_u32 *iv)
 {
@@ -0,0 +1,200 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AVX2 versions of the CubeHash rounds and the Luffa-512 step used by Flex.
+// CubeHash keeps its 32-word state in four registers; Luffa runs its five
+// 256-bit sub-permutations side by side, one per 32-bit lane. The portable
+// code in cubehash.c and luffa.c is the reference.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <attributes.h>
+#include <crypto/flex/sph/sph_cubehash.h>
+#include <crypto/flex/sph/sph_luffa.h>
+
+namespace {
+
+template <int N>
+__m256i ALWAYS_INLINE Rotl(__m256i x) { return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N)); }
+
+//! Luffa step constants for the five sub-permutations, one lane each (RC00..RC40 and RC04..RC44 in luffa.c).
+alignas(32) const uint32_t LUFFA_RC0[8][8] = {
+    {0x303994a6, 0xb6de10ed, 0xfc20d9d2, 0xb213afa5, 0xf0d2e9e3, 0, 0, 0},
+    {0xc0e65299, 0x70f47aae, 0x34552e25, 0xc84ebe95, 0xac11d7fa, 0, 0, 0},
+    {0x6cc33a12, 0x0707a3d4, 0x7ad8818f, 0x4e608a22, 0x1bcb66f2, 0, 0, 0},
+    {0xdc56983e, 0x1c1e8f51, 0x8438764a, 0x56d858fe, 0x6f2d9bc9, 0, 0, 0},
+    {0x1e00108f, 0x707a3d45, 0xbb6de032, 0x343b138f, 0x78602649, 0, 0, 0},
+    {0x7800423d, 0xaeb28562, 0xedb780c8, 0xd0ec4e3d, 0x8edae952, 0, 0, 0},
+    {0x8f5b7882, 0xbaca1589, 0xd9847356, 0x2ceb4882, 0x3b6ba548, 0, 0, 0},
+    {0x96e1db12, 0x40a46f3e, 0xa2c78434, 0xb3ad2208, 0xedae9520, 0, 0, 0},
+};
+alignas(32) const uint32_t LUFFA_RC4[8][8] = {
+    {0xe0337818, 0x01685f3d, 0xe25e72c1, 0xe028c9bf, 0x5090d577, 0, 0, 0},
+    {0x441ba90d, 0x05a17cf4, 0xe623bb72, 0x44756f91, 0x2d1925ab, 0, 0, 0},
+    {0x7f34d442, 0xbd09caca, 0x5c58a4a4, 0x7e8fce32, 0xb46496ac, 0, 0, 0},
+    {0x9389217f, 0xf4272b28, 0x1e38e2e7, 0x956548be, 0xd1925ab0, 0, 0, 0},
+    {0xe5a8bce6, 0x144ae5cc, 0x78e38b9d, 0xfe191be2, 0x29131ab6, 0, 0, 0},
+    {0x5274baf4, 0xfaa7ae2b, 0x27586719, 0x3cb226e5, 0x0fc053c3, 0, 0, 0},
+    {0x26889ba7, 0x2e48f1c1, 0x36eda57f, 0x5944a28e, 0x3f014f0c, 0, 0, 0},
+    {0x9a226e9d, 0xb923c704, 0x703aace7, 0xa1c4c355, 0xfc053c31, 0, 0, 0},
+};
+
+void ALWAYS_INLINE SubCrumb(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3)
+{
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i tmp = a0;
+    a0 = _mm256_or_si256(a0, a1);
+    a2 = _mm256_xor_si256(a2, a3);
+    a1 = _mm256_xor_si256(a1, ones);
+    a0 = _mm256_xor_si256(a0, a3);
+    a3 = _mm256_and_si256(a3, tmp);
+    a1 = _mm256_xor_si256(a1, a3);
+    a3 = _mm256_xor_si256(a3, a2);
+    a2 = _mm256_and_si256(a2, a0);
+    a0 = _mm256_xor_si256(a0, ones);
+    a2 = _mm256_xor_si256(a2, a1);
+    a1 = _mm256_or_si256(a1, a3);
+    tmp = _mm256_xor_si256(tmp, a1);
+    a3 = _mm256_xor_si256(a3, a2);
+    a2 = _mm256_and_si256(a2, a1);
+    a1 = _mm256_xor_si256(a1, a0);
+    a0 = tmp;
+}
+
+void ALWAYS_INLINE MixWord(__m256i& u, __m256i& v)
+{
+    v = _mm256_xor_si256(v, u);
+    u = _mm256_xor_si256(Rotl<2>(u), v);
+    v = _mm256_xor_si256(Rotl<14>(v), u);
+    u = _mm256_xor_si256(Rotl<10>(u), v);
+    v = Rotl<1>(v);
+}
+
+/** Luffa message injection (MI5 in luffa.c), on plain 32-bit words. */
+void MessageInjection(uint32_t (&V)[5][8], const unsigned char* buf)
+{
+    // Multiplication by 2 in the ring of the Luffa spec
+    const auto m2 = [](uint32_t (&d)[8], const uint32_t (&s)[8]) {
+        const uint32_t tmp = s[7];
+        d[7] = s[6];
+        d[6] = s[5];
+        d[5] = s[4];
+        d[4] = s[3] ^ tmp;
+        d[3] = s[2] ^ tmp;
+        d[2] = s[1];
+        d[1] = s[0] ^ tmp;
+        d[0] = tmp;
+    };
+    const auto xor_into = [](uint32_t (&d)[8], const uint32_t (&s)[8]) {
+        for (int i = 0; i < 8; ++i) d[i] ^= s[i];
+    };
+
+    uint32_t M[8], a[8], b[8];
+    for (int i = 0; i < 8; ++i) {
+        M[i] = (uint32_t{buf[4 * i]} << 24) | (uint32_t{buf[4 * i + 1]} << 16) | (uint32_t{buf[4 * i + 2]} << 8) | buf[4 * i + 3];
+        a[i] = V[0][i] ^ V[1][i] ^ V[2][i] ^ V[3][i] ^ V[4][i];
+    }
+    m2(a, a);
+    for (int j = 0; j < 5; ++j) xor_into(V[j], a);
+
+    m2(b, V[0]);
+    xor_into(b, V[1]);
+    m2(V[1], V[1]);
+    xor_into(V[1], V[2]);
+    m2(V[2], V[2]);
+    xor_into(V[2], V[3]);
+    m2(V[3], V[3]);
+    xor_into(V[3], V[4]);
+    m2(V[4], V[4]);
+    xor_into(V[4], V[0]);
+    m2(V[0], b);
+    xor_into(V[0], V[4]);
+    m2(V[4], V[4]);
+    xor_into(V[4], V[3]);
+    m2(V[3], V[3]);
+    xor_into(V[3], V[2]);
+    m2(V[2], V[2]);
+    xor_into(V[2], V[1]);
+    m2(V[1], V[1]);
+    xor_into(V[1], b);
+
+    for (int j = 0; j < 5; ++j) {
+        xor_into(V[j], M);
+        if (j < 4) m2(M, M);
+    }
+}
+
+} // namespace
+
+namespace sph_avx2 {
+
+void CubehashRounds(sph_u32* state, unsigned n)
+{
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)state + 0);
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)state + 1);
+    __m256i b0 = _mm256_loadu_si256((const __m256i*)state + 2);
+    __m256i b1 = _mm256_loadu_si256((const __m256i*)state + 3);
+    for (unsigned r = 0; r < 16 * n; ++r) {
+        b0 = _mm256_add_epi32(b0, a0);
+        b1 = _mm256_add_epi32(b1, a1);
+        // Rotate by 7 and swap x[0jklm] with x[1jklm]
+        __m256i t = Rotl<7>(a0);
+        a0 = _mm256_xor_si256(Rotl<7>(a1), b0);
+        a1 = _mm256_xor_si256(t, b1);
+        // Swap x[1jk0m] with x[1jk1m]
+        b0 = _mm256_shuffle_epi32(b0, 0x4E);
+        b1 = _mm256_shuffle_epi32(b1, 0x4E);
+        b0 = _mm256_add_epi32(b0, a0);
+        b1 = _mm256_add_epi32(b1, a1);
+        // Rotate by 11 and swap x[0j0lm] with x[0j1lm]
+        a0 = _mm256_xor_si256(_mm256_permute4x64_epi64(Rotl<11>(a0), 0x4E), b0);
+        a1 = _mm256_xor_si256(_mm256_permute4x64_epi64(Rotl<11>(a1), 0x4E), b1);
+        // Swap x[1jkl0] with x[1jkl1]
+        b0 = _mm256_shuffle_epi32(b0, 0xB1);
+        b1 = _mm256_shuffle_epi32(b1, 0xB1);
+    }
+    _mm256_storeu_si256((__m256i*)state + 0, a0);
+    _mm256_storeu_si256((__m256i*)state + 1, a1);
+    _mm256_storeu_si256((__m256i*)state + 2, b0);
+    _mm256_storeu_si256((__m256i*)state + 3, b1);
+}
+
+void Luffa512Step(sph_u32 V[5][8], const unsigned char* buf)
+{
+    uint32_t (&v)[5][8] = *reinterpret_cast<uint32_t (*)[5][8]>(V);
+    MessageInjection(v, buf);
+
+    // Word k of every sub-permutation j goes to lane j of x[k]
+    __m256i x[8];
+    for (int k = 0; k < 8; ++k) x[k] = _mm256_setr_epi32(v[0][k], v[1][k], v[2][k], v[3][k], v[4][k], 0, 0, 0);
+
+    // Tweak: the upper half of sub-permutation j starts rotated by j bits
+    const __m256i tweak_l = _mm256_setr_epi32(0, 1, 2, 3, 4, 0, 0, 0);
+    const __m256i tweak_r = _mm256_setr_epi32(32, 31, 30, 29, 28, 32, 32, 32);
+    for (int k = 4; k < 8; ++k) x[k] = _mm256_or_si256(_mm256_sllv_epi32(x[k], tweak_l), _mm256_srlv_epi32(x[k], tweak_r));
+
+    for (int r = 0; r < 8; ++r) {
+        SubCrumb(x[0], x[1], x[2], x[3]);
+        SubCrumb(x[5], x[6], x[7], x[4]);
+        MixWord(x[0], x[4]);
+        MixWord(x[1], x[5]);
+        MixWord(x[2], x[6]);
+        MixWord(x[3], x[7]);
+        x[0] = _mm256_xor_si256(x[0], _mm256_load_si256((const __m256i*)LUFFA_RC0[r]));
+        x[4] = _mm256_xor_si256(x[4], _mm256_load_si256((const __m256i*)LUFFA_RC4[r]));
+    }
+
+    alignas(32) uint32_t lanes[8];
+    for (int k = 0; k < 8; ++k) {
+        _mm256_store_si256((__m256i*)lanes, x[k]);
+        for (int j = 0; j < 5; ++j) v[j][k] = lanes[j];
+    }
+}
+
+} // namespace sph_avx2
+
+#endif
@@ -285,6 +285,22 @@ void sph_cubehash512_close(void *cc, void *dst);
  */
 void sph_cubehash512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
+/**
+ * Type for a replacement of the CubeHash round function: apply
+ * <code>16 * n</code> rounds to the 32-word state in place, exactly as the
+ * portable code does.
+ */
+typedef void (*sph_cubehash_rounds_fn)(sph_u32 *state, unsigned n);
+
+/**
+ * Select the CubeHash round function, e.g. one using AVX2. Passing NULL
+ * restores the portable code. Not thread-safe: call this before hashing
+ * starts.
+ *
+ * @param fn   the round function, or NULL
+ */
+void sph_cubehash_set_rounds(sph_cubehash_rounds_fn fn);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,134 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <config/bitcoin-config.h> // IWYU pragma: keep
+
+#include <crypto/flex/sph/sph_dispatch.h>
+
+#include <crypto/flex/sph/sph_cubehash.h>
+#include <crypto/flex/sph/sph_echo.h>
+#include <crypto/flex/sph/sph_luffa.h>
+#include <crypto/flex/sph/sph_shavite.h>
+
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include <compat/cpuid.h>
+
+namespace sph_x86_aesni
+{
+void EchoBigCompress(sph_echo_big_context* sc);
+void ShaviteBigCompress(sph_shavite_big_context* sc, const void* msg);
+}
+namespace sph_avx2
+{
+void CubehashRounds(sph_u32* state, unsigned n);
+void Luffa512Step(sph_u32 V[5][8], const unsigned char* buf);
+}
+
+namespace {
+void Echo512(const unsigned char* data, size_t len, unsigned char* out)
+{
+    sph_echo512_context ctx;
+    sph_echo512_init(&ctx);
+    sph_echo512(&ctx, data, len);
+    sph_echo512_close(&ctx, out);
+}
+
+void Shavite512(const unsigned char* data, size_t len, unsigned char* out)
+{
+    sph_shavite512_context ctx;
+    sph_shavite512_init(&ctx);
+    sph_shavite512(&ctx, data, len);
+    sph_shavite512_close(&ctx, out);
+}
+
+void Cubehash512(const unsigned char* data, size_t len, unsigned char* out)
+{
+    sph_cubehash512_context ctx;
+    sph_cubehash512_init(&ctx);
+    sph_cubehash512(&ctx, data, len);
+    sph_cubehash512_close(&ctx, out);
+}
+
+void Luffa512(const unsigned char* data, size_t len, unsigned char* out)
+{
+    sph_luffa512_context ctx;
+    sph_luffa512_init(&ctx);
+    sph_luffa512(&ctx, data, len);
+    sph_luffa512_close(&ctx, out);
+}
+
+/** Compare a primitive using the replacement fn against the portable code. */
+template <typename Fn>
+bool SelfTest(void (*hash)(const unsigned char*, size_t, unsigned char*), void (*select)(Fn), Fn fn)
+{
+    // Cover empty input, the 64-byte Flex chaining value, 80-byte headers and several blocks
+    static const size_t LENGTHS[] = {0, 1, 31, 32, 64, 80, 127, 128, 129, 300};
+
+    unsigned char input[300];
+    for (size_t i = 0; i < sizeof(input); ++i) input[i] = (unsigned char)(i * 0x9d + 1);
+
+    for (size_t len : LENGTHS) {
+        unsigned char expected[64], actual[64];
+        select(nullptr);
+        hash(input, len, expected);
+        select(fn);
+        hash(input, len, actual);
+        if (std::memcmp(expected, actual, sizeof(actual)) != 0) return false;
+    }
+    return true;
+}
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2)
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+std::string SPHAutoDetect(sph_implementation::UseImplementation use_implementation)
+{
+    std::string ret = "standard";
+    sph_echo_set_big_compress(nullptr);
+    sph_shavite_set_big_compress(nullptr);
+    sph_cubehash_set_rounds(nullptr);
+    sph_luffa512_set_step(nullptr);
+
+#if defined(HAVE_GETCPUID)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    [[maybe_unused]] const bool have_aesni = ((ecx >> 19) & 1) && ((ecx >> 25) & 1); // SSE4.1 and AES
+    [[maybe_unused]] const bool have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1); // OSXSAVE and AVX
+
+#if defined(ENABLE_X86_AESNI)
+    if ((use_implementation & sph_implementation::USE_AESNI) && have_aesni) {
+        assert(SelfTest(Echo512, sph_echo_set_big_compress, &sph_x86_aesni::EchoBigCompress));
+        assert(SelfTest(Shavite512, sph_shavite_set_big_compress, &sph_x86_aesni::ShaviteBigCompress));
+        sph_echo_set_big_compress(sph_x86_aesni::EchoBigCompress);
+        sph_shavite_set_big_compress(sph_x86_aesni::ShaviteBigCompress);
+        ret = "x86_aesni(echo,shavite)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2)
+    if ((use_implementation & sph_implementation::USE_AVX2) && have_avx) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+        if (((ebx >> 5) & 1) && AVXEnabled()) {
+            assert(SelfTest(Cubehash512, sph_cubehash_set_rounds, &sph_avx2::CubehashRounds));
+            assert(SelfTest(Luffa512, sph_luffa512_set_step, &sph_avx2::Luffa512Step));
+            sph_cubehash_set_rounds(sph_avx2::CubehashRounds);
+            sph_luffa512_set_step(sph_avx2::Luffa512Step);
+            ret = ret == "standard" ? "avx2(cubehash,luffa)" : ret + ",avx2(cubehash,luffa)";
+        }
+    }
+#endif
+#endif // defined(HAVE_GETCPUID)
+
+    return ret;
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_FLEX_SPH_SPH_DISPATCH_H
+#define BITCOIN_CRYPTO_FLEX_SPH_SPH_DISPATCH_H
+
+#include <cstdint>
+#include <string>
+
+namespace sph_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_AESNI = 1 << 0,
+    USE_AVX2 = 1 << 1,
+    USE_ALL = USE_AESNI | USE_AVX2,
+};
+}
+
+/** Autodetect the best available implementations of the sph primitives used
+ *  by Flex (ECHO and SHAvite with AES-NI, CubeHash and Luffa with AVX2).
+ *  Returns the names of the accelerated implementations.
+ */
+std::string SPHAutoDetect(sph_implementation::UseImplementation use_implementation = sph_implementation::USE_ALL);
+
+#endif // BITCOIN_CRYPTO_FLEX_SPH_SPH_DISPATCH_H
@@ -313,6 +313,23 @@ void sph_echo512_close(void *cc, void *dst);
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 	
+/**
+ * Type for a replacement of the ECHO-384/512 compression function. It
+ * processes the 128-byte block in <code>sc->buf</code> with the counter
+ * in <code>sc->C0..C3</code> and updates the chaining value in
+ * <code>sc->u</code>, exactly as the portable code does.
+ */
+typedef void (*sph_echo_big_compress_fn)(sph_echo_big_context *sc);
+
+/**
+ * Select the ECHO-384/512 compression function, e.g. one using AES-NI.
+ * Passing NULL restores the portable code. Not thread-safe: call this
+ * before hashing starts.
+ *
+ * @param fn   the compression function, or NULL
+ */
+void sph_echo_set_big_compress(sph_echo_big_compress_fn fn);
+
 #ifdef __cplusplus
 }
 #endif
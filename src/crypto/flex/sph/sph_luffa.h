@@ -289,6 +289,22 @@ void sph_luffa512_close(void *cc, void *dst);
 void sph_luffa512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 	
+/**
+ * Type for a replacement of one Luffa-512 step: inject the 32-byte block
+ * <code>buf</code> into the chaining values <code>V</code> and apply the
+ * permutation, exactly as the portable code does.
+ */
+typedef void (*sph_luffa512_step_fn)(sph_u32 V[5][8], const unsigned char *buf);
+
+/**
+ * Select the Luffa-512 step function, e.g. one using AVX2. Passing NULL
+ * restores the portable code. Not thread-safe: call this before hashing
+ * starts.
+ *
+ * @param fn   the step function, or NULL
+ */
+void sph_luffa512_set_step(sph_luffa512_step_fn fn);
+
 #ifdef __cplusplus
 }
 #endif
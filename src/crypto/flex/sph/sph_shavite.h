@@ -307,6 +307,23 @@ void sph_shavite512_close(void *cc, void *dst);
 void sph_shavite512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 	
+/**
+ * Type for a replacement of the SHAvite-384/512 compression function. It
+ * compresses the 128-byte block <code>msg</code> into <code>sc->h</code>
+ * using the bit counter in <code>sc->count0..count3</code>, exactly as the
+ * portable code does.
+ */
+typedef void (*sph_shavite_big_compress_fn)(sph_shavite_big_context *sc, const void *msg);
+
+/**
+ * Select the SHAvite-384/512 compression function, e.g. one using AES-NI.
+ * Passing NULL restores the portable code. Not thread-safe: call this
+ * before hashing starts.
+ *
+ * @param fn   the compression function, or NULL
+ */
+void sph_shavite_set_big_compress(sph_shavite_big_compress_fn fn);
+
 #ifdef __cplusplus
 }
 #endif	
@@ -0,0 +1,160 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-NI versions of the ECHO-512 and SHAvite-512 compression functions used
+// by Flex. Both are built from plain AES rounds, so each 16-byte word maps onto
+// one AESENC; the portable code in echo.c and shavite.c is the reference.
+
+#if defined(ENABLE_X86_AESNI)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <utility>
+
+#include <attributes.h>
+#include <crypto/flex/sph/sph_echo.h>
+#include <crypto/flex/sph/sph_shavite.h>
+
+namespace {
+
+/** Multiply every byte by x in GF(2^8), as the AES MixColumns step does. */
+__m128i ALWAYS_INLINE XTime(__m128i x)
+{
+    const __m128i carry = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(carry, _mm_set1_epi8(0x1b)));
+}
+
+void ALWAYS_INLINE EchoMixColumn(__m128i (&W)[16], int ia, int ib, int ic, int id)
+{
+    const __m128i a = W[ia], b = W[ib], c = W[ic], d = W[id];
+    const __m128i ab = _mm_xor_si128(a, b);
+    const __m128i bc = _mm_xor_si128(b, c);
+    const __m128i cd = _mm_xor_si128(c, d);
+    const __m128i abx = XTime(ab);
+    const __m128i bcx = XTime(bc);
+    const __m128i cdx = XTime(cd);
+    W[ia] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+    W[ib] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+    W[ic] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+    W[id] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(_mm_xor_si128(cdx, ab), c));
+}
+
+/** Rotate the words a <- b <- c <- d <- a (SHIFT_ROW1 in echo.c). */
+void ALWAYS_INLINE EchoShiftRow(__m128i (&W)[16], int a, int b, int c, int d)
+{
+    const __m128i t = W[a];
+    W[a] = W[b];
+    W[b] = W[c];
+    W[c] = W[d];
+    W[d] = t;
+}
+
+} // namespace
+
+namespace sph_x86_aesni {
+
+void EchoBigCompress(sph_echo_big_context* sc)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i W[16];
+    for (int i = 0; i < 8; ++i) {
+        W[i] = _mm_loadu_si128((const __m128i*)sc->u.Vb[i]);
+        W[i + 8] = _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i));
+    }
+
+    uint32_t k0 = sc->C0, k1 = sc->C1, k2 = sc->C2, k3 = sc->C3;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 16; ++i) {
+            const __m128i key = _mm_set_epi32((int)k3, (int)k2, (int)k1, (int)k0);
+            W[i] = _mm_aesenc_si128(_mm_aesenc_si128(W[i], key), zero);
+            if (++k0 == 0 && ++k1 == 0 && ++k2 == 0) ++k3;
+        }
+        EchoShiftRow(W, 1, 5, 9, 13);
+        std::swap(W[2], W[10]);
+        std::swap(W[6], W[14]);
+        EchoShiftRow(W, 15, 11, 7, 3);
+        EchoMixColumn(W, 0, 1, 2, 3);
+        EchoMixColumn(W, 4, 5, 6, 7);
+        EchoMixColumn(W, 8, 9, 10, 11);
+        EchoMixColumn(W, 12, 13, 14, 15);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)sc->u.Vb[i]);
+        const __m128i m = _mm_loadu_si128((const __m128i*)(sc->buf + 16 * i));
+        _mm_storeu_si128((__m128i*)sc->u.Vb[i], _mm_xor_si128(_mm_xor_si128(v, m), _mm_xor_si128(W[i], W[i + 8])));
+    }
+}
+
+void ShaviteBigCompress(sph_shavite_big_context* sc, const void* msg)
+{
+    const __m128i zero = _mm_setzero_si128();
+    // 448 words of round keys, four per AES round key
+    __m128i rk[112];
+    for (int i = 0; i < 8; ++i) rk[i] = _mm_loadu_si128((const __m128i*)msg + i);
+
+    const __m128i count = _mm_set_epi32((int)sc->count3, (int)sc->count2, (int)sc->count1, (int)sc->count0);
+    const __m128i invert = _mm_set_epi32(-1, 0, 0, 0);
+    size_t u = 8;
+    for (;;) {
+        for (int s = 0; s < 8; ++s) {
+            const __m128i x = _mm_aesenc_si128(_mm_shuffle_epi32(rk[u - 8], 0x39), zero);
+            rk[u] = _mm_xor_si128(x, rk[u - 1]);
+            // Block counter, mixed into four of the keys in a different word order each time
+            if (u == 8) {
+                rk[u] = _mm_xor_si128(rk[u], _mm_xor_si128(count, invert));
+            } else if (u == 41) {
+                rk[u] = _mm_xor_si128(rk[u], _mm_xor_si128(_mm_shuffle_epi32(count, 0x1B), invert));
+            } else if (u == 79) {
+                rk[u] = _mm_xor_si128(rk[u], _mm_xor_si128(_mm_shuffle_epi32(count, 0x4E), invert));
+            } else if (u == 110) {
+                rk[u] = _mm_xor_si128(rk[u], _mm_xor_si128(_mm_shuffle_epi32(count, 0xB1), invert));
+            }
+            ++u;
+        }
+        if (u == 112) break;
+        for (int s = 0; s < 8; ++s) {
+            rk[u] = _mm_xor_si128(rk[u - 8], _mm_alignr_epi8(rk[u - 1], rk[u - 2], 4));
+            ++u;
+        }
+    }
+
+    __m128i p0 = _mm_loadu_si128((const __m128i*)sc->h + 0);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)sc->h + 1);
+    __m128i p2 = _mm_loadu_si128((const __m128i*)sc->h + 2);
+    __m128i p3 = _mm_loadu_si128((const __m128i*)sc->h + 3);
+    u = 0;
+    for (int r = 0; r < 14; ++r) {
+        __m128i x = _mm_xor_si128(p1, rk[u]);
+        x = _mm_aesenc_si128(x, rk[u + 1]);
+        x = _mm_aesenc_si128(x, rk[u + 2]);
+        x = _mm_aesenc_si128(x, rk[u + 3]);
+        p0 = _mm_xor_si128(p0, _mm_aesenc_si128(x, zero));
+        x = _mm_xor_si128(p3, rk[u + 4]);
+        x = _mm_aesenc_si128(x, rk[u + 5]);
+        x = _mm_aesenc_si128(x, rk[u + 6]);
+        x = _mm_aesenc_si128(x, rk[u + 7]);
+        p2 = _mm_xor_si128(p2, _mm_aesenc_si128(x, zero));
+        u += 8;
+
+        const __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+
+    __m128i* h = (__m128i*)sc->h;
+    _mm_storeu_si128(h + 0, _mm_xor_si128(_mm_loadu_si128(h + 0), p0));
+    _mm_storeu_si128(h + 1, _mm_xor_si128(_mm_loadu_si128(h + 1), p1));
+    _mm_storeu_si128(h + 2, _mm_xor_si128(_mm_loadu_si128(h + 2), p2));
+    _mm_storeu_si128(h + 3, _mm_xor_si128(_mm_loadu_si128(h + 3), p3));
+}
+
+} // namespace sph_x86_aesni
+
+#endif
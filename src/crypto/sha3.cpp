@@ -5,16 +5,32 @@
 // Based on https://github.com/mjosaarinen/tiny_sha3/blob/master/sha3.c
 // by Markku-Juhani O. Saarinen <mjos@iki.fi>
 
+#include <config/bitcoin-config.h> // IWYU pragma: keep
+
 #include <crypto/sha3.h>
 #include <crypto/common.h>
+#include <compat/cpuid.h>
 #include <span.h>
 
 #include <algorithm>
 #include <array> // For std::begin and std::end.
 #include <bit>
+#include <cassert>
+#include <cstring>
+#include <vector>
 
 #include <stdint.h>
 
+namespace sha3_avx2
+{
+void KeccakF_4way(uint64_t* state);
+}
+
+namespace sha3_avx512
+{
+void KeccakF_8way(uint64_t* state);
+}
+
 void KeccakF(uint64_t (&st)[25])
 {
     static constexpr uint64_t RNDC[24] = {
@@ -154,3 +170,233 @@ SHA3_256& SHA3_256::Reset()
     std::fill(std::begin(m_state), std::end(m_state), 0);
     return *this;
 }
+
+namespace {
+/** SHA3-256 of the 32-byte digest in st[0..3], left in st[0..3]. */
+void SHA3_256_32(uint64_t (&st)[25])
+{
+    // The whole message fits in the first block, so the padding is fixed.
+    const uint64_t digest[4] = {st[0], st[1], st[2], st[3]};
+    std::fill(std::begin(st), std::end(st), 0);
+    std::copy(std::begin(digest), std::end(digest), st);
+    st[4] = 0x06;
+    st[16] = 0x8000000000000000;
+    KeccakF(st);
+}
+
+/** A Keccak-f[1600] permutation of several states, interleaved word by word. */
+typedef void (*KeccakFManyFn)(uint64_t* state);
+
+KeccakFManyFn KeccakF_4way = nullptr;
+KeccakFManyFn KeccakF_8way = nullptr;
+
+void KeccakF_1way(uint64_t* state)
+{
+    KeccakF(*reinterpret_cast<uint64_t(*)[25]>(state));
+}
+
+/**
+ * Absorb `count` inputs (count <= lanes) into an interleaved state and squeeze
+ * out_len bytes from each. Unused lanes repeat the last input and are discarded.
+ */
+void Sponge(KeccakFManyFn permute, size_t lanes, unsigned char* output, size_t out_len, const unsigned char* input, size_t len, size_t count, size_t rate, unsigned char pad)
+{
+    uint64_t st[25 * 8] = {0};
+    size_t pos = 0;
+    for (; len - pos >= rate; pos += rate) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const unsigned char* in = input + std::min(lane, count - 1) * len + pos;
+            for (size_t w = 0; w < rate / 8; ++w) st[w * lanes + lane] ^= ReadLE64(in + 8 * w);
+        }
+        permute(st);
+    }
+    unsigned char block[200];
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        std::memset(block, 0, rate);
+        std::memcpy(block, input + std::min(lane, count - 1) * len + pos, len - pos);
+        block[len - pos] ^= pad;
+        block[rate - 1] ^= 0x80;
+        for (size_t w = 0; w < rate / 8; ++w) st[w * lanes + lane] ^= ReadLE64(block + 8 * w);
+    }
+    permute(st);
+    for (size_t lane = 0; lane < count; ++lane) {
+        for (size_t w = 0; w < out_len / 8; ++w) WriteLE64(output + lane * out_len + 8 * w, st[w * lanes + lane]);
+    }
+}
+
+/**
+ * Absorb inputs of any length into an interleaved state. As soon as a lane has
+ * absorbed the last block of its input, out_len bytes are squeezed out and the
+ * lane restarts with the next input, so lanes stay busy whatever the lengths.
+ */
+void SpongeMany(KeccakFManyFn permute, size_t lanes, unsigned char* output, size_t out_len, const Span<const unsigned char>* inputs, size_t count, size_t rate, unsigned char pad)
+{
+    uint64_t st[25 * 8] = {0};
+    // Input absorbed by each lane (count when idle) and how far it got
+    size_t input[8], pos[8];
+    bool last[8];
+    size_t next = 0, busy = 0;
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        input[lane] = next < count ? next++ : count;
+        pos[lane] = 0;
+        busy += input[lane] < count;
+    }
+    unsigned char block[200];
+    while (busy > 0) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (input[lane] == count) continue;
+            const Span<const unsigned char> in = inputs[input[lane]];
+            const unsigned char* data = block;
+            last[lane] = in.size() - pos[lane] < rate;
+            if (!last[lane]) {
+                data = in.data() + pos[lane];
+                pos[lane] += rate;
+            } else {
+                std::memset(block, 0, rate);
+                if (in.size() > pos[lane]) std::memcpy(block, in.data() + pos[lane], in.size() - pos[lane]);
+                block[in.size() - pos[lane]] ^= pad;
+                block[rate - 1] ^= 0x80;
+            }
+            for (size_t w = 0; w < rate / 8; ++w) st[w * lanes + lane] ^= ReadLE64(data + 8 * w);
+        }
+        permute(st);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (input[lane] == count || !last[lane]) continue;
+            for (size_t w = 0; w < out_len / 8; ++w) WriteLE64(output + input[lane] * out_len + 8 * w, st[w * lanes + lane]);
+            for (size_t w = 0; w < 25; ++w) st[w * lanes + lane] = 0;
+            pos[lane] = 0;
+            if (next < count) {
+                input[lane] = next++;
+            } else {
+                input[lane] = count;
+                --busy;
+            }
+        }
+    }
+}
+
+/** Split `count` inputs over the widest kernels available. */
+template <typename F>
+void ForEachGroup(size_t count, F fn)
+{
+    size_t done = 0;
+    while (done < count) {
+        const size_t left = count - done;
+        if (KeccakF_8way && left > 4) {
+            fn(KeccakF_8way, 8, done, std::min<size_t>(left, 8));
+            done += std::min<size_t>(left, 8);
+        } else if (KeccakF_4way && left > 1) {
+            fn(KeccakF_4way, 4, done, std::min<size_t>(left, 4));
+            done += std::min<size_t>(left, 4);
+        } else {
+            fn(KeccakF_1way, 1, done, 1);
+            done += 1;
+        }
+    }
+}
+
+/** Compare the multi-lane kernels against one lane at a time. */
+bool SelfTest()
+{
+    unsigned char input[9 * 80];
+    for (size_t i = 0; i < sizeof(input); ++i) input[i] = (unsigned char)(i * 0x9d + 1);
+
+    unsigned char expected[9 * 32], actual[9 * 32];
+    for (size_t i = 0; i < 9; ++i) {
+        Sponge(KeccakF_1way, 1, expected + 32 * i, 32, input + 80 * i, 80, 1, 136, 0x06);
+    }
+    KeccakMany(actual, 32, input, 80, 9, 136, 0x06);
+    return std::memcmp(expected, actual, sizeof(actual)) == 0;
+}
+
+#if defined(HAVE_GETCPUID)
+/** Whether the OS saves the register state selected by mask on context switches. */
+[[maybe_unused]] bool XSaveEnabled(uint32_t mask)
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & mask) == mask;
+}
+#endif
+} // namespace
+
+void SHA3_256d_80(unsigned char output[32], const unsigned char input[80])
+{
+    uint64_t st[25] = {0};
+    for (int i = 0; i < 10; ++i) st[i] = ReadLE64(input + 8 * i);
+    st[10] = 0x06;
+    st[16] = 0x8000000000000000;
+    KeccakF(st);
+    SHA3_256_32(st);
+    for (int i = 0; i < 4; ++i) WriteLE64(output + 8 * i, st[i]);
+}
+
+void SHA3_256d_32(unsigned char output[32], const unsigned char input[32])
+{
+    uint64_t st[25];
+    for (int i = 0; i < 4; ++i) st[i] = ReadLE64(input + 8 * i);
+    SHA3_256_32(st);
+    SHA3_256_32(st);
+    for (int i = 0; i < 4; ++i) WriteLE64(output + 8 * i, st[i]);
+}
+
+void KeccakMany(unsigned char* output, size_t out_len, const unsigned char* input, size_t len, size_t count, size_t rate, unsigned char pad)
+{
+    assert(rate % 8 == 0 && rate <= 200 - 8 && out_len % 8 == 0 && out_len <= rate);
+    ForEachGroup(count, [&](KeccakFManyFn permute, size_t lanes, size_t first, size_t n) {
+        Sponge(permute, lanes, output + first * out_len, out_len, input + first * len, len, n, rate, pad);
+    });
+}
+
+void SHA3_256d_Many(unsigned char* output, const unsigned char* input, size_t len, size_t count)
+{
+    ForEachGroup(count, [&](KeccakFManyFn permute, size_t lanes, size_t first, size_t n) {
+        unsigned char inner[8 * SHA3_256::OUTPUT_SIZE];
+        Sponge(permute, lanes, inner, SHA3_256::OUTPUT_SIZE, input + first * len, len, n, 136, 0x06);
+        Sponge(permute, lanes, output + first * SHA3_256::OUTPUT_SIZE, SHA3_256::OUTPUT_SIZE, inner, SHA3_256::OUTPUT_SIZE, n, 136, 0x06);
+    });
+}
+
+void SHA3_256d_Many(unsigned char* output, const Span<const unsigned char>* inputs, size_t count)
+{
+    std::vector<unsigned char> inner(count * SHA3_256::OUTPUT_SIZE);
+    if (KeccakF_8way && count > 4) {
+        SpongeMany(KeccakF_8way, 8, inner.data(), SHA3_256::OUTPUT_SIZE, inputs, count, 136, 0x06);
+    } else if (KeccakF_4way && count > 1) {
+        SpongeMany(KeccakF_4way, 4, inner.data(), SHA3_256::OUTPUT_SIZE, inputs, count, 136, 0x06);
+    } else {
+        SpongeMany(KeccakF_1way, 1, inner.data(), SHA3_256::OUTPUT_SIZE, inputs, count, 136, 0x06);
+    }
+    KeccakMany(output, SHA3_256::OUTPUT_SIZE, inner.data(), SHA3_256::OUTPUT_SIZE, count, 136, 0x06);
+}
+
+std::string SHA3AutoDetect(sha3_implementation::UseImplementation use_implementation)
+{
+    std::string ret = "standard";
+    KeccakF_4way = nullptr;
+    KeccakF_8way = nullptr;
+
+#if defined(HAVE_GETCPUID)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = ((ecx >> 27) & 1) && ((ecx >> 28) & 1); // OSXSAVE and AVX
+    if (have_xsave) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+#if defined(ENABLE_AVX2)
+        if ((use_implementation & sha3_implementation::USE_AVX2) && ((ebx >> 5) & 1) && XSaveEnabled(0x6)) {
+            KeccakF_4way = sha3_avx2::KeccakF_4way;
+            ret = "avx2(4way)";
+        }
+#endif
+#if defined(ENABLE_AVX512)
+        if ((use_implementation & sha3_implementation::USE_AVX512) && ((ebx >> 16) & 1) && XSaveEnabled(0xe6)) {
+            KeccakF_8way = sha3_avx512::KeccakF_8way;
+            ret = ret == "standard" ? "avx512(8way)" : ret + ",avx512(8way)";
+        }
+#endif
+    }
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
@@ -9,6 +9,7 @@
 
 #include <cstdlib>
 #include <stdint.h>
+#include <string>
 
 //! The Keccak-f[1600] transform.
 void KeccakF(uint64_t (&st)[25]);
@@ -38,4 +39,46 @@ public:
     SHA3_256& Reset();
 };
 
+/** Compute SHA3-256(SHA3-256(input)) of an 80-byte block header in one shot,
+ *  as Hash3Writer does, without any buffering. */
+void SHA3_256d_80(unsigned char output[32], const unsigned char input[80]);
+
+/** Compute SHA3-256(SHA3-256(input)) of a 32-byte input in one shot. */
+void SHA3_256d_32(unsigned char output[32], const unsigned char input[32]);
+
+namespace sha3_implementation {
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_AVX2 = 1 << 0,
+    USE_AVX512 = 1 << 1,
+    USE_ALL = USE_AVX2 | USE_AVX512,
+};
+}
+
+/** Autodetect the best available multi-lane Keccak implementation.
+ *  Returns the name of the implementation.
+ */
+std::string SHA3AutoDetect(sha3_implementation::UseImplementation use_implementation = sha3_implementation::USE_ALL);
+
+/** Run the Keccak sponge over several equally sized inputs at once.
+ *  output:  pointer to a count*out_len byte output buffer
+ *  input:   pointer to a count*len byte input buffer
+ *  rate:    sponge rate in bytes (136 for 256-bit output, 72 for 512-bit output)
+ *  pad:     domain separation byte (0x06 for SHA-3, 0x01 for the original Keccak)
+ */
+void KeccakMany(unsigned char* output, size_t out_len, const unsigned char* input, size_t len, size_t count, size_t rate, unsigned char pad);
+
+/** Compute multiple double-SHA3-256's (as Hash3Writer does) of len-byte blobs.
+ *  output:  pointer to a count*32 byte output buffer
+ *  input:   pointer to a count*len byte input buffer
+ *  count:   the number of hashes to compute.
+ */
+void SHA3_256d_Many(unsigned char* output, const unsigned char* input, size_t len, size_t count);
+
+/** Compute multiple double-SHA3-256's (as Hash3Writer does) of inputs of any length.
+ *  output:  pointer to a count*32 byte output buffer
+ *  inputs:  pointer to count input spans
+ */
+void SHA3_256d_Many(unsigned char* output, const Span<const unsigned char>* inputs, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA3_H
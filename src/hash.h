@@ -184,33 +184,26 @@ public:
     }
 };
 
-/** A writer stream (for serialization) that computes a 256-bit hash. */
+/** A writer stream (for serialization) that computes the Flex proof-of-work hash. */
 class Hash4Writer
 {
 private:
-    std::vector<char> buffer;  // Dynamic buffer for accumulating data
+    //! Flex hashes the whole input at once; a block header fits without allocating.
+    prevector<80, unsigned char> buffer;
 
 public:
-    // Constructor
-    Hash4Writer() {
-        buffer.reserve(80);  // Optionally reserve some initial capacity to minimize reallocations
-    }
-
-    // Write method to add data to the buffer
-    void write(Span<const std::byte> src) {
-        size_t oldSize = buffer.size();
-        buffer.resize(oldSize + src.size());  // Resize the buffer to accommodate new data
-        std::memcpy(&buffer[oldSize], src.data(), src.size());  // Append the new data
+    void write(Span<const std::byte> src)
+    {
+        buffer.insert(buffer.end(), UCharCast(src.data()), UCharCast(src.data() + src.size()));
     }
 
-    // Compute the double-SHA256 hash of all data written to this object.
+    /** Compute the Flex hash of all data written to this object. */
     uint256 GetHash() {
         uint256 result;
-        flex_hash(buffer.data(), buffer.size(), result.begin());  // Compute the hash on the dynamic buffer
+        flex_hash(reinterpret_cast<const char*>(buffer.data()), buffer.size(), result.begin());
         return result;
     }
 
-    // Operator overloading to support serialization
     template <typename T>
     Hash4Writer& operator<<(const T& obj) {
         ::Serialize(*this, obj);
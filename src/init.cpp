@@ -33,6 +33,7 @@
 #include <interfaces/node.h>
 #include <kernel/context.h>
 #include <key.h>
+#include <key_io.h>
 #include <logging.h>
 #include <mapport.h>
 #include <net.h>
@@ -53,11 +54,13 @@
 #include <node/mempool_persist_args.h>
 #include <node/miner.h>
 #include <node/peerman_args.h>
+#include <node/stratum.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/fees_args.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <pow_cache.h>
 #include <protocol.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
@@ -132,6 +135,8 @@ using node::LoadChainstate;
 using node::MempoolPath;
 using node::NodeContext;
 using node::ShouldPersistMempool;
+using node::StratumOptions;
+using node::StratumServer;
 using node::ImportBlocks;
 using node::VerifyLoadedChainstate;
 using util::Join;
@@ -258,6 +263,7 @@ void Interrupt(NodeContext& node)
     InterruptREST();
     InterruptTorControl();
     InterruptMapPort();
+    if (node.stratum) node.stratum->Interrupt();
     if (node.connman)
         node.connman->Interrupt();
     for (auto* index : node.indexes) {
@@ -284,6 +290,8 @@ void Shutdown(NodeContext& node)
     StopREST();
     StopRPC();
     StopHTTPServer();
+    if (node.stratum) node.stratum->Stop();
+    node.stratum.reset();
     for (const auto& client : node.chain_clients) {
         client->flush();
     }
@@ -358,6 +366,7 @@ void Shutdown(NodeContext& node)
                 chainstate->ResetCoinsViews();
             }
         }
+        PowCache::Instance().Flush();
     }
     for (const auto& client : node.chain_clients) {
         client->stop();
@@ -478,7 +487,14 @@ void SetupServerArgs(ArgsManager& argsman)
                              "(default: %u)",
                              kernel::DEFAULT_XOR_BLOCKSDIR),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-compressblocks", strprintf("Store new blocks and undo data compressed, with dictionaries trained on recently stored blocks. "
+                                                "Blocks are read back either way, but versions without support for compressed block files cannot read them. "
+                                                "Existing block files can be converted with kylacoin-util convertblocks. (default: %u)",
+                                                kernel::DEFAULT_COMPRESS_BLOCKS),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune", "Use smaller block files and lower minimum prune height for testing purposes", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-mappedblockfiles=<n>", strprintf("Keep up to <n> block files memory-mapped to read and serve blocks from, instead of reading them with file I/O (0 to disable, default: %u)", kernel::DEFAULT_MAX_MAPPED_BLOCK_FILES), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-paranoidblockreads", strprintf("Recompute the proof of work of every block read from disk, instead of trusting blocks whose header is already in the block index (default: %u)", kernel::DEFAULT_PARANOID_BLOCK_READS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 #if HAVE_SYSTEM
     argsman.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
@@ -505,6 +521,7 @@ void SetupServerArgs(ArgsManager& argsman)
                              DEFAULT_PERSIST_V1_DAT),
                    ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-powcachesize=<n>", strprintf("Memory for the Flex proof-of-work hash cache in MiB, persisted to %s in the data directory (default: %d)", POW_CACHE_FILENAME, DEFAULT_POW_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -659,6 +676,10 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-blockmaxweight=<n>", strprintf("Set maximum BIP141 block weight (default: %d)", DEFAULT_BLOCK_MAX_WEIGHT), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     argsman.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kvB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     argsman.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratum", strprintf("Serve mining jobs to local miners over the Stratum protocol (default: %u)", node::DEFAULT_STRATUM_ENABLE), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratumaddress=<address>", "Address paid by the coinbase of Stratum jobs. Required with -stratum", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratumbind=<addr>[:port]", "Bind to given address to listen for Stratum connections. Port is optional and overrides -stratumport. Do not expose the Stratum server to untrusted networks (default: 127.0.0.1)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratumport=<port>", strprintf("Listen for Stratum connections on <port> (default: %u)", node::DEFAULT_STRATUM_PORT), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
 
     argsman.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     argsman.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid values for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0), a network/CIDR (e.g. 1.2.3.4/24), all ipv4 (0.0.0.0/0), or all ipv6 (::/0). This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
@@ -1305,6 +1326,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     for (const std::string port_option : {
         "-port",
         "-rpcport",
+        "-stratumport",
     }) {
         if (args.IsArgSet(port_option)) {
             const std::string port = args.GetArg(port_option, "");
@@ -1321,6 +1343,7 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         {"-onion",                  true},
         {"-proxy",                  true},
         {"-rpcbind",                false},
+        {"-stratumbind",            false},
         {"-torcontrol",             false},
         {"-whitebind",              false},
         {"-zmqpubhashblock",        true},
@@ -1834,6 +1857,23 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     // Map ports with UPnP or NAT-PMP.
     StartMapPort(args.GetBoolArg("-upnp", DEFAULT_UPNP), args.GetBoolArg("-natpmp", DEFAULT_NATPMP));
 
+    if (args.GetBoolArg("-stratum", node::DEFAULT_STRATUM_ENABLE)) {
+        StratumOptions stratum_options;
+        const CTxDestination dest{DecodeDestination(args.GetArg("-stratumaddress", ""))};
+        if (!IsValidDestination(dest)) {
+            return InitError(_("-stratum requires a valid -stratumaddress"));
+        }
+        stratum_options.coinbase_script = GetScriptForDestination(dest);
+        const uint16_t stratum_port{static_cast<uint16_t>(args.GetIntArg("-stratumport", node::DEFAULT_STRATUM_PORT))};
+        const std::string stratum_bind{args.GetArg("-stratumbind", "127.0.0.1")};
+        const std::optional<CService> bind_addr{Lookup(stratum_bind, stratum_port, /*fAllowLookup=*/false)};
+        if (!bind_addr) return InitError(ResolveErrMsg("stratumbind", stratum_bind));
+        stratum_options.bind = *bind_addr;
+        node.stratum = std::make_unique<StratumServer>(*node.mining, std::move(stratum_options));
+        bilingual_str error;
+        if (!node.stratum->Start(error)) return InitError(error);
+    }
+
     CConnman::Options connOptions;
     connOptions.nLocalServices = nLocalServices;
     connOptions.m_max_automatic_connections = nMaxConnections;
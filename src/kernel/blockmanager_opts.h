@@ -8,6 +8,7 @@
 #include <kernel/notifications_interface.h>
 #include <util/fs.h>
 
+#include <cstddef>
 #include <cstdint>
 
 class CChainParams;
@@ -15,6 +16,12 @@ class CChainParams;
 namespace kernel {
 
 static constexpr bool DEFAULT_XOR_BLOCKSDIR{true};
+//! Recompute the proof of work of blocks read back for a known block index entry.
+static constexpr bool DEFAULT_PARANOID_BLOCK_READS{false};
+//! Number of block files to keep memory-mapped for reading blocks, 0 to read them with file I/O.
+static constexpr size_t DEFAULT_MAX_MAPPED_BLOCK_FILES{0};
+//! Store new blocks and undo data compressed.
+static constexpr bool DEFAULT_COMPRESS_BLOCKS{false};
 
 /**
  * An options struct for `BlockManager`, more ergonomically referred to as
@@ -25,6 +32,9 @@ struct BlockManagerOpts {
     bool use_xor{DEFAULT_XOR_BLOCKSDIR};
     uint64_t prune_target{0};
     bool fast_prune{false};
+    bool paranoid_block_reads{DEFAULT_PARANOID_BLOCK_READS};
+    size_t max_mapped_block_files{DEFAULT_MAX_MAPPED_BLOCK_FILES};
+    bool compress_blocks{DEFAULT_COMPRESS_BLOCKS};
     const fs::path blocks_dir;
     Notifications& notifications;
 };
@@ -4,7 +4,10 @@
 
 #include <kernel/context.h>
 
+#include <crypto/flex/cnfiles/cnfn.h>
+#include <crypto/flex/sph/sph_dispatch.h>
 #include <crypto/sha256.h>
+#include <crypto/sha3.h>
 #include <logging.h>
 #include <random.h>
 
@@ -18,6 +21,12 @@ Context::Context()
     std::call_once(globals_initialized, []() {
         std::string sha256_algo = SHA256AutoDetect();
         LogInfo("Using the '%s' SHA256 implementation\n", sha256_algo);
+        std::string sha3_algo = SHA3AutoDetect();
+        LogInfo("Using the '%s' SHA3 implementation\n", sha3_algo);
+        std::string cnfn_algo = CNFNAutoDetect();
+        LogInfo("Using the '%s' CryptoNight implementation\n", cnfn_algo);
+        std::string sph_algo = SPHAutoDetect();
+        LogInfo("Using the '%s' sph implementation\n", sph_algo);
         RandomInit();
     });
 }
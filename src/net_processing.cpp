@@ -22,6 +22,7 @@
 #include <merkleblock.h>
 #include <netbase.h>
 #include <netmessagemaker.h>
+#include <node/blockmessagecache.h>
 #include <node/blockstorage.h>
 #include <node/timeoffsets.h>
 #include <node/txreconciliation.h>
@@ -120,6 +121,10 @@ static const int MAX_CMPCTBLOCK_DEPTH = 5;
 /** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
 static const int MAX_BLOCKTXN_DEPTH = 10;
 static_assert(MAX_BLOCKTXN_DEPTH <= MIN_BLOCKS_TO_KEEP, "MAX_BLOCKTXN_DEPTH too high");
+/** Maximum depth of blocks whose serialized messages are cached for other peers requesting them. */
+static const int MAX_BLOCK_MESSAGE_CACHE_DEPTH = MAX_BLOCKTXN_DEPTH;
+/** Memory usage limit of the serialized messages cached for recent blocks. */
+static constexpr size_t MAX_BLOCK_MESSAGE_CACHE_BYTES{32 << 20};
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
@@ -658,8 +663,9 @@ private:
                                bool via_compact_block)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_headers_presync_mutex, g_msgproc_mutex);
     /** Various helpers for headers processing, invoked by ProcessHeadersMessage() */
-    /** Return true if headers are continuous and have valid proof-of-work (DoS points assigned on failure) */
-    bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer);
+    /** Return true if headers are continuous and have valid proof-of-work (DoS points assigned on failure).
+     *  pow_hashes receives the proof-of-work hash of each header. */
+    bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer, std::vector<uint256>& pow_hashes);
     /** Calculate an anti-DoS work threshold for headers chains */
     arith_uint256 GetAntiDoSWorkThreshold();
     /** Deal with state tracking and headers sync for peers that send
@@ -990,6 +996,9 @@ private:
     uint256 m_most_recent_block_hash GUARDED_BY(m_most_recent_block_mutex);
     std::unique_ptr<const std::map<uint256, CTransactionRef>> m_most_recent_block_txs GUARDED_BY(m_most_recent_block_mutex);
 
+    /** Serialized block and compact block messages for recent blocks, shared between peers. */
+    node::BlockMessageCache m_block_message_cache{MAX_BLOCK_MESSAGE_CACHE_BYTES};
+
     // Data about the low-work headers synchronization, aggregated from all peers' HeadersSyncStates.
     /** Mutex guarding the other m_headers_presync_* variables. */
     Mutex m_headers_presync_mutex;
@@ -2511,13 +2520,33 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
         block_pos = pindex->GetBlockPos();
     }
 
+    // Messages for recent blocks are kept for other peers asking for them
+    const bool send_cmpctblock{inv.IsMsgCmpctBlk() && can_direct_fetch && pindex->nHeight >= tip->nHeight - MAX_CMPCTBLOCK_DEPTH};
+    std::optional<node::BlockWireFormat> wire_format;
+    if (pindex->nHeight >= tip->nHeight - MAX_BLOCK_MESSAGE_CACHE_DEPTH) {
+        if (inv.IsMsgBlk()) {
+            wire_format = node::BlockWireFormat::BLOCK;
+        } else if (inv.IsMsgWitnessBlk() || (inv.IsMsgCmpctBlk() && !send_cmpctblock)) {
+            wire_format = node::BlockWireFormat::WITNESS_BLOCK;
+        } else if (send_cmpctblock) {
+            wire_format = node::BlockWireFormat::CMPCT_BLOCK;
+        }
+    }
+    const auto push_block_message{[&](CSerializedNetMsg&& msg) {
+        if (wire_format) m_block_message_cache.Put(pindex->GetBlockHash(), *wire_format, msg.Copy());
+        PushMessage(pfrom, std::move(msg));
+    }};
+
     std::shared_ptr<const CBlock> pblock;
-    if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+    if (const auto cached_msg{wire_format ? m_block_message_cache.Get(pindex->GetBlockHash(), *wire_format) : nullptr}) {
+        PushMessage(pfrom, cached_msg->Copy());
+        // Don't set pblock as we've sent the block
+    } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
     } else if (inv.IsMsgWitnessBlk()) {
         // Fast-path: in this case it is possible to serve the block directly from disk,
         // as the network format matches the format on disk
-        std::vector<uint8_t> block_data;
+        node::RawBlock block_data;
         if (!m_chainman.m_blockman.ReadRawBlockFromDisk(block_data, block_pos)) {
             if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
                 LogPrint(BCLog::NET, "Block was pruned before it could be read, disconnect peer=%s\n", pfrom.GetId());
@@ -2527,12 +2556,12 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
             pfrom.fDisconnect = true;
             return;
         }
-        MakeAndPushMessage(pfrom, NetMsgType::BLOCK, Span{block_data});
+        push_block_message(NetMsg::Make(NetMsgType::BLOCK, block_data));
         // Don't set pblock as we've sent the block
     } else {
         // Send block from disk
         std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-        if (!m_chainman.m_blockman.ReadBlockFromDisk(*pblockRead, block_pos)) {
+        if (!m_chainman.m_blockman.ReadBlockFromDisk(*pblockRead, block_pos, pindex->GetBlockHash())) {
             if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
                 LogPrint(BCLog::NET, "Block was pruned before it could be read, disconnect peer=%s\n", pfrom.GetId());
             } else {
@@ -2545,9 +2574,9 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     }
     if (pblock) {
         if (inv.IsMsgBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_NO_WITNESS(*pblock));
+            push_block_message(NetMsg::Make(NetMsgType::BLOCK, TX_NO_WITNESS(*pblock)));
         } else if (inv.IsMsgWitnessBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
+            push_block_message(NetMsg::Make(NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock)));
         } else if (inv.IsMsgFilteredBlk()) {
             bool sendMerkleBlock = false;
             CMerkleBlock merkleBlock;
@@ -2577,15 +2606,15 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
             // they won't have a useful mempool to match against a compact block,
             // and we don't feel like constructing the object for them, so
             // instead we respond with the full, non-compact block.
-            if (can_direct_fetch && pindex->nHeight >= tip->nHeight - MAX_CMPCTBLOCK_DEPTH) {
+            if (send_cmpctblock) {
                 if (a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                    MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, *a_recent_compact_block);
+                    push_block_message(NetMsg::Make(NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock{*pblock, m_rng.rand64()};
-                    MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, cmpctblock);
+                    push_block_message(NetMsg::Make(NetMsgType::CMPCTBLOCK, cmpctblock));
                 }
             } else {
-                MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
+                push_block_message(NetMsg::Make(NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock)));
             }
         }
     }
@@ -2717,10 +2746,10 @@ void PeerManagerImpl::SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlo
     MakeAndPushMessage(pfrom, NetMsgType::BLOCKTXN, resp);
 }
 
-bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
+bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer, std::vector<uint256>& pow_hashes)
 {
     // Do these headers have proof-of-work matching what's claimed?
-    if (!HasValidProofOfWork(headers, consensusParams)) {
+    if (!HasValidProofOfWork(headers, consensusParams, &m_chainman.GetPoWCheckQueue(), &pow_hashes)) {
         Misbehaving(peer, "header with invalid proof of work");
         return false;
     }
@@ -3085,7 +3114,8 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
     // We'll rely on headers having valid proof-of-work further down, as an
     // anti-DoS criteria (note: this check is required before passing any
     // headers into HeadersSyncState).
-    if (!CheckHeadersPoW(headers, m_chainparams.GetConsensus(), peer)) {
+    std::vector<uint256> pow_hashes;
+    if (!CheckHeadersPoW(headers, m_chainparams.GetConsensus(), peer, pow_hashes)) {
         // Misbehaving() calls are handled within CheckHeadersPoW(), so we can
         // just return. (Note that even if a header is announced via compact
         // block, the header itself should be valid, so this type of error can
@@ -3107,7 +3137,13 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
     {
         LOCK(peer.m_headers_sync_mutex);
 
+        const uint256 last_received_hash{headers.back().GetHash()};
         already_validated_work = IsContinuationOfLowWorkHeadersSync(peer, pfrom, headers);
+        // Headers replaced by the sync were checked with an earlier message;
+        // the hashes checked above only apply to the ones still here.
+        if (headers.size() != pow_hashes.size() || (!headers.empty() && headers.back().GetHash() != last_received_hash)) {
+            pow_hashes.clear();
+        }
 
         // The headers we passed in may have been:
         // - untouched, perhaps if no headers-sync was in progress, or some
@@ -3183,7 +3219,7 @@ void PeerManagerImpl::ProcessHeadersMessage(CNode& pfrom, Peer& peer,
 
     // Now process all the headers.
     BlockValidationState state;
-    if (!m_chainman.ProcessNewBlockHeaders(headers, /*min_pow_checked=*/true, state, &pindexLast)) {
+    if (!m_chainman.ProcessNewBlockHeaders(headers, /*min_pow_checked=*/true, state, &pindexLast, pow_hashes.empty() ? nullptr : &pow_hashes)) {
         if (state.IsInvalid()) {
             MaybePunishNodeForBlock(pfrom.GetId(), state, via_compact_block, "invalid header received");
             return;
@@ -4437,7 +4473,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
 
         if (!block_pos.IsNull()) {
             CBlock block;
-            const bool ret{m_chainman.m_blockman.ReadBlockFromDisk(block, block_pos)};
+            const bool ret{m_chainman.m_blockman.ReadBlockFromDisk(block, block_pos, req.blockhash)};
             // If height is above MAX_BLOCKTXN_DEPTH then this block cannot get
             // pruned after we release cs_main above, so this read should never fail.
             assert(ret);
@@ -4556,8 +4592,9 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         // is not considered a protocol violation, so don't punish the peer.
         if (m_chainman.IsInitialBlockDownload()) return;
 
-        CTransactionRef ptx;
-        vRecv >> TX_WITH_WITNESS(ptx);
+        // Hash the received bytes rather than serializing the transaction again
+        SpanReader tx_reader{MakeUCharSpan(vRecv)};
+        const CTransactionRef ptx{std::make_shared<const CTransaction>(TX_WITH_WITNESS, tx_reader)};
         const CTransaction& tx = *ptx;
 
         const uint256& txid = ptx->GetHash();
@@ -4986,7 +5023,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
 
         BlockTransactions resp;
-        vRecv >> resp;
+        SpanReader{MakeUCharSpan(vRecv)} >> resp;
 
         return ProcessCompactBlockTxns(pfrom, *peer, resp);
     }
@@ -5041,7 +5078,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> TX_WITH_WITNESS(*pblock);
+        SpanReader{MakeUCharSpan(vRecv)} >> TX_WITH_WITNESS(*pblock);
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom.GetId());
 
@@ -6053,10 +6090,13 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                             vHeaders.front().GetHash().ToString(), pto->GetId());
 
                     std::optional<CSerializedNetMsg> cached_cmpctblock_msg;
-                    {
+                    if (const auto msg{m_block_message_cache.Get(pBestIndex->GetBlockHash(), node::BlockWireFormat::CMPCT_BLOCK)}) {
+                        cached_cmpctblock_msg = msg->Copy();
+                    } else {
                         LOCK(m_most_recent_block_mutex);
                         if (m_most_recent_block_hash == pBestIndex->GetBlockHash()) {
                             cached_cmpctblock_msg = NetMsg::Make(NetMsgType::CMPCTBLOCK, *m_most_recent_compact_block);
+                            m_block_message_cache.Put(pBestIndex->GetBlockHash(), node::BlockWireFormat::CMPCT_BLOCK, cached_cmpctblock_msg->Copy());
                         }
                     }
                     if (cached_cmpctblock_msg.has_value()) {
@@ -0,0 +1,91 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockfilemap.h>
+
+#include <logging.h>
+#include <util/check.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace node {
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    const int fd{open(path.c_str(), O_RDONLY)};
+    if (fd == -1) return nullptr;
+    struct stat st;
+    void* addr{MAP_FAILED};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping keeps the file open
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrint(BCLog::BLOCKSTORAGE, "Cannot map %s\n", fs::PathToString(path));
+        return nullptr;
+    }
+    return std::shared_ptr<const MappedFile>{new MappedFile{static_cast<const std::byte*>(addr), size_t(st.st_size)}};
+#else
+    return nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+}
+
+std::shared_ptr<const MappedFile> FlatFileMapCache::Get(const FlatFilePos& pos)
+{
+    LOCK(m_mutex);
+    auto it{std::find_if(m_files.begin(), m_files.end(), [&](const auto& entry) { return entry.first == pos.nFile; })};
+    if (it != m_files.end() && it->second->Data().size() >= pos.nPos) {
+        m_files.splice(m_files.begin(), m_files, it);
+        return it->second;
+    }
+    if (it != m_files.end()) m_files.erase(it);
+
+    auto file{MappedFile::Open(m_seq.FileName(pos))};
+    if (!file || file->Data().size() < pos.nPos) return nullptr;
+    m_files.emplace_front(pos.nFile, file);
+    if (m_files.size() > m_max_files) m_files.pop_back();
+    return file;
+}
+
+void FlatFileMapCache::Erase(int file)
+{
+    LOCK(m_mutex);
+    m_files.remove_if([&](const auto& entry) { return entry.first == file; });
+}
+
+RawBlock::RawBlock(std::shared_ptr<const MappedFile> file, Span<const std::byte> bytes, Span<const std::byte> xor_key, size_t key_offset)
+    : m_file{std::move(file)}, m_bytes{bytes}, m_key_offset{key_offset}
+{
+    Assert(xor_key.size() == m_xor_key.size());
+    std::copy(xor_key.begin(), xor_key.end(), m_xor_key.begin());
+    m_obfuscated = std::any_of(m_xor_key.begin(), m_xor_key.end(), [](std::byte b) { return b != std::byte{0}; });
+}
+
+Span<const uint8_t> RawBlock::Data()
+{
+    if (m_obfuscated) {
+        m_data.assign(UCharCast(m_bytes.data()), UCharCast(m_bytes.data() + m_bytes.size()));
+        util::Xor(MakeWritableByteSpan(m_data), m_xor_key, m_key_offset);
+        m_bytes = MakeByteSpan(m_data);
+        m_file.reset();
+        m_obfuscated = false;
+    }
+    return MakeUCharSpan(m_bytes);
+}
+
+} // namespace node
@@ -0,0 +1,123 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKFILEMAP_H
+#define BITCOIN_NODE_BLOCKFILEMAP_H
+
+#include <flatfile.h>
+#include <span.h>
+#include <streams.h>
+#include <sync.h>
+#include <util/fs.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace node {
+
+/** Read-only memory mapping of a whole file. */
+class MappedFile
+{
+public:
+    /** Map the file at path, or return nullptr if it is empty or cannot be mapped. */
+    static std::shared_ptr<const MappedFile> Open(const fs::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    Span<const std::byte> Data() const { return {m_data, m_size}; }
+
+private:
+    MappedFile(const std::byte* data, size_t size) : m_data{data}, m_size{size} {}
+
+    const std::byte* const m_data;
+    const size_t m_size;
+};
+
+/**
+ * Mappings of the most recently read files of a FlatFileSeq, at most
+ * max_files of them. A mapping stays valid for as long as a reader holds on to
+ * it, also after it was evicted or its file was deleted.
+ */
+class FlatFileMapCache
+{
+public:
+    FlatFileMapCache(const FlatFileSeq& seq, size_t max_files) : m_seq{seq}, m_max_files{max_files} {}
+
+    /**
+     * Mapping of file pos.nFile covering at least its first pos.nPos bytes,
+     * mapped again when the file grew past the cached mapping. Returns nullptr
+     * if the file cannot be mapped or is too short.
+     */
+    std::shared_ptr<const MappedFile> Get(const FlatFilePos& pos) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Drop the mapping of a file, e.g. because it is about to be deleted. */
+    void Erase(int file) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    const FlatFileSeq& m_seq;
+    const size_t m_max_files;
+    Mutex m_mutex;
+    //! Mappings by file number, most recently used first
+    std::list<std::pair<int, std::shared_ptr<const MappedFile>>> m_files GUARDED_BY(m_mutex);
+};
+
+/**
+ * The serialized bytes of a block as stored in a block file. They either point
+ * into a mapped block file, still obfuscated with the block files' XOR key, or
+ * are held in memory.
+ */
+class RawBlock
+{
+public:
+    RawBlock() = default;
+    explicit RawBlock(std::vector<uint8_t> data) : m_data{std::move(data)}, m_bytes{MakeByteSpan(m_data)} {}
+    RawBlock(std::shared_ptr<const MappedFile> file, Span<const std::byte> bytes, Span<const std::byte> xor_key, size_t key_offset);
+    RawBlock(RawBlock&&) = default;
+    RawBlock& operator=(RawBlock&&) = default;
+    RawBlock(const RawBlock&) = delete;
+    RawBlock& operator=(const RawBlock&) = delete;
+
+    size_t size() const { return m_bytes.size(); }
+
+    /** The block's bytes, decoded into memory first if they are obfuscated. */
+    Span<const uint8_t> Data();
+
+    /** Write the decoded bytes, without a length prefix, removing any obfuscation on the way. */
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (!m_obfuscated) {
+            s.write(m_bytes);
+            return;
+        }
+        std::array<std::byte, 4096> buf;
+        for (size_t offset{0}; offset < m_bytes.size(); offset += buf.size()) {
+            const auto chunk{m_bytes.subspan(offset, std::min(buf.size(), m_bytes.size() - offset))};
+            std::copy(chunk.begin(), chunk.end(), buf.begin());
+            const Span<std::byte> decoded{Span{buf}.first(chunk.size())};
+            util::Xor(decoded, m_xor_key, m_key_offset + offset);
+            s.write(decoded);
+        }
+    }
+
+private:
+    std::shared_ptr<const MappedFile> m_file;
+    std::vector<uint8_t> m_data;
+    Span<const std::byte> m_bytes;
+    std::array<std::byte, 8> m_xor_key{};
+    size_t m_key_offset{0};
+    bool m_obfuscated{false};
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_BLOCKFILEMAP_H
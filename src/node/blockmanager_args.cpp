@@ -33,6 +33,14 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, BlockManager::Op
     opts.prune_target = nPruneTarget;
 
     if (auto value{args.GetBoolArg("-fastprune")}) opts.fast_prune = *value;
+    if (auto value{args.GetBoolArg("-paranoidblockreads")}) opts.paranoid_block_reads = *value;
+    if (auto value{args.GetIntArg("-mappedblockfiles")}) {
+        if (*value < 0) {
+            return util::Error{_("The number of mapped block files cannot be negative.")};
+        }
+        opts.max_mapped_block_files = *value;
+    }
+    if (auto value{args.GetBoolArg("-compressblocks")}) opts.compress_blocks = *value;
 
     return {};
 }
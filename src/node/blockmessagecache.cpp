@@ -0,0 +1,47 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockmessagecache.h>
+
+namespace node {
+
+std::shared_ptr<const CSerializedNetMsg> BlockMessageCache::Get(const uint256& hash, BlockWireFormat format)
+{
+    LOCK(m_mutex);
+    const auto it{m_index.find(Key{hash, format})};
+    if (it == m_index.end()) return nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->second;
+}
+
+void BlockMessageCache::Put(const uint256& hash, BlockWireFormat format, CSerializedNetMsg&& msg)
+{
+    const size_t usage{msg.GetMemoryUsage()};
+    if (usage > m_max_bytes) return;
+    auto entry{std::make_shared<const CSerializedNetMsg>(std::move(msg))};
+
+    LOCK(m_mutex);
+    const Key key{hash, format};
+    if (const auto it{m_index.find(key)}; it != m_index.end()) {
+        m_usage -= it->second->second->GetMemoryUsage();
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+    while (!m_entries.empty() && m_usage + usage > m_max_bytes) {
+        m_usage -= m_entries.back().second->GetMemoryUsage();
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    m_entries.emplace_front(key, std::move(entry));
+    m_index.emplace(key, m_entries.begin());
+    m_usage += usage;
+}
+
+size_t BlockMessageCache::Usage() const
+{
+    LOCK(m_mutex);
+    return m_usage;
+}
+
+} // namespace node
@@ -0,0 +1,62 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKMESSAGECACHE_H
+#define BITCOIN_NODE_BLOCKMESSAGECACHE_H
+
+#include <net.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace node {
+
+/** The messages a block is served to peers in. */
+enum class BlockWireFormat : uint8_t {
+    BLOCK,         //!< block message without witnesses
+    WITNESS_BLOCK, //!< block message with witnesses
+    CMPCT_BLOCK,   //!< cmpctblock message
+};
+
+/**
+ * Least recently used cache of serialized messages for recent blocks, keyed by
+ * block hash and wire format. Peers asking for the same block in the same
+ * format are served these bytes instead of reading and serializing the block
+ * again. Bounded by the memory usage of the cached messages.
+ */
+class BlockMessageCache
+{
+public:
+    explicit BlockMessageCache(size_t max_bytes) : m_max_bytes{max_bytes} {}
+
+    /** The cached message, or nullptr. */
+    std::shared_ptr<const CSerializedNetMsg> Get(const uint256& hash, BlockWireFormat format) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Cache a message, evicting the least recently used ones to make room. */
+    void Put(const uint256& hash, BlockWireFormat format, CSerializedNetMsg&& msg) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Memory usage of the cached messages. */
+    size_t Usage() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    using Key = std::pair<uint256, BlockWireFormat>;
+    using Entry = std::pair<Key, std::shared_ptr<const CSerializedNetMsg>>;
+
+    const size_t m_max_bytes;
+    mutable Mutex m_mutex;
+    //! Most recently used first
+    std::list<Entry> m_entries GUARDED_BY(m_mutex);
+    std::map<Key, std::list<Entry>::iterator> m_index GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_BLOCKMESSAGECACHE_H
@@ -130,11 +130,16 @@ bool BlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, s
                 pindexNew->nNonce         = diskindex.nNonce;
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
+                pindexNew->hashPoW        = diskindex.hashPoW;
 
                 if (pindexNew->GetBlockHeader().GetHash() != pindexNew->GetBlockHash()) {
                     LogError("%s: GetHash failed: %s\n", __func__, pindexNew->ToString());
                     return false;
                 }
+                if (pindexNew->nStatus & BLOCK_HAVE_POW_HASH && !CheckProofOfWork(pindexNew->hashPoW, pindexNew->nBits, consensusParams)) {
+                    LogError("%s: CheckProofOfWork failed: %s\n", __func__, pindexNew->ToString());
+                    return false;
+                }
 
                 pcursor->Next();
             } else {
@@ -669,7 +674,16 @@ CBlockFileInfo* BlockManager::GetBlockFileInfo(size_t n)
     return &m_blockfile_info.at(n);
 }
 
-bool BlockManager::UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock) const
+/** The compressed payload of a block or undo record, or nothing if it is better stored as is. */
+template <typename T>
+static std::vector<uint8_t> CompressRecord(BlockFileCompressor& compressor, const T& record)
+{
+    std::vector<uint8_t> data;
+    VectorWriter{data, 0, record};
+    return compressor.Compress(data);
+}
+
+bool BlockManager::UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock, Span<const uint8_t> compressed) const
 {
     // Open history file to append
     AutoFile fileout{OpenUndoFile(pos)};
@@ -679,7 +693,7 @@ bool BlockManager::UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos
     }
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo);
+    unsigned int nSize = compressed.empty() ? GetSerializeSize(blockundo) : compressed.size() | COMPRESSED_RECORD_FLAG;
     fileout << GetParams().MessageStart() << nSize;
 
     // Write undo data
@@ -689,9 +703,13 @@ bool BlockManager::UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos
         return false;
     }
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    if (compressed.empty()) {
+        fileout << blockundo;
+    } else {
+        fileout.write(MakeByteSpan(compressed));
+    }
 
-    // calculate & write checksum
+    // calculate & write checksum of the undo data, compressed or not
     HashWriter hasher{};
     hasher << hashBlock;
     hasher << blockundo;
@@ -704,8 +722,12 @@ bool BlockManager::UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex& in
 {
     const FlatFilePos pos{WITH_LOCK(::cs_main, return index.GetUndoPos())};
 
-    // Open history file to read
-    AutoFile filein{OpenUndoFile(pos, true)};
+    // Open history file to read, from the header before the undo data
+    if (pos.nPos < BLOCK_SERIALIZATION_HEADER_SIZE) {
+        LogError("%s: OpenUndoFile failed for %s\n", __func__, pos.ToString());
+        return false;
+    }
+    AutoFile filein{OpenUndoFile(FlatFilePos{pos.nFile, pos.nPos - static_cast<unsigned int>(BLOCK_SERIALIZATION_HEADER_SIZE)}, true)};
     if (filein.IsNull()) {
         LogError("%s: OpenUndoFile failed for %s\n", __func__, pos.ToString());
         return false;
@@ -713,18 +735,41 @@ bool BlockManager::UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex& in
 
     // Read block
     uint256 hashChecksum;
-    HashVerifier verifier{filein}; // Use HashVerifier as reserializing may lose data, c.f. commit d342424301013ec47dc146a4beb49d5c9319d80a
+    uint256 hash;
     try {
+        MessageStartChars undo_start;
+        unsigned int undo_size;
+        filein >> undo_start >> undo_size;
+        const bool compressed{(undo_size & COMPRESSED_RECORD_FLAG) != 0};
+        undo_size &= ~COMPRESSED_RECORD_FLAG;
+        if (undo_size > MAX_SIZE) {
+            LogError("%s: Undo data is larger than maximum deserialization size for %s\n", __func__, pos.ToString());
+            return false;
+        }
+        std::vector<uint8_t> undo_data(undo_size);
+        filein.read(MakeWritableByteSpan(undo_data));
+        filein >> hashChecksum;
+        if (compressed) {
+            auto decompressed{m_undo_compressor.Decompress(undo_data)};
+            if (!decompressed) {
+                LogError("%s: Cannot decompress undo data at %s\n", __func__, pos.ToString());
+                return false;
+            }
+            undo_data = std::move(*decompressed);
+        }
+
+        SpanReader reader{undo_data};
+        HashVerifier verifier{reader}; // Use HashVerifier as reserializing may lose data, c.f. commit d342424301013ec47dc146a4beb49d5c9319d80a
         verifier << index.pprev->GetBlockHash();
         verifier >> blockundo;
-        filein >> hashChecksum;
+        hash = verifier.GetHash();
     } catch (const std::exception& e) {
         LogError("%s: Deserialize or I/O error - %s at %s\n", __func__, e.what(), pos.ToString());
         return false;
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash()) {
+    if (hashChecksum != hash) {
         LogError("%s: Checksum mismatch at %s\n", __func__, pos.ToString());
         return false;
     }
@@ -809,6 +854,7 @@ void BlockManager::UnlinkPrunedFiles(const std::set<int>& setFilesToPrune) const
     std::error_code ec;
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         FlatFilePos pos(*it, 0);
+        if (m_block_file_maps) m_block_file_maps->Erase(*it);
         const bool removed_blockfile{fs::remove(m_block_file_seq.FileName(pos), ec)};
         const bool removed_undofile{fs::remove(m_undo_file_seq.FileName(pos), ec)};
         if (removed_blockfile || removed_undofile) {
@@ -967,7 +1013,7 @@ bool BlockManager::FindUndoPos(BlockValidationState& state, int nFile, FlatFileP
     return true;
 }
 
-bool BlockManager::WriteBlockToDisk(const CBlock& block, FlatFilePos& pos) const
+bool BlockManager::WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, Span<const uint8_t> compressed) const
 {
     // Open history file to append
     AutoFile fileout{OpenBlockFile(pos)};
@@ -977,7 +1023,7 @@ bool BlockManager::WriteBlockToDisk(const CBlock& block, FlatFilePos& pos) const
     }
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(TX_WITH_WITNESS(block));
+    unsigned int nSize = compressed.empty() ? GetSerializeSize(TX_WITH_WITNESS(block)) : compressed.size() | COMPRESSED_RECORD_FLAG;
     fileout << GetParams().MessageStart() << nSize;
 
     // Write block
@@ -987,7 +1033,11 @@ bool BlockManager::WriteBlockToDisk(const CBlock& block, FlatFilePos& pos) const
         return false;
     }
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << TX_WITH_WITNESS(block);
+    if (compressed.empty()) {
+        fileout << TX_WITH_WITNESS(block);
+    } else {
+        fileout.write(MakeByteSpan(compressed));
+    }
 
     return true;
 }
@@ -1000,12 +1050,13 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
 
     // Write undo information to disk
     if (block.GetUndoPos().IsNull()) {
+        const std::vector<uint8_t> compressed{m_opts.compress_blocks ? CompressRecord(m_undo_compressor, blockundo) : std::vector<uint8_t>{}};
         FlatFilePos _pos;
-        if (!FindUndoPos(state, block.nFile, _pos, ::GetSerializeSize(blockundo) + 40)) {
+        if (!FindUndoPos(state, block.nFile, _pos, (compressed.empty() ? ::GetSerializeSize(blockundo) : compressed.size()) + 40)) {
             LogError("%s: FindUndoPos failed\n", __func__);
             return false;
         }
-        if (!UndoWriteToDisk(blockundo, _pos, block.pprev->GetBlockHash())) {
+        if (!UndoWriteToDisk(blockundo, _pos, block.pprev->GetBlockHash(), compressed)) {
             return FatalError(m_opts.notifications, state, _("Failed to write undo data."));
         }
         // rev files are written in block height order, whereas blk files are written as blocks come in (often out of order)
@@ -1034,30 +1085,40 @@ bool BlockManager::WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValid
     return true;
 }
 
-bool BlockManager::ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos) const
+bool BlockManager::ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const std::optional<uint256>& expected_hash, const std::optional<uint256>& expected_pow_hash) const
 {
     block.SetNull();
 
-    // Open history file to read
-    AutoFile filein{OpenBlockFile(pos, true)};
-    if (filein.IsNull()) {
-        LogError("%s: OpenBlockFile failed for %s\n", __func__, pos.ToString());
-        return false;
-    }
-
     // Read block
     try {
-        filein >> TX_WITH_WITNESS(block);
+        // Deserialize from the block's bytes, decompressed if they were stored
+        // compressed, hashing the transactions in place
+        RawBlock raw;
+        if (!ReadRawBlockFromDisk(raw, pos)) return false;
+        SpanReader{raw.Data()} >> TX_WITH_WITNESS(block);
     } catch (const std::exception& e) {
         LogError("%s: Deserialize or I/O error - %s at %s\n", __func__, e.what(), pos.ToString());
         return false;
     }
 
-    // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, GetConsensus())) {
-        LogError("%s: Errors in block header at %s\n", __func__, pos.ToString());
+    // Check the header. A block read for a known index entry only needs to be
+    // the block that was indexed; recomputing its PoW is left to paranoid mode.
+    if (expected_hash && block.GetHash() != *expected_hash) {
+        LogError("%s: GetHash() doesn't match index for %s at %s\n", __func__, expected_hash->ToString(), pos.ToString());
         return false;
     }
+    if (!expected_hash || m_opts.paranoid_block_reads) {
+        const uint256 pow_hash{block.GetPoWHash()};
+        if (!CheckProofOfWork(pow_hash, block.nBits, GetConsensus())) {
+            LogError("%s: Errors in block header at %s\n", __func__, pos.ToString());
+            return false;
+        }
+        if (expected_pow_hash && pow_hash != *expected_pow_hash) {
+            LogError("%s: GetPoWHash() doesn't match index for %s at %s\n", __func__, expected_hash->ToString(), pos.ToString());
+            return false;
+        }
+    }
+    if (expected_hash && expected_pow_hash) block.m_checked_pow.emplace(*expected_hash, *expected_pow_hash);
 
     // Signet only: check block solution
     if (GetConsensus().signet_blocks && !CheckSignetBlockSolution(block, GetConsensus())) {
@@ -1070,13 +1131,22 @@ bool BlockManager::ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos) cons
 
 bool BlockManager::ReadBlockFromDisk(CBlock& block, const CBlockIndex& index) const
 {
-    const FlatFilePos block_pos{WITH_LOCK(cs_main, return index.GetBlockPos())};
+    const auto [block_pos, pow_hash]{WITH_LOCK(cs_main, return std::make_pair(index.GetBlockPos(), index.GetPoWHash()))};
+    return ReadBlockFromDisk(block, block_pos, index.GetBlockHash(), pow_hash);
+}
 
-    if (!ReadBlockFromDisk(block, block_pos)) {
+bool BlockManager::CheckRawBlockHeader(const MessageStartChars& blk_start, unsigned int blk_size, const FlatFilePos& pos) const
+{
+    if (blk_start != GetParams().MessageStart()) {
+        LogError("%s: Block magic mismatch for %s: %s versus expected %s\n", __func__, pos.ToString(),
+                     HexStr(blk_start),
+                     HexStr(GetParams().MessageStart()));
         return false;
     }
-    if (block.GetHash() != index.GetBlockHash()) {
-        LogError("%s: GetHash() doesn't match index for %s at %s\n", __func__, index.ToString(), block_pos.ToString());
+
+    if (blk_size > MAX_SIZE) {
+        LogError("%s: Block data is larger than maximum deserialization size for %s: %s versus %s\n", __func__, pos.ToString(),
+                     blk_size, MAX_SIZE);
         return false;
     }
     return true;
@@ -1103,22 +1173,13 @@ bool BlockManager::ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatF
         unsigned int blk_size;
 
         filein >> blk_start >> blk_size;
-
-        if (blk_start != GetParams().MessageStart()) {
-            LogError("%s: Block magic mismatch for %s: %s versus expected %s\n", __func__, pos.ToString(),
-                         HexStr(blk_start),
-                         HexStr(GetParams().MessageStart()));
-            return false;
-        }
-
-        if (blk_size > MAX_SIZE) {
-            LogError("%s: Block data is larger than maximum deserialization size for %s: %s versus %s\n", __func__, pos.ToString(),
-                         blk_size, MAX_SIZE);
-            return false;
-        }
+        const bool compressed{(blk_size & COMPRESSED_RECORD_FLAG) != 0};
+        blk_size &= ~COMPRESSED_RECORD_FLAG;
+        if (!CheckRawBlockHeader(blk_start, blk_size, pos)) return false;
 
         block.resize(blk_size); // Zeroing of memory is intentional here
         filein.read(MakeWritableByteSpan(block));
+        if (compressed) return DecompressRawBlock(block, pos);
     } catch (const std::exception& e) {
         LogError("%s: Read from block file failed: %s for %s\n", __func__, e.what(), pos.ToString());
         return false;
@@ -1127,9 +1188,59 @@ bool BlockManager::ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatF
     return true;
 }
 
+bool BlockManager::ReadRawBlockFromDisk(RawBlock& block, const FlatFilePos& pos) const
+{
+    if (m_block_file_maps && pos.nPos >= BLOCK_SERIALIZATION_HEADER_SIZE) {
+        if (auto file{m_block_file_maps->Get(pos)}) {
+            const size_t header_pos{pos.nPos - BLOCK_SERIALIZATION_HEADER_SIZE};
+            std::array<std::byte, BLOCK_SERIALIZATION_HEADER_SIZE> header;
+            const auto header_bytes{file->Data().subspan(header_pos, header.size())};
+            std::copy(header_bytes.begin(), header_bytes.end(), header.begin());
+            util::Xor(header, m_xor_key, header_pos);
+            MessageStartChars blk_start;
+            unsigned int blk_size;
+            SpanReader{MakeUCharSpan(header)} >> blk_start >> blk_size;
+            const bool compressed{(blk_size & COMPRESSED_RECORD_FLAG) != 0};
+            blk_size &= ~COMPRESSED_RECORD_FLAG;
+            if (!CheckRawBlockHeader(blk_start, blk_size, pos)) return false;
+
+            // The block may have been written after the file was mapped
+            if (file->Data().size() - pos.nPos < blk_size) {
+                file = m_block_file_maps->Get(FlatFilePos{pos.nFile, pos.nPos + blk_size});
+            }
+            if (file) {
+                block = RawBlock{file, file->Data().subspan(pos.nPos, blk_size), m_xor_key, pos.nPos};
+                if (!compressed) return true;
+                const auto payload{block.Data()};
+                std::vector<uint8_t> data{payload.begin(), payload.end()};
+                if (!DecompressRawBlock(data, pos)) return false;
+                block = RawBlock{std::move(data)};
+                return true;
+            }
+        }
+    }
+
+    std::vector<uint8_t> data;
+    if (!ReadRawBlockFromDisk(data, pos)) return false;
+    block = RawBlock{std::move(data)};
+    return true;
+}
+
+bool BlockManager::DecompressRawBlock(std::vector<uint8_t>& block, const FlatFilePos& pos) const
+{
+    auto decompressed{m_block_compressor.Decompress(block)};
+    if (!decompressed) {
+        LogError("%s: Cannot decompress block at %s\n", __func__, pos.ToString());
+        return false;
+    }
+    block = std::move(*decompressed);
+    return true;
+}
+
 FlatFilePos BlockManager::SaveBlockToDisk(const CBlock& block, int nHeight)
 {
-    unsigned int nBlockSize = ::GetSerializeSize(TX_WITH_WITNESS(block));
+    const std::vector<uint8_t> compressed{m_opts.compress_blocks ? CompressRecord(m_block_compressor, TX_WITH_WITNESS(block)) : std::vector<uint8_t>{}};
+    unsigned int nBlockSize = compressed.empty() ? ::GetSerializeSize(TX_WITH_WITNESS(block)) : compressed.size();
     // Account for the 4 magic message start bytes + the 4 length bytes (8 bytes total,
     // defined as BLOCK_SERIALIZATION_HEADER_SIZE)
     nBlockSize += static_cast<unsigned int>(BLOCK_SERIALIZATION_HEADER_SIZE);
@@ -1138,7 +1249,7 @@ FlatFilePos BlockManager::SaveBlockToDisk(const CBlock& block, int nHeight)
         LogError("%s: FindNextBlockPos failed\n", __func__);
         return FlatFilePos();
     }
-    if (!WriteBlockToDisk(block, blockPos)) {
+    if (!WriteBlockToDisk(block, blockPos, compressed)) {
         m_opts.notifications.fatalError(_("Failed to write block."));
         return FlatFilePos();
     }
@@ -1191,6 +1302,9 @@ BlockManager::BlockManager(const util::SignalInterrupt& interrupt, Options opts)
       m_opts{std::move(opts)},
       m_block_file_seq{FlatFileSeq{m_opts.blocks_dir, "blk", m_opts.fast_prune ? 0x4000 /* 16kB */ : BLOCKFILE_CHUNK_SIZE}},
       m_undo_file_seq{FlatFileSeq{m_opts.blocks_dir, "rev", UNDOFILE_CHUNK_SIZE}},
+      m_block_file_maps{m_opts.max_mapped_block_files > 0 ? std::make_unique<FlatFileMapCache>(m_block_file_seq, m_opts.max_mapped_block_files) : nullptr},
+      m_block_compressor{m_opts.blocks_dir, "blk", m_xor_key},
+      m_undo_compressor{m_opts.blocks_dir, "rev", m_xor_key},
       m_interrupt{interrupt} {}
 
 class ImportingNow
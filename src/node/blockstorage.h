@@ -6,6 +6,7 @@
 #define BITCOIN_NODE_BLOCKSTORAGE_H
 
 #include <attributes.h>
+#include <blockcompression.h>
 #include <chain.h>
 #include <dbwrapper.h>
 #include <flatfile.h>
@@ -13,6 +14,7 @@
 #include <kernel/chainparams.h>
 #include <kernel/cs_main.h>
 #include <kernel/messagestartchars.h>
+#include <node/blockfilemap.h>
 #include <primitives/block.h>
 #include <streams.h>
 #include <sync.h>
@@ -173,9 +175,11 @@ private:
      * point to an unused file location where separator fields will be written, followed by the serialized CBlock data.
      * After this call, it will point to the beginning of the serialized CBlock data, after the separator fields
      * (BLOCK_SERIALIZATION_HEADER_SIZE)
+     *
+     * If compressed is not empty, it is stored as the compressed payload of the record instead.
      */
-    bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos) const;
-    bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock) const;
+    bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, Span<const uint8_t> compressed = {}) const;
+    bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint256& hashBlock, Span<const uint8_t> compressed = {}) const;
 
     /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
     void FindFilesToPruneManual(
@@ -263,6 +267,18 @@ private:
     const FlatFileSeq m_block_file_seq;
     const FlatFileSeq m_undo_file_seq;
 
+    //! Mapped block files to read from, if enabled
+    const std::unique_ptr<FlatFileMapCache> m_block_file_maps;
+
+    //! Compression of block and undo file records, used to read compressed
+    //! records whether or not new ones are compressed
+    BlockFileCompressor m_block_compressor;
+    BlockFileCompressor m_undo_compressor;
+
+    bool CheckRawBlockHeader(const MessageStartChars& blk_start, unsigned int blk_size, const FlatFilePos& pos) const;
+    //! Replace the payload of a compressed block record with the block
+    bool DecompressRawBlock(std::vector<uint8_t>& block, const FlatFilePos& pos) const;
+
 public:
     using Options = kernel::BlockManagerOpts;
 
@@ -419,10 +435,25 @@ public:
      */
     void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune) const;
 
-    /** Functions for disk access for blocks */
-    bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos) const;
+    /**
+     * Functions for disk access for blocks.
+     *
+     * When the expected block hash is known, the header already passed proof of
+     * work on its way into the block index, so only its SHA3 identity hash is
+     * checked, unless paranoid_block_reads is set. The proof-of-work hash stored
+     * in the index, if any, is kept with the block for CheckBlock(), and in
+     * paranoid mode compared with the recomputed one. Blocks stored compressed
+     * are decompressed on the way.
+     */
+    bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const std::optional<uint256>& expected_hash = {},
+                           const std::optional<uint256>& expected_pow_hash = {}) const;
     bool ReadBlockFromDisk(CBlock& block, const CBlockIndex& index) const;
     bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos) const;
+    /** Read a block's bytes, pointing into a mapped block file when -mappedblockfiles is enabled. */
+    bool ReadRawBlockFromDisk(RawBlock& block, const FlatFilePos& pos) const;
+
+    /** The block a compressed block record payload decompresses to, e.g. when found while reindexing. */
+    std::optional<std::vector<uint8_t>> DecompressBlock(Span<const uint8_t> payload) const { return m_block_compressor.Decompress(payload); }
 
     bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex& index) const;
 
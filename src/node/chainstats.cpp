@@ -0,0 +1,110 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/chainstats.h>
+
+#include <chain.h>
+#include <util/check.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace node {
+
+ChainStats::ChainStats()
+{
+    LOCK(m_mutex);
+    m_times.emplace_back();
+}
+
+void ChainStats::Update(const CChain& chain)
+{
+    AssertLockHeld(::cs_main);
+    LOCK(m_mutex);
+
+    // Drop whatever is no longer part of the chain
+    size_t height{std::min<size_t>(m_hashes.size(), chain.Height() + 1)};
+    while (height > 0 && m_hashes[height - 1] != chain[height - 1]->GetBlockHash()) --height;
+    if (height < m_hashes.size()) {
+        m_hashes.resize(height);
+        m_work.resize(height);
+        m_bits.resize(height);
+        m_times[0].resize(height);
+        UpdateTail();
+    }
+
+    for (int i = height; i <= chain.Height(); ++i) {
+        const CBlockIndex& block{*Assert(chain[i])};
+        m_hashes.push_back(block.GetBlockHash());
+        m_work.push_back(block.nChainWork);
+        m_bits.push_back(block.nBits);
+        m_times[0].emplace_back(block.GetBlockTime(), block.GetBlockTime());
+        UpdateTail();
+    }
+}
+
+void ChainStats::UpdateTail()
+{
+    size_t k{1};
+    for (; m_times[k - 1].size() > 1; ++k) {
+        if (m_times.size() == k) m_times.emplace_back();
+        const std::vector<MinMax>& below{m_times[k - 1]};
+        std::vector<MinMax>& level{m_times[k]};
+        level.resize((below.size() + 1) / 2);
+        const size_t i{level.size() - 1};
+        level[i] = below[2 * i];
+        if (2 * i + 1 < below.size()) {
+            level[i].first = std::min(level[i].first, below[2 * i + 1].first);
+            level[i].second = std::max(level[i].second, below[2 * i + 1].second);
+        }
+    }
+    m_times.resize(k);
+}
+
+int ChainStats::Height() const
+{
+    LOCK(m_mutex);
+    return int(m_hashes.size()) - 1;
+}
+
+ChainStats::Range ChainStats::GetRangeInternal(size_t first, size_t last) const
+{
+    AssertLockHeld(m_mutex);
+    Range range{m_work[last] - m_work[first], std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min()};
+    const auto merge{[&](const MinMax& times) {
+        range.min_time = std::min(range.min_time, times.first);
+        range.max_time = std::max(range.max_time, times.second);
+    }};
+    // Walk up from both ends, taking the nodes that stick out of the range above
+    size_t begin{first}, end{last + 1};
+    for (size_t k{0}; begin < end; ++k) {
+        if (begin & 1) merge(m_times[k][begin++]);
+        if (end & 1) merge(m_times[k][--end]);
+        begin >>= 1;
+        end >>= 1;
+    }
+    return range;
+}
+
+std::optional<ChainStats::Range> ChainStats::GetRange(int first, int last) const
+{
+    LOCK(m_mutex);
+    if (first < 0 || first > last || last >= int(m_hashes.size())) return std::nullopt;
+    return GetRangeInternal(first, last);
+}
+
+std::vector<ChainStats::Entry> ChainStats::GetEntries(int first, int last, int step) const
+{
+    LOCK(m_mutex);
+    std::vector<Entry> entries;
+    if (first < 0 || first > last || last >= int(m_hashes.size()) || step < 1) return entries;
+    entries.reserve((last - first) / step + 1);
+    for (int height{last}; height >= first; height -= step) {
+        entries.push_back({height, m_times[0][height].first, m_bits[height], m_work[height], GetRangeInternal(std::max(height - step, 0), height)});
+    }
+    std::reverse(entries.begin(), entries.end());
+    return entries;
+}
+
+} // namespace node
@@ -0,0 +1,83 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_CHAINSTATS_H
+#define BITCOIN_NODE_CHAINSTATS_H
+
+#include <arith_uint256.h>
+#include <kernel/cs_main.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+class CChain;
+
+namespace node {
+
+/**
+ * Flat per-height copy of the active chain's cumulative work, block times and
+ * targets, for statistics over long height ranges without walking CBlockIndex
+ * entries under cs_main.
+ *
+ * Update() catches up with the chain, only touching the blocks connected or
+ * disconnected since the previous call. Range queries take O(log n): block
+ * times are kept in a tree of aligned power-of-two blocks holding their
+ * minimum and maximum time.
+ */
+class ChainStats
+{
+public:
+    struct Range {
+        //! Work of the blocks after the first height, up to and including the last
+        arith_uint256 work;
+        //! Lowest and highest block time within the range
+        int64_t min_time;
+        int64_t max_time;
+    };
+
+    struct Entry {
+        int height;
+        int64_t time;
+        uint32_t bits;
+        arith_uint256 chain_work;
+        //! Range from the previous entry's height (or height 0) up to this one
+        Range window;
+    };
+
+    ChainStats();
+
+    /** Bring the statistics in line with chain. */
+    void Update(const CChain& chain) EXCLUSIVE_LOCKS_REQUIRED(::cs_main, !m_mutex);
+
+    /** Height of the last block recorded, -1 if none. */
+    int Height() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Statistics over heights [first, last], or nullopt if they are not all recorded. */
+    std::optional<Range> GetRange(int first, int last) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Entries at heights last, last - step, ... down to first, in increasing height order. */
+    std::vector<Entry> GetEntries(int first, int last, int step) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    using MinMax = std::pair<int64_t, int64_t>;
+
+    /** Recompute the last node of each level above the block times after they grew or shrank by one. */
+    void UpdateTail() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    Range GetRangeInternal(size_t first, size_t last) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    std::vector<uint256> m_hashes GUARDED_BY(m_mutex);
+    std::vector<arith_uint256> m_work GUARDED_BY(m_mutex);
+    std::vector<uint32_t> m_bits GUARDED_BY(m_mutex);
+    //! m_times[k][i] holds the time range of heights [i << k, (i + 1) << k)
+    std::vector<std::vector<MinMax>> m_times GUARDED_BY(m_mutex);
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_CHAINSTATS_H
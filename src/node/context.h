@@ -40,6 +40,7 @@ class SignalInterrupt;
 
 namespace node {
 class KernelNotifications;
+class StratumServer;
 class Warnings;
 
 //! NodeContext struct containing references to chain state and connection
@@ -76,6 +77,8 @@ struct NodeContext {
     //! Reference to chain client that should used to load or create wallets
     //! opened by the gui.
     std::unique_ptr<interfaces::Mining> mining;
+    //! Optional Stratum work server for local miners, started with -stratum.
+    std::unique_ptr<StratumServer> stratum;
     interfaces::WalletLoader* wallet_loader{nullptr};
     std::unique_ptr<CScheduler> scheduler;
     std::function<void()> rpc_interruption_point = [] {};
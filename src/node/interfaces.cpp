@@ -867,6 +867,11 @@ class MinerImpl : public Mining
 {
 public:
     explicit MinerImpl(NodeContext& node) : m_node(node) {}
+    ~MinerImpl()
+    {
+        LOCK(m_assembler_mutex);
+        if (m_assembler && m_node.validation_signals) m_node.validation_signals->UnregisterSharedValidationInterface(m_assembler);
+    }
 
     bool isTestChain() override
     {
@@ -913,12 +918,33 @@ public:
     {
         BlockAssembler::Options assemble_options{options};
         ApplyArgsManOptions(*Assert(m_node.args), assemble_options);
+        if (auto assembler{incrementalAssembler(assemble_options)}) return assembler->CreateNewBlock(script_pub_key);
         return BlockAssembler{chainman().ActiveChainstate(), context()->mempool.get(), assemble_options}.CreateNewBlock(script_pub_key);
     }
 
+    //! Templates with mempool transactions and the default coinbase reservation
+    //! are updated incrementally from mempool notifications.
+    std::shared_ptr<IncrementalBlockAssembler> incrementalAssembler(const BlockAssembler::Options& options) EXCLUSIVE_LOCKS_REQUIRED(!m_assembler_mutex)
+    {
+        const BlockCreateOptions defaults;
+        if (!options.use_mempool || !m_node.mempool || !m_node.validation_signals ||
+            options.coinbase_max_additional_weight != defaults.coinbase_max_additional_weight ||
+            options.coinbase_output_max_additional_sigops != defaults.coinbase_output_max_additional_sigops) {
+            return nullptr;
+        }
+        LOCK(m_assembler_mutex);
+        if (!m_assembler) {
+            m_assembler = std::make_shared<IncrementalBlockAssembler>(chainman(), *m_node.mempool, options);
+            m_node.validation_signals->RegisterSharedValidationInterface(m_assembler);
+        }
+        return m_assembler;
+    }
+
     NodeContext* context() override { return &m_node; }
     ChainstateManager& chainman() { return *Assert(m_node.chainman); }
     NodeContext& m_node;
+    Mutex m_assembler_mutex;
+    std::shared_ptr<IncrementalBlockAssembler> m_assembler GUARDED_BY(m_assembler_mutex);
 };
 } // namespace
 } // namespace node
@@ -7,6 +7,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <checkqueue.h>
 #include <coins.h>
 #include <common/args.h>
 #include <consensus/amount.h>
@@ -21,12 +22,17 @@
 #include <pow.h>
 #include <primitives/transaction.h>
 #include <util/moneystr.h>
+#include <util/signalinterrupt.h>
 #include <util/strencodings.h>
 #include <util/time.h>
 #include <validation.h>
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
 #include <utility>
+#include <vector>
 
 namespace node {
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
@@ -66,6 +72,111 @@ void RegenerateCommitments(CBlock& block, ChainstateManager& chainman)
     block.hashMerkleRoot = BlockMerkleRoot(block);
 }
 
+namespace {
+/** A run of consecutive search positions for one worker, all under the same extranonce. */
+struct SolveRange {
+    CBlockHeader header;
+    uint64_t begin;
+    uint64_t end;
+    std::atomic<uint64_t>* best;
+    const Consensus::Params* params;
+    const util::SignalInterrupt* interrupt;
+
+    bool operator()()
+    {
+        // Stop once past the lowest solution found so far; lower ranges keep going
+        for (uint64_t pos = begin; pos < end && pos < best->load(std::memory_order_relaxed) && !*interrupt; ++pos) {
+            header.nNonce = static_cast<uint32_t>(pos);
+            if (CheckProofOfWork(header.ComputePoWHash(), header.nBits, *params)) {
+                uint64_t current{best->load()};
+                while (pos < current && !best->compare_exchange_weak(current, pos)) {}
+                break;
+            }
+        }
+        return true;
+    }
+};
+
+//! Search positions handed to a worker at a time
+constexpr uint64_t SOLVE_RANGE_SIZE{4096};
+//! Ranges queued per worker before waiting for them to finish
+constexpr int SOLVE_RANGES_PER_WORKER{4};
+
+GlobalMutex g_solve_mutex;
+//! Kept across calls, so workers (and the Flex scratchpad each one allocates) are reused
+std::unique_ptr<CCheckQueue<SolveRange>> g_solve_queue GUARDED_BY(g_solve_mutex);
+int g_solve_workers GUARDED_BY(g_solve_mutex){0};
+
+void SetExtraNonce(CBlock& block, const CScript& script_sig, uint32_t extranonce)
+{
+    CMutableTransaction coinbase{*block.vtx.at(0)};
+    coinbase.vin.at(0).scriptSig = script_sig;
+    if (extranonce > 0) coinbase.vin[0].scriptSig << CScriptNum{extranonce};
+    block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+}
+
+/** Search with threads workers: the calling thread alone, or together with those of queue. */
+bool Solve(CBlock& block, const Consensus::Params& params, uint64_t& max_tries, int threads, CCheckQueue<SolveRange>* queue, const util::SignalInterrupt& interrupt)
+{
+    // A search position is the extranonce in the upper 32 bits and the nonce in the lower
+    const uint64_t start{block.nNonce};
+    const uint64_t end{start + std::min(max_tries, std::numeric_limits<uint64_t>::max() - start)};
+    const CScript script_sig{block.vtx.at(0)->vin.at(0).scriptSig};
+    std::atomic<uint64_t> best{end};
+
+    uint64_t pos{start};
+    uint32_t extranonce{0};
+    CBlockHeader header{block.GetBlockHeader()};
+    while (pos < end && pos < best && !interrupt) {
+        std::vector<SolveRange> ranges;
+        while (ranges.size() < size_t(threads * SOLVE_RANGES_PER_WORKER) && pos < end) {
+            if (pos >> 32 != extranonce) {
+                extranonce = pos >> 32;
+                SetExtraNonce(block, script_sig, extranonce);
+                header = block.GetBlockHeader();
+            }
+            // Ranges never cross into the next extranonce
+            const uint64_t size{std::min({SOLVE_RANGE_SIZE, (uint64_t{1} << 32) - (pos & 0xffffffff), end - pos})};
+            ranges.push_back({header, pos, pos + size, &best, &params, &interrupt});
+            pos += size;
+        }
+        if (queue) {
+            // The queue hands out ranges from the back, so put the lowest positions there
+            std::reverse(ranges.begin(), ranges.end());
+            queue->Add(std::move(ranges));
+            queue->Wait();
+        } else {
+            for (auto& range : ranges) range();
+        }
+    }
+
+    if (interrupt) return false;
+    if (best == end) {
+        max_tries = 0;
+        return false;
+    }
+    if (best >> 32 != extranonce) SetExtraNonce(block, script_sig, best >> 32);
+    block.nNonce = static_cast<uint32_t>(best);
+    max_tries -= best - start;
+    return true;
+}
+} // namespace
+
+bool SolveBlock(CBlock& block, const Consensus::Params& params, uint64_t& max_tries, int threads, const util::SignalInterrupt& interrupt)
+{
+    if (threads <= 1) return Solve(block, params, max_tries, /*threads=*/1, /*queue=*/nullptr, interrupt);
+
+    LOCK(g_solve_mutex);
+    if (g_solve_workers != threads - 1) {
+        // Join the old workers before starting the new ones
+        g_solve_queue.reset();
+        g_solve_queue = std::make_unique<CCheckQueue<SolveRange>>(/*batch_size=*/1, threads - 1, "solveblk");
+        g_solve_workers = threads - 1;
+    }
+    return Solve(block, params, max_tries, threads, g_solve_queue.get(), interrupt);
+}
+
 static BlockAssembler::Options ClampOptions(BlockAssembler::Options options)
 {
     Assert(options.coinbase_max_additional_weight <= DEFAULT_BLOCK_MAX_WEIGHT);
@@ -154,6 +265,152 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     m_last_block_num_txs = nBlockTx;
     m_last_block_weight = nBlockWeight;
+
+    pblock->vtx[0] = CreateCoinbase(scriptPubKeyIn);
+    pblocktemplate->vchCoinbaseCommitment = m_chainstate.m_chainman.GenerateCoinbaseCommitment(*pblock, pindexPrev);
+    pblocktemplate->vTxFees[0] = -nFees;
+
+    LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
+
+    // Fill in header
+    pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
+    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+    pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
+    pblock->nNonce         = 0;
+    pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
+
+    BlockValidationState state;
+    if (m_options.test_block_validity && !TestBlockValidity(state, chainparams, m_chainstate, *pblock, pindexPrev,
+                                                            /*fCheckPOW=*/false, /*fCheckMerkleRoot=*/false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, state.ToString()));
+    }
+    const auto time_2{SteadyClock::now()};
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n",
+             Ticks<MillisecondsDouble>(time_1 - time_start), nPackagesSelected, nDescendantsUpdated,
+             Ticks<MillisecondsDouble>(time_2 - time_1),
+             Ticks<MillisecondsDouble>(time_2 - time_start));
+
+    return std::move(pblocktemplate);
+}
+
+static std::vector<uint256> TxidLeaves(const CBlock& block)
+{
+    std::vector<uint256> leaves(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) leaves[i] = block.vtx[i]->GetHash().ToUint256();
+    return leaves;
+}
+
+static std::vector<uint256> WitnessLeaves(const CBlock& block)
+{
+    // The witness hash of the coinbase is 0
+    std::vector<uint256> leaves(block.vtx.size());
+    for (size_t i = 1; i < block.vtx.size(); ++i) leaves[i] = block.vtx[i]->GetWitnessHash().ToUint256();
+    return leaves;
+}
+
+std::unique_ptr<CBlockTemplate> BlockAssembler::UpdateBlock(const CBlockTemplate& previous,
+                                                            const std::vector<Txid>& added,
+                                                            const std::unordered_set<Txid, SaltedTxidHasher>& removed,
+                                                            const CScript& scriptPubKeyIn,
+                                                            MerkleTree& witness_tree)
+{
+    const auto time_start{SteadyClock::now()};
+    if (!m_mempool) return nullptr;
+
+    LOCK(::cs_main);
+    CBlockIndex* pindexPrev = m_chainstate.m_chain.Tip();
+    if (!pindexPrev || pindexPrev->GetBlockHash() != previous.block.hashPrevBlock) return nullptr;
+    nHeight = pindexPrev->nHeight + 1;
+    m_lock_time_cutoff = pindexPrev->GetMedianTimePast();
+
+    resetBlock();
+    pblocktemplate = std::make_unique<CBlockTemplate>();
+    CBlock* const pblock = &pblocktemplate->block; // pointer for convenience
+    pblock->nVersion = previous.block.nVersion;
+    pblock->vtx.reserve(previous.block.vtx.size() + added.size());
+    pblock->vtx.emplace_back();
+    pblocktemplate->vTxFees.push_back(-1); // updated at end
+    pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
+
+    // Keep the previous transactions, except removed ones and those spending them
+    std::unordered_set<Txid, SaltedTxidHasher> dropped;
+    const auto is_dropped = [&](const Txid& txid) { return removed.count(txid) || dropped.count(txid); };
+    for (size_t i = 1; i < previous.block.vtx.size(); ++i) {
+        const CTransactionRef& tx = previous.block.vtx[i];
+        bool drop = is_dropped(tx->GetHash());
+        for (size_t j = 0; !drop && j < tx->vin.size(); ++j) {
+            drop = is_dropped(tx->vin[j].prevout.hash);
+        }
+        if (drop) {
+            dropped.insert(tx->GetHash());
+            continue;
+        }
+        pblock->vtx.push_back(tx);
+        pblocktemplate->vTxFees.push_back(previous.vTxFees[i]);
+        pblocktemplate->vTxSigOpsCost.push_back(previous.vTxSigOpsCost[i]);
+        nBlockWeight += GetTransactionWeight(*tx);
+        ++nBlockTx;
+        nBlockSigOpsCost += previous.vTxSigOpsCost[i];
+        nFees += previous.vTxFees[i];
+        inBlock.insert(tx->GetHash());
+    }
+
+    // Append each added transaction with its ancestors not in the block yet
+    int nPackagesSelected = 0;
+    {
+        LOCK(m_mempool->cs);
+        for (const Txid& txid : added) {
+            if (inBlock.count(txid)) continue;
+            const auto iter{m_mempool->GetIter(txid.ToUint256())};
+            if (!iter) continue; // removed again since
+            auto ancestors{m_mempool->AssumeCalculateMemPoolAncestors(__func__, **iter, CTxMemPool::Limits::NoLimits(), /*fSearchForParents=*/false)};
+            onlyUnconfirmed(ancestors);
+            ancestors.insert(*iter);
+
+            uint64_t packageSize = 0;
+            CAmount packageFees = 0;
+            int64_t packageSigOpsCost = 0;
+            for (const auto& entry : ancestors) {
+                packageSize += entry->GetTxSize();
+                packageFees += entry->GetModifiedFee();
+                packageSigOpsCost += entry->GetSigOpCost();
+            }
+            if (packageFees < m_options.blockMinFeeRate.GetFee(packageSize)) continue;
+            // A full block may have to give up other transactions for this package
+            if (!TestPackage(packageSize, packageSigOpsCost)) return nullptr;
+            if (!TestPackageTransactions(ancestors)) continue;
+
+            std::vector<CTxMemPool::txiter> sortedEntries;
+            SortForBlock(ancestors, sortedEntries);
+            for (const auto& entry : sortedEntries) AddToBlock(entry);
+            ++nPackagesSelected;
+        }
+    }
+
+    m_last_block_num_txs = nBlockTx;
+    m_last_block_weight = nBlockWeight;
+
+    pblock->vtx[0] = CreateCoinbase(scriptPubKeyIn);
+    pblocktemplate->vchCoinbaseCommitment = m_chainstate.m_chainman.GenerateCoinbaseCommitment(*pblock, pindexPrev, witness_tree.Update(WitnessLeaves(*pblock)));
+    pblocktemplate->vTxFees[0] = -nFees;
+
+    pblock->hashPrevBlock = pindexPrev->GetBlockHash();
+    pblock->nTime = TicksSinceEpoch<std::chrono::seconds>(NodeClock::now());
+    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+    pblock->nBits = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
+    pblock->nNonce = 0;
+    pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
+
+    LogPrint(BCLog::BENCH, "UpdateBlock() %u txs, %d packages added, %u dropped: %.3fms\n",
+             nBlockTx, nPackagesSelected, dropped.size(), Ticks<MillisecondsDouble>(SteadyClock::now() - time_start));
+
+    return std::move(pblocktemplate);
+}
+
+CTransactionRef BlockAssembler::CreateCoinbase(const CScript& scriptPubKeyIn) const
+{
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
     CAmount blockreward = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
 
     // Create coinbase transaction.
@@ -181,32 +438,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 		coinbaseTx.vout[1].nValue = blockreward * 0.1;
 	}
     coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
-    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
-    pblocktemplate->vchCoinbaseCommitment = m_chainstate.m_chainman.GenerateCoinbaseCommitment(*pblock, pindexPrev);
-    pblocktemplate->vTxFees[0] = -nFees;
-
-    LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
-
-    // Fill in header
-    pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
-    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
-    pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
-    pblock->nNonce         = 0;
-    pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
-
-    BlockValidationState state;
-    if (m_options.test_block_validity && !TestBlockValidity(state, chainparams, m_chainstate, *pblock, pindexPrev,
-                                                            /*fCheckPOW=*/false, /*fCheckMerkleRoot=*/false)) {
-        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, state.ToString()));
-    }
-    const auto time_2{SteadyClock::now()};
-
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n",
-             Ticks<MillisecondsDouble>(time_1 - time_start), nPackagesSelected, nDescendantsUpdated,
-             Ticks<MillisecondsDouble>(time_2 - time_1),
-             Ticks<MillisecondsDouble>(time_2 - time_start));
-
-    return std::move(pblocktemplate);
+    return MakeTransactionRef(std::move(coinbaseTx));
 }
 
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
@@ -452,4 +684,66 @@ void BlockAssembler::addPackageTxs(const CTxMemPool& mempool, int& nPackagesSele
         nDescendantsUpdated += UpdatePackagesForAdded(mempool, ancestors, mapModifiedTx);
     }
 }
+
+//! Stop recording mempool changes past this many; the next template is then built from scratch.
+static constexpr size_t MAX_TEMPLATE_DELTAS{10000};
+
+IncrementalBlockAssembler::IncrementalBlockAssembler(ChainstateManager& chainman, const CTxMemPool& mempool, const BlockAssembler::Options& options)
+    : m_chainman{chainman}, m_mempool{mempool}, m_options{options}
+{
+}
+
+std::unique_ptr<CBlockTemplate> IncrementalBlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+{
+    // Holding the mempool lock means no notification can be generated while we
+    // check whether all the ones for the previous template have arrived.
+    LOCK2(::cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    std::vector<Txid> added;
+    std::unordered_set<Txid, SaltedTxidHasher> removed;
+    bool complete;
+    {
+        LOCK(m_delta_mutex);
+        const uint64_t sequence{m_mempool.GetSequence()};
+        complete = m_events == sequence - m_base_sequence;
+        added.swap(m_added);
+        removed.insert(m_removed.begin(), m_removed.end());
+        m_removed.clear();
+        m_base_sequence = sequence;
+        m_events = 0;
+    }
+
+    // Forget the previous template until the new one is built, in case that throws
+    const auto previous{std::move(m_template)};
+    BlockAssembler assembler{m_chainman.ActiveChainstate(), &m_mempool, m_options};
+    std::unique_ptr<CBlockTemplate> block_template;
+    if (complete && previous && m_script == scriptPubKeyIn) {
+        block_template = assembler.UpdateBlock(*previous, added, removed, scriptPubKeyIn, m_witness_tree);
+    }
+    if (!block_template) {
+        block_template = assembler.CreateNewBlock(scriptPubKeyIn);
+        m_witness_tree.Update(WitnessLeaves(block_template->block));
+    }
+    block_template->block.hashMerkleRoot = m_tx_tree.Update(TxidLeaves(block_template->block));
+    block_template->coinbase_merkle_path = m_tx_tree.Path(0);
+    m_template = std::make_unique<CBlockTemplate>(*block_template);
+    m_script = scriptPubKeyIn;
+    return block_template;
+}
+
+void IncrementalBlockAssembler::TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence)
+{
+    LOCK(m_delta_mutex);
+    if (mempool_sequence < m_base_sequence || m_added.size() + m_removed.size() >= MAX_TEMPLATE_DELTAS) return;
+    m_added.push_back(tx.info.m_tx->GetHash());
+    ++m_events;
+}
+
+void IncrementalBlockAssembler::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    LOCK(m_delta_mutex);
+    if (mempool_sequence < m_base_sequence || m_added.size() + m_removed.size() >= MAX_TEMPLATE_DELTAS) return;
+    m_removed.insert(tx->GetHash());
+    ++m_events;
+}
 } // namespace node
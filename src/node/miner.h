@@ -6,14 +6,19 @@
 #ifndef BITCOIN_NODE_MINER_H
 #define BITCOIN_NODE_MINER_H
 
+#include <consensus/merkle.h>
 #include <node/types.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <memory>
 #include <optional>
 #include <stdint.h>
+#include <unordered_set>
+#include <vector>
 
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/indexed_by.hpp>
@@ -29,6 +34,9 @@ class Chainstate;
 class ChainstateManager;
 
 namespace Consensus { struct Params; };
+namespace util {
+class SignalInterrupt;
+} // namespace util
 
 namespace node {
 static const bool DEFAULT_PRINT_MODIFIED_FEE = false;
@@ -39,6 +47,8 @@ struct CBlockTemplate
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOpsCost;
     std::vector<unsigned char> vchCoinbaseCommitment;
+    //! Merkle path of the coinbase, set when the assembler already has the tree
+    std::optional<std::vector<uint256>> coinbase_merkle_path;
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -172,6 +182,24 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
 
+    /**
+     * Bring a template from CreateNewBlock on the current tip up to date with
+     * mempool changes: drop removed transactions together with anything in the
+     * block spending them, then append the packages of added transactions that
+     * pay at least blockMinFeeRate. The kept transactions are not revalidated
+     * and TestBlockValidity is skipped. witness_tree must hold the witness
+     * leaves of previous and is updated for the new block.
+     *
+     * Returns nullptr if the tip changed or an added package does not fit in
+     * the remaining space, as a full CreateNewBlock may then select a
+     * different set of transactions.
+     */
+    std::unique_ptr<CBlockTemplate> UpdateBlock(const CBlockTemplate& previous,
+                                                const std::vector<Txid>& added,
+                                                const std::unordered_set<Txid, SaltedTxidHasher>& removed,
+                                                const CScript& scriptPubKeyIn,
+                                                MerkleTree& witness_tree);
+
     inline static std::optional<int64_t> m_last_block_num_txs{};
     inline static std::optional<int64_t> m_last_block_weight{};
 
@@ -183,6 +211,8 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Create the coinbase paying the subsidy and collected fees to scriptPubKeyIn */
+    CTransactionRef CreateCoinbase(const CScript& scriptPubKeyIn) const;
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -204,6 +234,50 @@ private:
     void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
 };
 
+/**
+ * Keeps the last block template and updates it from mempool notifications
+ * instead of selecting from the whole mempool again. Each template is built
+ * with BlockAssembler::UpdateBlock from the transactions added and removed
+ * since the previous one, and the merkle roots are updated incrementally.
+ * A full CreateNewBlock is done for a new tip, another coinbase script, or
+ * when notifications have not caught up with the mempool yet.
+ */
+class IncrementalBlockAssembler final : public CValidationInterface
+{
+public:
+    IncrementalBlockAssembler(ChainstateManager& chainman, const CTxMemPool& mempool, const BlockAssembler::Options& options);
+
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex, !m_delta_mutex);
+
+    const BlockAssembler::Options& GetOptions() const { return m_options; }
+
+protected:
+    void TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_delta_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_delta_mutex);
+
+private:
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    const BlockAssembler::Options m_options;
+
+    Mutex m_mutex;
+    std::unique_ptr<CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    CScript m_script GUARDED_BY(m_mutex);
+    MerkleTree m_tx_tree GUARDED_BY(m_mutex);
+    MerkleTree m_witness_tree GUARDED_BY(m_mutex);
+
+    Mutex m_delta_mutex;
+    //! Mempool sequence the last template was built at; earlier notifications are ignored.
+    uint64_t m_base_sequence GUARDED_BY(m_delta_mutex){0};
+    //! Notifications recorded since, to tell whether any are still queued.
+    uint64_t m_events GUARDED_BY(m_delta_mutex){0};
+    std::vector<Txid> m_added GUARDED_BY(m_delta_mutex);
+    std::unordered_set<Txid, SaltedTxidHasher> m_removed GUARDED_BY(m_delta_mutex);
+};
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
@@ -211,6 +285,23 @@ void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
 
 /** Apply -blockmintxfee and -blockmaxweight options from ArgsManager to BlockAssembler options. */
 void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& options);
+
+/**
+ * Grind the nonce of block until its proof of work is valid, trying at most
+ * max_tries nonces starting from the current one. Once the nonces run out, an
+ * extranonce is appended to the coinbase scriptSig and the nonces start over,
+ * so the search is not limited to 2^32 tries. The (extranonce, nonce) space is
+ * split into ranges handed to threads workers; workers beyond the calling
+ * thread are kept in a pool reused by later calls. The first valid position
+ * wins, so the result does not depend on the number of threads. Hashes are
+ * computed directly and never enter the PoW cache.
+ *
+ * On return max_tries has been reduced by the tries consumed. Returns false
+ * if max_tries ran out or interrupt was raised first, and true once the block
+ * has a valid nonce, with its coinbase and merkle root updated if an
+ * extranonce was needed.
+ */
+bool SolveBlock(CBlock& block, const Consensus::Params& params, uint64_t& max_tries, int threads, const util::SignalInterrupt& interrupt);
 } // namespace node
 
 #endif // BITCOIN_NODE_MINER_H
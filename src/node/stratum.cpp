@@ -0,0 +1,404 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/stratum.h>
+
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <crypto/common.h>
+#include <hash.h>
+#include <interfaces/mining.h>
+#include <logging.h>
+#include <netbase.h>
+#include <node/miner.h>
+#include <pow.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <serialize.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <univalue.h>
+#include <util/check.h>
+#include <util/sock.h>
+#include <util/strencodings.h>
+#include <util/thread.h>
+#include <util/translation.h>
+
+#include <algorithm>
+#include <optional>
+
+namespace node {
+
+//! Keep a few jobs for the same tip, for miners still working on an older one.
+static constexpr size_t MAX_STRATUM_JOBS{8};
+static constexpr size_t MAX_STRATUM_CLIENTS{64};
+//! Longest request line accepted, and most unsent data kept for a slow client.
+static constexpr size_t MAX_STRATUM_LINE{16 * 1024};
+static constexpr size_t MAX_STRATUM_SEND_BUFFER{1024 * 1024};
+static constexpr auto STRATUM_POLL_INTERVAL{std::chrono::milliseconds{100}};
+
+// Error codes used by Stratum v1 pools
+static constexpr int STRATUM_ERROR_OTHER{20};
+static constexpr int STRATUM_ERROR_JOB_NOT_FOUND{21};
+static constexpr int STRATUM_ERROR_DUPLICATE{22};
+static constexpr int STRATUM_ERROR_LOW_DIFFICULTY{23};
+static constexpr int STRATUM_ERROR_NOT_SUBSCRIBED{25};
+
+struct StratumServer::Client {
+    std::shared_ptr<Sock> sock;
+    std::string address;
+    std::string recv_buffer;
+    std::string send_buffer;
+    std::vector<unsigned char> extranonce1;
+    bool subscribed{false};
+    bool disconnect{false};
+};
+
+StratumJob MakeStratumJob(std::string id, CBlock block, std::optional<std::vector<uint256>> merkle_branch)
+{
+    StratumJob job;
+    job.id = std::move(id);
+
+    // Keep the BIP34 height and replace the rest of the scriptSig with a zeroed extra nonce
+    CMutableTransaction coinbase{*Assert(block.vtx.at(0))};
+    CScript& script_sig{coinbase.vin.at(0).scriptSig};
+    CScript::const_iterator pc{script_sig.begin()};
+    opcodetype opcode;
+    script_sig.GetOp(pc, opcode);
+    script_sig = CScript{script_sig.begin(), pc} << std::vector<unsigned char>(STRATUM_EXTRANONCE_SIZE);
+    block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+
+    DataStream stream;
+    stream << TX_NO_WITNESS(*block.vtx[0]);
+    // nVersion, one input, its prevout, then the scriptSig with the extra nonce at its end
+    const size_t script_sig_size{block.vtx[0]->vin[0].scriptSig.size()};
+    const size_t split{4 + 1 + 36 + GetSizeOfCompactSize(script_sig_size) + script_sig_size - STRATUM_EXTRANONCE_SIZE};
+    const auto bytes{MakeUCharSpan(stream)};
+    job.coinb1.assign(bytes.begin(), bytes.begin() + split);
+    job.coinb2.assign(bytes.begin() + split + STRATUM_EXTRANONCE_SIZE, bytes.end());
+
+    // The branch does not include the coinbase, so rewriting its scriptSig leaves it unchanged
+    job.merkle_branch = merkle_branch ? std::move(*merkle_branch) : TransactionMerklePath(block, 0);
+    job.block = std::move(block);
+    return job;
+}
+
+CBlock AssembleStratumBlock(const StratumJob& job, Span<const unsigned char> extranonce, uint32_t time, uint32_t nonce)
+{
+    Assume(extranonce.size() == STRATUM_EXTRANONCE_SIZE);
+    CBlock block{job.block};
+    CMutableTransaction coinbase{*block.vtx[0]};
+    CScript& script_sig{coinbase.vin[0].scriptSig};
+    std::copy(extranonce.begin(), extranonce.end(), script_sig.end() - STRATUM_EXTRANONCE_SIZE);
+    block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+
+    uint256 root{block.vtx[0]->GetHash()};
+    for (const uint256& hash : job.merkle_branch) root = Hash(root, hash);
+    block.hashMerkleRoot = root;
+    block.nTime = time;
+    block.nNonce = nonce;
+    return block;
+}
+
+static std::string HexNumber(uint32_t value)
+{
+    return strprintf("%08x", value);
+}
+
+static std::optional<uint32_t> ParseHexNumber(const UniValue& value)
+{
+    if (!value.isStr() || value.get_str().size() != 8 || !IsHex(value.get_str())) return std::nullopt;
+    return ReadBE32(ParseHex(value.get_str()).data());
+}
+
+static UniValue StratumError(int code, const std::string& message)
+{
+    UniValue error{UniValue::VARR};
+    error.push_back(code);
+    error.push_back(message);
+    error.push_back(NullUniValue);
+    return error;
+}
+
+StratumServer::StratumServer(interfaces::Mining& mining, StratumOptions options)
+    : m_mining{mining}, m_options{std::move(options)}, m_next_extranonce1{FastRandomContext{}.rand32()} {}
+
+StratumServer::~StratumServer()
+{
+    Stop();
+}
+
+bool StratumServer::Start(bilingual_str& error)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!m_options.bind.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+        error = strprintf(Untranslated("Bind address family for %s not supported"), m_options.bind.ToStringAddrPort());
+        return false;
+    }
+    std::unique_ptr<Sock> sock = CreateSock(m_options.bind.GetSAFamily(), SOCK_STREAM, IPPROTO_TCP);
+    if (!sock) {
+        error = strprintf(Untranslated("Couldn't open socket for stratum connections (socket returned error %s)"), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    int one = 1;
+    if (sock->SetSockOpt(SOL_SOCKET, SO_REUSEADDR, (sockopt_arg_type)&one, sizeof(int)) == SOCKET_ERROR) {
+        LogPrintf("Stratum: error setting SO_REUSEADDR on socket: %s, continuing anyway\n", NetworkErrorString(WSAGetLastError()));
+    }
+    if (sock->Bind(reinterpret_cast<struct sockaddr*>(&sockaddr), len) == SOCKET_ERROR) {
+        error = strprintf(_("Unable to bind stratum server to %s (bind returned error %s)"), m_options.bind.ToStringAddrPort(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    if (sock->Listen(SOMAXCONN) == SOCKET_ERROR || !sock->SetNonBlocking()) {
+        error = strprintf(_("Listening for stratum connections failed (listen returned error %s)"), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    m_listen_sock = std::move(sock);
+    LogPrintf("Stratum server listening on %s\n", CService{m_options.bind, GetPort()}.ToStringAddrPort());
+
+    m_interrupt.reset();
+    m_thread = std::thread(&util::TraceThread, "stratum", [this] { ThreadServe(); });
+    return true;
+}
+
+void StratumServer::Interrupt()
+{
+    m_interrupt();
+}
+
+void StratumServer::Stop()
+{
+    Interrupt();
+    if (m_thread.joinable()) m_thread.join();
+    m_clients.clear();
+    m_listen_sock.reset();
+}
+
+uint16_t StratumServer::GetPort() const
+{
+    if (!m_listen_sock) return 0;
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    CService addr;
+    if (m_listen_sock->GetSockName((struct sockaddr*)&sockaddr, &len) != 0 || !addr.SetSockAddr((const struct sockaddr*)&sockaddr)) return 0;
+    return addr.GetPort();
+}
+
+void StratumServer::ThreadServe()
+{
+    while (!m_interrupt) {
+        UpdateJob();
+
+        Sock::EventsPerSock events;
+        events.emplace(m_listen_sock, Sock::Events{Sock::RECV});
+        for (const auto& client : m_clients) {
+            events.emplace(client->sock, Sock::Events{client->send_buffer.empty() ? Sock::RECV : Sock::Event(Sock::RECV | Sock::SEND)});
+        }
+        if (!m_listen_sock->WaitMany(STRATUM_POLL_INTERVAL, events)) {
+            m_interrupt.sleep_for(STRATUM_POLL_INTERVAL);
+            continue;
+        }
+
+        if (events.at(m_listen_sock).occurred & Sock::RECV) AcceptClient();
+        for (const auto& client : m_clients) {
+            const auto it{events.find(client->sock)};
+            if (it == events.end() || it->second.occurred == 0) continue;
+            if (it->second.occurred & (Sock::RECV | Sock::ERR)) {
+                char buf[4096];
+                const ssize_t n{client->sock->Recv(buf, sizeof(buf), 0)};
+                if (n <= 0) {
+                    const int err{WSAGetLastError()};
+                    if (n == 0 || (err != WSAEWOULDBLOCK && err != WSAEINTR && err != WSAEINPROGRESS)) client->disconnect = true;
+                    continue;
+                }
+                client->recv_buffer.append(buf, n);
+                size_t start{0}, end;
+                while (!client->disconnect && (end = client->recv_buffer.find('\n', start)) != std::string::npos) {
+                    HandleRequest(*client, client->recv_buffer.substr(start, end - start));
+                    start = end + 1;
+                }
+                client->recv_buffer.erase(0, start);
+                if (client->recv_buffer.size() > MAX_STRATUM_LINE) client->disconnect = true;
+            }
+            Flush(*client);
+        }
+
+        std::erase_if(m_clients, [](const auto& client) {
+            if (client->disconnect) LogDebug(BCLog::NET, "Stratum: disconnecting %s\n", client->address);
+            return client->disconnect;
+        });
+    }
+}
+
+void StratumServer::AcceptClient()
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    std::unique_ptr<Sock> sock{m_listen_sock->Accept((struct sockaddr*)&sockaddr, &len)};
+    if (!sock) return;
+    CService addr;
+    addr.SetSockAddr((const struct sockaddr*)&sockaddr);
+    if (m_clients.size() >= MAX_STRATUM_CLIENTS || !sock->SetNonBlocking()) {
+        LogDebug(BCLog::NET, "Stratum: dropping connection from %s\n", addr.ToStringAddrPort());
+        return;
+    }
+    auto client{std::make_unique<Client>()};
+    client->sock = std::move(sock);
+    client->address = addr.ToStringAddrPort();
+    client->extranonce1.resize(STRATUM_EXTRANONCE1_SIZE);
+    WriteBE32(client->extranonce1.data(), m_next_extranonce1++);
+    LogDebug(BCLog::NET, "Stratum: accepted connection from %s\n", client->address);
+    m_clients.push_back(std::move(client));
+}
+
+void StratumServer::UpdateJob()
+{
+    if (!m_mining.isTestChain() && m_mining.isInitialBlockDownload()) return;
+    const auto tip{m_mining.getTipHash()};
+    if (!tip) return;
+    const bool new_tip{*tip != m_job_tip};
+    if (!new_tip) {
+        if (std::chrono::steady_clock::now() < m_next_job) return;
+        if (m_mining.getTransactionsUpdated() == m_job_transactions_updated) return;
+    }
+
+    // Read the counter first, so that changes while assembling cause another job
+    m_job_transactions_updated = m_mining.getTransactionsUpdated();
+    const auto block_template{m_mining.createNewBlock(m_options.coinbase_script)};
+    if (!block_template) return;
+    m_next_job = std::chrono::steady_clock::now() + m_options.job_interval;
+
+    const bool clean{block_template->block.hashPrevBlock != m_job_tip};
+    m_job_tip = block_template->block.hashPrevBlock;
+    if (clean) m_jobs.clear();
+    m_jobs.push_back(MakeStratumJob(strprintf("%x", ++m_job_count), std::move(block_template->block), std::move(block_template->coinbase_merkle_path)));
+    if (m_jobs.size() > MAX_STRATUM_JOBS) m_jobs.pop_front();
+
+    const StratumJob& job{m_jobs.back()};
+    LogDebug(BCLog::NET, "Stratum: job %s with %u transactions%s\n", job.id, job.block.vtx.size(), clean ? " on a new tip" : "");
+    for (const auto& client : m_clients) {
+        if (client->subscribed) SendJob(*client, job, clean);
+    }
+}
+
+void StratumServer::HandleRequest(Client& client, const std::string& line)
+{
+    if (line.find_first_not_of(" \t\r") == std::string::npos) return;
+    UniValue request;
+    if (!request.read(line) || !request.isObject()) {
+        client.disconnect = true;
+        return;
+    }
+    const UniValue& method{request.find_value("method")};
+    const UniValue& params{request.find_value("params")};
+
+    UniValue result{UniValue::VNULL};
+    UniValue error{UniValue::VNULL};
+    bool send_job{false};
+    if (!method.isStr() || !params.isArray()) {
+        error = StratumError(STRATUM_ERROR_OTHER, "Invalid request");
+    } else if (method.get_str() == "mining.subscribe") {
+        UniValue subscription{UniValue::VARR};
+        subscription.push_back("mining.notify");
+        subscription.push_back(HexStr(client.extranonce1));
+        UniValue subscriptions{UniValue::VARR};
+        subscriptions.push_back(std::move(subscription));
+        result.setArray();
+        result.push_back(std::move(subscriptions));
+        result.push_back(HexStr(client.extranonce1));
+        result.push_back(uint64_t{STRATUM_EXTRANONCE2_SIZE});
+        send_job = !client.subscribed;
+        client.subscribed = true;
+    } else if (method.get_str() == "mining.authorize") {
+        result = true;
+    } else if (method.get_str() == "mining.submit") {
+        result = Submit(client, params);
+        if (result.isArray()) {
+            error = std::move(result);
+            result.setNull();
+        }
+    } else {
+        error = StratumError(STRATUM_ERROR_OTHER, "Method not found");
+    }
+
+    UniValue reply{UniValue::VOBJ};
+    reply.pushKV("id", request.find_value("id"));
+    reply.pushKV("result", std::move(result));
+    reply.pushKV("error", std::move(error));
+    Send(client, reply);
+    if (send_job && !m_jobs.empty()) SendJob(client, m_jobs.back(), /*clean=*/true);
+}
+
+UniValue StratumServer::Submit(Client& client, const UniValue& params)
+{
+    if (!client.subscribed) return StratumError(STRATUM_ERROR_NOT_SUBSCRIBED, "Not subscribed");
+    if (params.size() < 5 || !params[1].isStr() || !params[2].isStr()) return StratumError(STRATUM_ERROR_OTHER, "Invalid parameters");
+
+    const auto job{std::find_if(m_jobs.begin(), m_jobs.end(), [&](const StratumJob& job) { return job.id == params[1].get_str(); })};
+    if (job == m_jobs.end()) return StratumError(STRATUM_ERROR_JOB_NOT_FOUND, "Job not found");
+
+    const auto time{ParseHexNumber(params[3])};
+    const auto nonce{ParseHexNumber(params[4])};
+    std::vector<unsigned char> extranonce{client.extranonce1};
+    const auto extranonce2{TryParseHex<unsigned char>(params[2].get_str())};
+    if (!time || !nonce || !extranonce2 || extranonce2->size() != STRATUM_EXTRANONCE2_SIZE) {
+        return StratumError(STRATUM_ERROR_OTHER, "Invalid parameters");
+    }
+    extranonce.insert(extranonce.end(), extranonce2->begin(), extranonce2->end());
+
+    const auto block{std::make_shared<const CBlock>(AssembleStratumBlock(*job, extranonce, *time, *nonce))};
+    if (!CheckProofOfWork(block->ComputePoWHash(), block->nBits, Params().GetConsensus())) {
+        return StratumError(STRATUM_ERROR_LOW_DIFFICULTY, "Low difficulty share");
+    }
+    const uint256 hash{block->GetHash()};
+    bool new_block{false};
+    if (!m_mining.processNewBlock(block, &new_block)) return StratumError(STRATUM_ERROR_OTHER, "Block rejected");
+    if (!new_block) return StratumError(STRATUM_ERROR_DUPLICATE, "Duplicate block");
+    if (m_mining.getTipHash() != hash) return StratumError(STRATUM_ERROR_OTHER, "Block not connected");
+    LogPrintf("Stratum: block %s found by %s (%s)\n", hash.ToString(), params[0].getValStr(), client.address);
+    return true;
+}
+
+void StratumServer::SendJob(Client& client, const StratumJob& job, bool clean)
+{
+    UniValue branch{UniValue::VARR};
+    for (const uint256& hash : job.merkle_branch) branch.push_back(HexStr(hash));
+
+    UniValue params{UniValue::VARR};
+    params.push_back(job.id);
+    params.push_back(HexStr(job.block.hashPrevBlock));
+    params.push_back(HexStr(job.coinb1));
+    params.push_back(HexStr(job.coinb2));
+    params.push_back(std::move(branch));
+    params.push_back(HexNumber(job.block.nVersion));
+    params.push_back(HexNumber(job.block.nBits));
+    params.push_back(HexNumber(job.block.nTime));
+    params.push_back(clean);
+
+    UniValue notify{UniValue::VOBJ};
+    notify.pushKV("id", NullUniValue);
+    notify.pushKV("method", "mining.notify");
+    notify.pushKV("params", std::move(params));
+    Send(client, notify);
+}
+
+void StratumServer::Send(Client& client, const UniValue& message)
+{
+    client.send_buffer += message.write() + "\n";
+    if (client.send_buffer.size() > MAX_STRATUM_SEND_BUFFER) client.disconnect = true;
+}
+
+void StratumServer::Flush(Client& client)
+{
+    if (client.send_buffer.empty() || client.disconnect) return;
+    const ssize_t n{client.sock->Send(client.send_buffer.data(), client.send_buffer.size(), MSG_NOSIGNAL)};
+    if (n < 0) {
+        const int err{WSAGetLastError()};
+        if (err != WSAEWOULDBLOCK && err != WSAEINTR && err != WSAEINPROGRESS) client.disconnect = true;
+        return;
+    }
+    client.send_buffer.erase(0, n);
+}
+
+} // namespace node
@@ -0,0 +1,132 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_STRATUM_H
+#define BITCOIN_NODE_STRATUM_H
+
+#include <netaddress.h>
+#include <primitives/block.h>
+#include <script/script.h>
+#include <span.h>
+#include <uint256.h>
+#include <util/threadinterrupt.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Sock;
+class UniValue;
+struct bilingual_str;
+namespace interfaces {
+class Mining;
+} // namespace interfaces
+
+namespace node {
+
+static constexpr bool DEFAULT_STRATUM_ENABLE{false};
+static constexpr uint16_t DEFAULT_STRATUM_PORT{3333};
+//! Minimum time between two jobs for the same tip, when only the mempool changed.
+static constexpr std::chrono::milliseconds DEFAULT_STRATUM_JOB_INTERVAL{5000};
+//! Bytes of coinbase extra nonce chosen by the server (per connection) and by the miner.
+static constexpr size_t STRATUM_EXTRANONCE1_SIZE{4};
+static constexpr size_t STRATUM_EXTRANONCE2_SIZE{4};
+static constexpr size_t STRATUM_EXTRANONCE_SIZE{STRATUM_EXTRANONCE1_SIZE + STRATUM_EXTRANONCE2_SIZE};
+
+/**
+ * A block template reduced to what a miner needs to roll its own headers: the
+ * coinbase serialization (without witness) split around the extra nonce, and
+ * the merkle branch linking the coinbase to the merkle root.
+ */
+struct StratumJob {
+    std::string id;
+    //! Template block. The coinbase scriptSig ends with a zeroed extra nonce.
+    CBlock block;
+    std::vector<unsigned char> coinb1;
+    std::vector<unsigned char> coinb2;
+    std::vector<uint256> merkle_branch;
+};
+
+/**
+ * Turn a template from BlockAssembler into a job. The merkle branch of the
+ * coinbase is computed from the block unless the assembler supplied it.
+ */
+StratumJob MakeStratumJob(std::string id, CBlock block, std::optional<std::vector<uint256>> merkle_branch = std::nullopt);
+
+/** Rebuild the block a miner solved for a job, given the full extra nonce and its header fields. */
+CBlock AssembleStratumBlock(const StratumJob& job, Span<const unsigned char> extranonce, uint32_t time, uint32_t nonce);
+
+struct StratumOptions {
+    CService bind;
+    //! Output paid by the coinbase of every job.
+    CScript coinbase_script;
+    std::chrono::milliseconds job_interval{DEFAULT_STRATUM_JOB_INTERVAL};
+};
+
+/**
+ * Work server speaking the Stratum v1 mining protocol to local miners, so they
+ * do not have to poll getblocktemplate and parse every transaction. Supports
+ * mining.subscribe, mining.authorize (any worker is accepted) and
+ * mining.submit, and pushes mining.notify with
+ * [job_id, prevhash, coinb1, coinb2, merkle_branch, version, nbits, ntime, clean_jobs].
+ *
+ * The previous block hash and branch hashes are sent in header byte order;
+ * version, nbits, ntime and the submitted nonce are big-endian hex numbers.
+ * A new tip sends a clean job. A mempool change on the same tip only changes
+ * the merkle branch and the coinbase outputs (coinb2), so miners can keep
+ * their extra nonce space.
+ *
+ * Submissions are checked against the block target only; there are no shares.
+ */
+class StratumServer
+{
+public:
+    StratumServer(interfaces::Mining& mining, StratumOptions options);
+    ~StratumServer();
+
+    /** Bind the listening socket and start the server thread. */
+    bool Start(bilingual_str& error);
+    void Interrupt();
+    void Stop();
+
+    /** Port actually bound, useful when binding to port 0. */
+    uint16_t GetPort() const;
+
+private:
+    struct Client;
+
+    void ThreadServe();
+    void UpdateJob();
+    void AcceptClient();
+    void HandleRequest(Client& client, const std::string& line);
+    UniValue Submit(Client& client, const UniValue& params);
+    void Send(Client& client, const UniValue& message);
+    void SendJob(Client& client, const StratumJob& job, bool clean);
+    void Flush(Client& client);
+
+    interfaces::Mining& m_mining;
+    const StratumOptions m_options;
+    std::shared_ptr<Sock> m_listen_sock;
+    CThreadInterrupt m_interrupt;
+    std::thread m_thread;
+
+    // Only used by the server thread once started.
+    std::vector<std::unique_ptr<Client>> m_clients;
+    //! Recent jobs for the current tip, newest last.
+    std::deque<StratumJob> m_jobs;
+    uint256 m_job_tip;
+    unsigned int m_job_transactions_updated{0};
+    std::chrono::steady_clock::time_point m_next_job;
+    uint64_t m_job_count{0};
+    uint32_t m_next_extranonce1;
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_STRATUM_H
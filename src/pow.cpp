@@ -7,11 +7,14 @@
 
 #include <arith_uint256.h>
 #include <chain.h>
+#include <crypto/common.h>
 #include <primitives/block.h>
 #include <uint256.h>
 #include <logging.h>
 #include <util/strencodings.h>
 
+#include <limits>
+
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     assert(pindexLast != nullptr);
@@ -93,35 +96,58 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
     return CalculateNextWorkRequired(pindexLast, pindexFirst->GetBlockTime(), params);
 }
 
-unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params)
+/**
+ * x / divisor by schoolbook division on 32-bit limbs. Retargets divide by a
+ * small timespan, and arith_uint256's general bit-by-bit division would be
+ * most of the cost of checking a header's bits.
+ */
+static arith_uint256 DivideSmall(const arith_uint256& x, uint64_t divisor)
+{
+    if (divisor > std::numeric_limits<uint32_t>::max()) return x / arith_uint256{divisor};
+    uint256 words{ArithToUint256(x)};
+    uint64_t remainder{0};
+    for (int limb = 7; limb >= 0; --limb) {
+        unsigned char* word{words.data() + 4 * limb};
+        const uint64_t current{(remainder << 32) | ReadLE32(word)};
+        WriteLE32(word, current / divisor);
+        remainder = current % divisor;
+    }
+    return UintToArith256(words);
+}
+
+/**
+ * Retarget from the last block's bits and time, given the time of the first
+ * block of the window and the bits the adjustment scales (see BIP94).
+ */
+static unsigned int RetargetWork(int next_height, uint32_t last_bits, int64_t last_time, int64_t first_time, uint32_t base_bits, const Consensus::Params& params)
 {
     if (params.fPowNoRetargeting)
-        return pindexLast->nBits;
+        return last_bits;
 
     // Limit adjustment step
-    int64_t nActualTimespan = pindexLast->GetBlockTime() - nFirstBlockTime;
+    int64_t nActualTimespan = last_time - first_time;
 
-    if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight) {
+    if(next_height < params.n2023DiffAlgoHeight) {
         if (nActualTimespan < params.nPowTargetTimespan/4)
             nActualTimespan = params.nPowTargetTimespan/4;
         if (nActualTimespan > params.nPowTargetTimespan*4)
             nActualTimespan = params.nPowTargetTimespan*4;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight2) {
+    } else if(next_height < params.n2023DiffAlgoHeight2) {
         if (nActualTimespan < params.n2023DiffAlgoTimespan/1.007)
             nActualTimespan = params.n2023DiffAlgoTimespan/1.007;
         if (nActualTimespan > params.n2023DiffAlgoTimespan*1.5)
             nActualTimespan = params.n2023DiffAlgoTimespan*1.5;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight3) {
+    } else if(next_height < params.n2023DiffAlgoHeight3) {
         if (nActualTimespan < params.n2023DiffAlgoTimespan/1.014)
             nActualTimespan = params.n2023DiffAlgoTimespan/1.014;
         if (nActualTimespan > params.n2023DiffAlgoTimespan*1.014)
             nActualTimespan = params.n2023DiffAlgoTimespan*1.014;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight4) {
+    } else if(next_height < params.n2023DiffAlgoHeight4) {
         if (nActualTimespan < params.n2023DiffAlgoTimespan/1.028)
             nActualTimespan = params.n2023DiffAlgoTimespan/1.028;
         if (nActualTimespan > params.n2023DiffAlgoTimespan*1.028)
             nActualTimespan = params.n2023DiffAlgoTimespan*1.028;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight5) {
+    } else if(next_height < params.n2023DiffAlgoHeight5) {
         if (nActualTimespan < 59)
             nActualTimespan = 59;
         if (nActualTimespan > 61)
@@ -137,27 +163,20 @@ unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nF
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     arith_uint256 bnNew;
 
-    // Special difficulty rule for Testnet4
-    if (params.enforce_BIP94) {
-        // Here we use the first block of the difficulty period. This way
-        // the real difficulty is always preserved in the first block as
-        // it is not allowed to use the min-difficulty exception.
-        int nHeightFirst = pindexLast->nHeight - (params.DifficultyAdjustmentInterval()-1);
-        const CBlockIndex* pindexFirst = pindexLast->GetAncestor(nHeightFirst);
-        bnNew.SetCompact(pindexFirst->nBits);
-    } else {
-        bnNew.SetCompact(pindexLast->nBits);
-    }
+    // Special difficulty rule for Testnet4: base_bits is the first block of the
+    // difficulty period. This way the real difficulty is always preserved in
+    // the first block as it is not allowed to use the min-difficulty exception.
+    bnNew.SetCompact(base_bits);
 
     bnNew *= nActualTimespan;
-    if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight) {
-        bnNew /= params.nPowTargetTimespan;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight4) {
-        bnNew /= params.n2023DiffAlgoTimespan;
-    } else if((pindexLast->nHeight+1) < params.n2023DiffAlgoHeight5) {
-        bnNew /= 60;
+    if(next_height < params.n2023DiffAlgoHeight) {
+        bnNew = DivideSmall(bnNew, params.nPowTargetTimespan);
+    } else if(next_height < params.n2023DiffAlgoHeight4) {
+        bnNew = DivideSmall(bnNew, params.n2023DiffAlgoTimespan);
+    } else if(next_height < params.n2023DiffAlgoHeight5) {
+        bnNew = DivideSmall(bnNew, 60);
     } else {
-        bnNew /= 38;
+        bnNew = DivideSmall(bnNew, 38);
     }
 
     if (bnNew > bnPowLimit)
@@ -166,6 +185,101 @@ unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nF
     return bnNew.GetCompact();
 }
 
+unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params)
+{
+    // Testnet4 scales the bits of the first block of the difficulty period
+    uint32_t base_bits{pindexLast->nBits};
+    if (params.enforce_BIP94 && !params.fPowNoRetargeting) {
+        int nHeightFirst = pindexLast->nHeight - (params.DifficultyAdjustmentInterval()-1);
+        const CBlockIndex* pindexFirst = pindexLast->GetAncestor(nHeightFirst);
+        base_bits = pindexFirst->nBits;
+    }
+    return RetargetWork(pindexLast->nHeight + 1, pindexLast->nBits, pindexLast->GetBlockTime(), nFirstBlockTime, base_bits, params);
+}
+
+DifficultyContext::DifficultyContext(const Consensus::Params& params)
+    : m_params{params},
+      m_pow_limit{UintToArith256(params.powLimit).GetCompact()},
+      m_periods{{{params.DifficultyAdjustmentInterval()}, {int64_t(params.n2023DiffAlgoWindow)}}}
+{
+    if (params.enforce_BIP94) m_recent_bits.resize(params.DifficultyAdjustmentInterval());
+}
+
+void DifficultyContext::Reset(const CBlockIndex& tip)
+{
+    m_tip_hash = tip.GetBlockHash();
+    m_height = tip.nHeight;
+    m_bits = tip.nBits;
+    m_time = tip.GetBlockTime();
+    m_prev_bits = tip.pprev ? tip.pprev->nBits : 0;
+    m_prev_time = tip.pprev ? tip.pprev->GetBlockTime() : 0;
+
+    for (Period& period : m_periods) {
+        period.start_time = tip.GetAncestor(tip.nHeight - tip.nHeight % period.length)->GetBlockTime();
+        // Same walk as the min-difficulty rule in GetNextWorkRequired()
+        const CBlockIndex* pindex = &tip;
+        while (pindex->pprev && pindex->nHeight % period.length != 0 && pindex->nBits == m_pow_limit)
+            pindex = pindex->pprev;
+        period.normal_bits = pindex->nBits;
+    }
+
+    const CBlockIndex* pindex = &tip;
+    for (size_t i = 0; i < m_recent_bits.size() && pindex; ++i, pindex = pindex->pprev) {
+        m_recent_bits[pindex->nHeight % m_recent_bits.size()] = pindex->nBits;
+    }
+}
+
+void DifficultyContext::Connect(const CBlockHeader& header, const uint256& hash)
+{
+    m_tip_hash = hash;
+    ++m_height;
+    m_prev_bits = m_bits;
+    m_prev_time = m_time;
+    m_bits = header.nBits;
+    m_time = header.GetBlockTime();
+
+    for (Period& period : m_periods) {
+        const bool boundary{m_height % period.length == 0};
+        if (boundary) period.start_time = m_time;
+        if (boundary || m_bits != m_pow_limit) period.normal_bits = m_bits;
+    }
+    if (!m_recent_bits.empty()) m_recent_bits[m_height % m_recent_bits.size()] = m_bits;
+}
+
+unsigned int DifficultyContext::GetNextWorkRequired(const CBlockHeader& block) const
+{
+    assert(m_height >= 0);
+    const int next_height{m_height + 1};
+    if (next_height == m_params.nFlexhashHeight) return m_params.nFlexhashBits;
+
+    // Mirrors ::GetNextWorkRequired(), reading the cached ancestors instead
+    const bool min_difficulty{m_params.fPowAllowMinDifficultyBlocks && block.GetBlockTime() > m_time + m_params.nPowTargetSpacing*2};
+    int64_t first_time;
+    if (next_height < m_params.n2023DiffAlgoHeight4) {
+        const Period& period{m_periods[next_height < m_params.n2023DiffAlgoHeight ? 0 : 1]};
+        if (next_height % period.length != 0) {
+            if (m_params.fPowAllowMinDifficultyBlocks) return min_difficulty ? m_pow_limit : period.normal_bits;
+            return m_bits;
+        }
+        first_time = period.start_time;
+    } else {
+        if (m_params.fPowAllowMinDifficultyBlocks) {
+            assert(m_height > 0);
+            return min_difficulty ? m_pow_limit : m_prev_bits;
+        }
+        assert(m_height > 0);
+        first_time = m_prev_time;
+    }
+
+    uint32_t base_bits{m_bits};
+    if (m_params.enforce_BIP94) {
+        const int64_t first_height{m_height - (m_params.DifficultyAdjustmentInterval()-1)};
+        assert(first_height >= 0);
+        base_bits = m_recent_bits[first_height % m_recent_bits.size()];
+    }
+    return RetargetWork(next_height, m_bits, m_time, first_time, base_bits, m_params);
+}
+
 // Check that on difficulty adjustments, the new difficulty does not increase
 // or decrease beyond the permitted limits.
 bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t height, uint32_t old_nbits, uint32_t new_nbits, uint32_t old_ntime, uint32_t new_ntime, int32_t old_nversion, int32_t new_nversion)
@@ -7,12 +7,14 @@
 #define BITCOIN_POW_H
 
 #include <consensus/params.h>
+#include <uint256.h>
 
+#include <array>
 #include <stdint.h>
+#include <vector>
 
 class CBlockHeader;
 class CBlockIndex;
-class uint256;
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
@@ -34,4 +36,55 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
  */
 bool PermittedDifficultyTransition(const Consensus::Params& params, int64_t height, uint32_t old_nbits, uint32_t new_nbits, uint32_t old_ntime, uint32_t new_ntime, int32_t old_nversion, int32_t new_nversion);
 
+/**
+ * The inputs GetNextWorkRequired() reads from the ancestors of a chain tip,
+ * kept up to date as headers are connected one at a time.
+ *
+ * GetNextWorkRequired() looks up the first block of the adjustment period and,
+ * on networks that allow min-difficulty blocks, walks back past them. Checking
+ * a long run of headers that way repeats the same walks for every header. This
+ * context walks the ancestors once in Reset(), then only needs the new header
+ * in Connect(), so each check is constant time.
+ */
+class DifficultyContext
+{
+public:
+    explicit DifficultyContext(const Consensus::Params& params);
+
+    //! Rebuild the context for the chain ending at tip. Walks its ancestors.
+    void Reset(const CBlockIndex& tip);
+    //! Extend the chain by header, whose block hash is hash. It must build on the current tip.
+    void Connect(const CBlockHeader& header, const uint256& hash);
+
+    //! Whether the context describes the chain ending at the block with this hash.
+    bool IsTip(const uint256& hash) const { return m_height >= 0 && hash == m_tip_hash; }
+    int Height() const { return m_height; }
+
+    //! Same result as GetNextWorkRequired() for a block building on the tip.
+    unsigned int GetNextWorkRequired(const CBlockHeader& block) const;
+
+private:
+    //! One difficulty adjustment schedule: the legacy interval or the 2023 window.
+    struct Period {
+        int64_t length;
+        //! Time of the last block at a multiple of length.
+        int64_t start_time{0};
+        //! Bits of the block the min-difficulty walk of GetNextWorkRequired() stops at.
+        uint32_t normal_bits{0};
+    };
+
+    const Consensus::Params& m_params;
+    const uint32_t m_pow_limit;
+
+    uint256 m_tip_hash;
+    int m_height{-1};
+    uint32_t m_bits{0};
+    int64_t m_time{0};
+    uint32_t m_prev_bits{0};
+    int64_t m_prev_time{0};
+    std::array<Period, 2> m_periods;
+    //! Bits of the last DifficultyAdjustmentInterval() blocks, by height; only kept for BIP94.
+    std::vector<uint32_t> m_recent_bits;
+};
+
 #endif // BITCOIN_POW_H
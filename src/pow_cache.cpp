@@ -1,150 +1,371 @@
-#include "pow_cache.h"
-#include <logging.h>
-
-// Static member initialization
-std::mutex SQLiteCache::db_mutex;  // Ensures thread safety for SQLite access.
-sqlite3* SQLiteCache::db = nullptr;  // Shared database connection pointer.
-
-static void PowCacheErrorLogCallback(void* arg, int code, const char* msg)
-{
-    assert(arg == nullptr);
-    LogPrintf("SQLite Error. Code: %d. Message: %s\n", code, msg);
-}
-
-// Constructor
-SQLiteCache::SQLiteCache(const std::string& dbName) {
-    // Lock the mutex to synchronize database access across threads.
-    std::lock_guard<std::mutex> lock(db_mutex);
-
-    // If the database connection is not already open, open it.
-    if (db == nullptr) {
-        const fs::path path = gArgs.GetDataDirNet() / fs::u8path(dbName.c_str());
-        int rc = sqlite3_config(SQLITE_CONFIG_LOG, PowCacheErrorLogCallback, nullptr);
-        rc = sqlite3_config(SQLITE_CONFIG_SERIALIZED);
-        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;  // Open with read/write permissions and create if necessary.
-        sqlite3_initialize();  // Initialize SQLite if not already done.
-
-        // Open the database using the specified path.
-        rc = sqlite3_open_v2(path.utf8string().c_str(), &db, flags, nullptr);
-        if (rc != SQLITE_OK) {
-            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
-            sqlite3_close(db);  // Close the database if opening fails.
-            db = nullptr;
-        } else {
-            setupPragmas();  // Set PRAGMA settings to optimize performance.
-            createTable();   // Create the cache table if it doesn't exist.
-        }
-    }
-}
-
-// Destructor: We don’t close the database here, allowing it to be reused by other threads.
-// SQLite will close the connection when the program exits.
-SQLiteCache::~SQLiteCache() {
-    // Database closing logic can be handled when the program terminates.
-    // This prevents closing the connection while another thread might be using it.
-}
-
-// Inserts or updates a key-value pair in the database.
-bool SQLiteCache::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);  // Lock database access for thread safety.
-
-    // SQL statement to insert or replace the key-value pair.
-    const std::string sql = "INSERT OR REPLACE INTO Cache (key, value) VALUES (?, ?);";
-    sqlite3_stmt* stmt = nullptr;
-
-    // Prepare the SQL statement.
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
-        return false;
-    }
-
-    // Bind the key and value to the SQL statement.
-    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_STATIC);
-
-    // Execute the statement.
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE) {
-        std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
-        sqlite3_finalize(stmt);  // Finalize the statement to avoid memory leaks.
-        return false;
-    }
-
-    sqlite3_finalize(stmt);  // Finalize the statement after successful execution.
-    return true;
-}
-
-// Retrieves the value associated with the given key.
-std::string SQLiteCache::get(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);  // Lock database access for thread safety.
-
-    // SQL statement to retrieve the value based on the key.
-    const std::string sql = "SELECT value FROM Cache WHERE key = ?;";
-    sqlite3_stmt* stmt = nullptr;
-
-    // Prepare the SQL statement.
-    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
-        return "";
-    }
-
-    // Bind the key to the SQL statement.
-    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
-
-    // Execute the statement and fetch the result.
-    rc = sqlite3_step(stmt);
-    std::string result;
-    if (rc == SQLITE_ROW) {
-        const unsigned char* text = sqlite3_column_text(stmt, 0);
-        if (text) {
-            result = reinterpret_cast<const char*>(text);  // Convert the result to a std::string.
-        }
-    } else if (rc != SQLITE_DONE) {
-        std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
-    }
-
-    sqlite3_finalize(stmt);  // Finalize the statement to avoid memory leaks.
-    return result;
-}
-
-// Create the cache table if it doesn't exist.
-void SQLiteCache::createTable() {
-    const char* sql = "CREATE TABLE IF NOT EXISTS Cache (key TEXT PRIMARY KEY, value TEXT);";
-    char* errMsg = nullptr;
-
-    // Execute the SQL statement to create the table.
-    int rc = sqlite3_exec(db, sql, nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL error: " << errMsg << std::endl;
-        sqlite3_free(errMsg);  // Free the error message memory allocated by SQLite.
-    }
-}
-
-// Set performance-related PRAGMA settings for the SQLite database.
-void SQLiteCache::setupPragmas() {
-    // Array of PRAGMA SQL statements.
-    const char* pragmas[] = {
-        "PRAGMA synchronous = NORMAL;",
-        "PRAGMA journal_mode = DELETE;",
-        "PRAGMA temp_store = 1;",
-        "PRAGMA cache_size = 10000;",
-        "PRAGMA journal_size_limit = 1000000;",
-        "PRAGMA locking_mode = NORMAL;",
-        "PRAGMA count_changes = OFF;"
-        "PRAGMA auto_vacuum = 0;"
-        "PRAGMA page_size = 4096;"
-        "PRAGMA lock_timeout = 5000;"
-    };
-
-    // Loop through each PRAGMA statement and execute it.
-    for (const char* pragma : pragmas) {
-        char* errMsg = nullptr;
-        int rc = sqlite3_exec(db, pragma, nullptr, nullptr, &errMsg);
-        if (rc != SQLITE_OK) {
-            std::cerr << "PRAGMA error: " << errMsg << std::endl;
-            sqlite3_free(errMsg);  // Free the error message memory allocated by SQLite.
-        }
-    }
-}
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pow_cache.h>
+
+#include <common/args.h>
+#include <crypto/common.h>
+#include <crypto/siphash.h>
+#include <logging.h>
+#include <random.h>
+#include <util/thread.h>
+#include <util/time.h>
+#include <util/fs_helpers.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+//! File header: magic bytes followed by a little-endian format version.
+constexpr std::array<uint8_t, 8> FILE_MAGIC{'k', 'y', 'l', 'p', 'o', 'w', 'c', 'h'};
+constexpr uint32_t FILE_VERSION{1};
+constexpr size_t FILE_HEADER_SIZE{FILE_MAGIC.size() + sizeof(FILE_VERSION)};
+//! On-disk record: key, value and a checksum over both.
+constexpr size_t RECORD_SIZE{32 + 32 + 8};
+//! Records buffered before the writer is woken without waiting for Commit().
+constexpr size_t WRITE_BATCH{4096};
+//! Longest time an entry waits for the writer when nobody commits.
+constexpr auto WRITE_INTERVAL{10s};
+//! Fixed SipHash key for record checksums, so files are portable between runs.
+constexpr uint64_t CHECK_K0{0x6b796c61706f7763};
+constexpr uint64_t CHECK_K1{0x6163686563686b31};
+
+uint64_t RecordCheck(const uint256& key, const uint256& value)
+{
+    return CSipHasher(CHECK_K0, CHECK_K1).Write(key).Write(value).Finalize();
+}
+
+void SerializeRecord(const uint256& key, const uint256& value, uint8_t* out)
+{
+    std::memcpy(out, key.data(), 32);
+    std::memcpy(out + 32, value.data(), 32);
+    WriteLE64(out + 64, RecordCheck(key, value));
+}
+
+bool DeserializeRecord(const uint8_t (&in)[RECORD_SIZE], uint256& key, uint256& value)
+{
+    std::memcpy(key.data(), in, 32);
+    std::memcpy(value.data(), in + 32, 32);
+    return !key.IsNull() && ReadLE64(in + 64) == RecordCheck(key, value);
+}
+} // namespace
+
+PowCache::PowCache(size_t max_bytes, fs::path path)
+    : m_salt0{FastRandomContext().rand64()},
+      m_salt1{FastRandomContext().rand64()},
+      m_path{std::move(path)}
+{
+    // Round the table down to a power of two number of sets.
+    size_t sets{1};
+    while (sets * 2 * sizeof(Set) <= max_bytes) sets *= 2;
+    m_sets = std::make_unique<Set[]>(sets);
+    m_set_mask = sets - 1;
+
+    if (!m_path.empty()) {
+        LOCK(m_file_mutex);
+        Load();
+        if (m_file) m_writer = std::thread(&util::TraceThread, "powcache", [this] { ThreadWrite(); });
+    }
+}
+
+PowCache::~PowCache()
+{
+    if (m_writer.joinable()) {
+        WITH_LOCK(m_pending_mutex, m_stop = true);
+        m_pending_cv.notify_one();
+        m_writer.join();
+    }
+    Flush();
+    LOCK(m_file_mutex);
+    if (m_file) std::fclose(m_file);
+}
+
+size_t PowCache::SetIndex(const uint256& key) const
+{
+    return SipHashUint256(m_salt0, m_salt1, key) & m_set_mask;
+}
+
+std::optional<uint256> PowCache::Get(const uint256& key) const
+{
+    Set& set{m_sets[SetIndex(key)]};
+    const uint64_t k[4]{key.GetUint64(0), key.GetUint64(1), key.GetUint64(2), key.GetUint64(3)};
+
+    while (true) {
+        const uint32_t seq{set.seq.load(std::memory_order_acquire)};
+        if (seq & 1) continue; // a writer is mid-update; they only copy 64 bytes
+
+        std::optional<size_t> found;
+        uint64_t v[4];
+        for (size_t way = 0; way < WAYS; ++way) {
+            const auto& words{set.ways[way]};
+            if (words[0].load(std::memory_order_relaxed) != k[0] || words[1].load(std::memory_order_relaxed) != k[1] ||
+                words[2].load(std::memory_order_relaxed) != k[2] || words[3].load(std::memory_order_relaxed) != k[3]) {
+                continue;
+            }
+            for (size_t i = 0; i < 4; ++i) v[i] = words[4 + i].load(std::memory_order_relaxed);
+            found = way;
+            break;
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (set.seq.load(std::memory_order_relaxed) != seq) continue;
+
+        if (!found) {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        const uint8_t bit = 1 << *found;
+        if (!(set.referenced.load(std::memory_order_relaxed) & bit)) {
+            set.referenced.fetch_or(bit, std::memory_order_relaxed);
+        }
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        uint256 value;
+        for (size_t i = 0; i < 4; ++i) WriteLE64(value.data() + 8 * i, v[i]);
+        return value;
+    }
+}
+
+bool PowCache::Insert(const uint256& key, const uint256& value)
+{
+    const size_t index{SetIndex(key)};
+    Set& set{m_sets[index]};
+    const uint64_t k[4]{key.GetUint64(0), key.GetUint64(1), key.GetUint64(2), key.GetUint64(3)};
+
+    LOCK(m_stripes[index % STRIPES]);
+    std::optional<size_t> empty;
+    for (size_t way = 0; way < WAYS; ++way) {
+        const auto& words{set.ways[way]};
+        const uint64_t w[4]{words[0].load(std::memory_order_relaxed), words[1].load(std::memory_order_relaxed),
+                            words[2].load(std::memory_order_relaxed), words[3].load(std::memory_order_relaxed)};
+        if (w[0] == k[0] && w[1] == k[1] && w[2] == k[2] && w[3] == k[3]) return false;
+        if (!empty && (w[0] | w[1] | w[2] | w[3]) == 0) empty = way;
+    }
+
+    size_t victim;
+    if (empty) {
+        victim = *empty;
+        m_entries.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        // CLOCK: skip (and clear) recently referenced ways until one was not.
+        // Readers may set bits again meanwhile, so give up after two sweeps.
+        for (size_t n = 0; n < 2 * WAYS && (set.referenced.load(std::memory_order_relaxed) & (1 << set.hand)); ++n) {
+            set.referenced.fetch_and(uint8_t(~(1 << set.hand)), std::memory_order_relaxed);
+            set.hand = (set.hand + 1) % WAYS;
+        }
+        victim = set.hand;
+        set.hand = (set.hand + 1) % WAYS;
+    }
+
+    const uint32_t seq{set.seq.load(std::memory_order_relaxed)};
+    set.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& words{set.ways[victim]};
+    for (size_t i = 0; i < 4; ++i) {
+        words[i].store(k[i], std::memory_order_relaxed);
+        words[4 + i].store(value.GetUint64(i), std::memory_order_relaxed);
+    }
+    set.seq.store(seq + 2, std::memory_order_release);
+    // New entries start unreferenced, so an entry that is never read again is
+    // the first to go and a burst of misses cannot flush out hot entries.
+    set.referenced.fetch_and(uint8_t(~(1 << victim)), std::memory_order_relaxed);
+    return true;
+}
+
+void PowCache::Put(const uint256& key, const uint256& value)
+{
+    if (!Insert(key, value) || !m_writer.joinable()) return;
+
+    bool wake;
+    {
+        LOCK(m_pending_mutex);
+        m_pending.push_back({key, value});
+        wake = m_pending.size() == WRITE_BATCH;
+    }
+    if (wake) m_pending_cv.notify_one();
+}
+
+void PowCache::Commit()
+{
+    if (!m_writer.joinable()) return;
+    {
+        LOCK(m_pending_mutex);
+        if (m_pending.empty()) return;
+        m_commit = true;
+    }
+    m_pending_cv.notify_one();
+}
+
+void PowCache::Flush()
+{
+    WritePending();
+}
+
+bool PowCache::Compact()
+{
+    LOCK(m_file_mutex);
+    if (!m_file) return false;
+    // Pending entries are in the table already, so the rewrite covers them
+    WITH_LOCK(m_pending_mutex, m_pending.clear());
+    return RewriteOpen();
+}
+
+void PowCache::ThreadWrite()
+{
+    while (true) {
+        {
+            WAIT_LOCK(m_pending_mutex, lock);
+            m_pending_cv.wait_for(lock, WRITE_INTERVAL, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_pending_mutex) {
+                return m_stop || m_commit || m_pending.size() >= WRITE_BATCH;
+            });
+            // The destructor writes whatever is left.
+            if (m_stop) return;
+            m_commit = false;
+        }
+        WritePending();
+    }
+}
+
+PowCache::Stats PowCache::GetStats() const
+{
+    return Stats{
+        .entries = m_entries.load(std::memory_order_relaxed),
+        .capacity = (m_set_mask + 1) * WAYS,
+        .usage = (m_set_mask + 1) * sizeof(Set),
+        .file_records = m_file_records.load(std::memory_order_relaxed),
+        .hits = m_hits.load(std::memory_order_relaxed),
+        .misses = m_misses.load(std::memory_order_relaxed),
+    };
+}
+
+void PowCache::Load()
+{
+    size_t loaded{0}, records{0};
+    bool intact{false};
+    if (FILE* file{fsbridge::fopen(m_path, "rb")}) {
+        uint8_t header[FILE_HEADER_SIZE];
+        if (std::fread(header, 1, sizeof(header), file) == sizeof(header) &&
+            std::equal(FILE_MAGIC.begin(), FILE_MAGIC.end(), header) && ReadLE32(header + FILE_MAGIC.size()) == FILE_VERSION) {
+            intact = true;
+            uint8_t record[RECORD_SIZE];
+            while (true) {
+                const size_t read{std::fread(record, 1, sizeof(record), file)};
+                if (read == 0 && std::feof(file)) break;
+                uint256 key, value;
+                if (read != sizeof(record) || !DeserializeRecord(record, key, value)) {
+                    // Torn write or corruption; everything before it is still good.
+                    LogPrintf("PoW cache: discarding damaged tail of %s after %u records\n", fs::PathToString(m_path), records);
+                    intact = false;
+                    break;
+                }
+                ++records;
+                if (Insert(key, value)) ++loaded;
+            }
+        }
+        std::fclose(file);
+    }
+
+    // Rewrite files that are damaged, from another format, or mostly hold
+    // entries that no longer fit in memory; otherwise keep appending.
+    if (!intact || records > 2 * GetStats().capacity) {
+        if (!Rewrite()) return;
+    } else {
+        m_file_records = records;
+    }
+    m_file = fsbridge::fopen(m_path, "ab");
+    if (!m_file) {
+        LogPrintf("PoW cache: unable to open %s, continuing without persistence\n", fs::PathToString(m_path));
+        return;
+    }
+    LogPrintf("PoW cache: loaded %u entries from %s\n", loaded, fs::PathToString(m_path));
+}
+
+bool PowCache::Rewrite()
+{
+    const fs::path tmp_path{m_path + ".new"};
+    FILE* file{fsbridge::fopen(tmp_path, "wb")};
+    if (!file) {
+        LogPrintf("PoW cache: unable to create %s, continuing without persistence\n", fs::PathToString(tmp_path));
+        return false;
+    }
+
+    uint8_t header[FILE_HEADER_SIZE];
+    std::copy(FILE_MAGIC.begin(), FILE_MAGIC.end(), header);
+    WriteLE32(header + FILE_MAGIC.size(), FILE_VERSION);
+    bool ok{std::fwrite(header, 1, sizeof(header), file) == sizeof(header)};
+    size_t records{0};
+    for (size_t index = 0; ok && index <= m_set_mask; ++index) {
+        // Writers hold the stripe lock, so the set cannot change under us
+        LOCK(m_stripes[index % STRIPES]);
+        for (const auto& words : m_sets[index].ways) {
+            uint256 key, value;
+            for (size_t i = 0; i < 4; ++i) {
+                WriteLE64(key.data() + 8 * i, words[i].load(std::memory_order_relaxed));
+                WriteLE64(value.data() + 8 * i, words[4 + i].load(std::memory_order_relaxed));
+            }
+            if (key.IsNull()) continue;
+            uint8_t record[RECORD_SIZE];
+            SerializeRecord(key, value, record);
+            ok &= std::fwrite(record, 1, sizeof(record), file) == sizeof(record);
+            ++records;
+        }
+    }
+    ok &= std::fclose(file) == 0;
+
+    if (!ok || !RenameOver(tmp_path, m_path)) {
+        LogPrintf("PoW cache: unable to write %s, continuing without persistence\n", fs::PathToString(m_path));
+        fs::remove(tmp_path);
+        return false;
+    }
+    m_file_records = records;
+    return true;
+}
+
+bool PowCache::RewriteOpen()
+{
+    if (m_file) std::fclose(m_file);
+    m_file = nullptr;
+    if (!Rewrite()) return false;
+    m_file = fsbridge::fopen(m_path, "ab");
+    if (!m_file) {
+        LogPrintf("PoW cache: unable to open %s, continuing without persistence\n", fs::PathToString(m_path));
+        return false;
+    }
+    return true;
+}
+
+void PowCache::WritePending()
+{
+    // Holding m_file_mutex across the swap keeps concurrent writes in order.
+    LOCK(m_file_mutex);
+    std::vector<Record> batch;
+    WITH_LOCK(m_pending_mutex, batch.swap(m_pending));
+    if (!m_file || batch.empty()) return;
+
+    // One buffer and one write per batch.
+    std::vector<uint8_t> buffer(batch.size() * RECORD_SIZE);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        SerializeRecord(batch[i].key, batch[i].value, buffer.data() + i * RECORD_SIZE);
+    }
+    const bool ok{std::fwrite(buffer.data(), 1, buffer.size(), m_file) == buffer.size()};
+    if (!ok || std::fflush(m_file) != 0) {
+        // The next load truncates any partial record, so just stop appending.
+        LogPrintf("PoW cache: write to %s failed, continuing without persistence\n", fs::PathToString(m_path));
+        std::fclose(m_file);
+        m_file = nullptr;
+        return;
+    }
+
+    // Keep the file within twice the table's capacity
+    if (m_file_records.fetch_add(batch.size()) + batch.size() > 2 * GetStats().capacity) {
+        if (RewriteOpen()) LogPrintf("PoW cache: compacted %s to %u records\n", fs::PathToString(m_path), m_file_records.load());
+    }
+}
+
+PowCache& PowCache::Instance()
+{
+    static PowCache cache{
+        size_t(std::max<int64_t>(gArgs.GetIntArg("-powcachesize", DEFAULT_POW_CACHE_SIZE), 0)) << 20,
+        gArgs.GetDataDirNet() / POW_CACHE_FILENAME};
+    return cache;
+}
@@ -1,43 +1,148 @@
-#ifndef SQLITE_CACHE_H
-#define SQLITE_CACHE_H
-
-#include <mutex>
-#include <string>
-#include <sqlite3.h>
-#include <iostream>
-#include <util/fs.h>
-#include <common/args.h>
-#include <utility>
-
-class SQLiteCache {
-public:
-    // Constructor: Opens the SQLite database with the provided database name.
-    // If the database connection is already established, it won't re-open.
-    SQLiteCache(const std::string& dbName);
-
-    // Destructor: Does not close the database connection here, allowing shared use across threads.
-    ~SQLiteCache();
-
-    // Inserts or updates a key-value pair in the cache.
-    // Returns true on success, false on failure.
-    bool set(const std::string& key, const std::string& value);
-
-    // Retrieves the value associated with the given key.
-    // Returns an empty string if the key does not exist or on error.
-    std::string get(const std::string& key);
-
-private:
-    // Mutex to protect shared access to the SQLite database across threads.
-    static std::mutex db_mutex;
-
-    // Shared database connection across instances.
-    static sqlite3* db;
-
-    // Creates the cache table if it does not already exist.
-    void createTable();
-
-    // Set PRAGMA settings for database performance optimizations.
-    void setupPragmas();
-};
-
-#endif // SQLITE_CACHE_H
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POW_CACHE_H
+#define BITCOIN_POW_CACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+#include <util/fs.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+//! Default memory budget of the Flex proof-of-work cache, in MiB.
+static constexpr int64_t DEFAULT_POW_CACHE_SIZE{32};
+//! File in the network data directory that persists the PoW cache.
+static constexpr const char* POW_CACHE_FILENAME{"powcache.dat"};
+
+/**
+ * Cache of Flex proof-of-work hashes, keyed by the SHA3 identity hash of the
+ * header.
+ *
+ * Entries live in a fixed-size, set-associative table so memory stays
+ * bounded; a full set evicts with the CLOCK (second chance) approximation of
+ * LRU. Writers serialize per lock stripe, while readers never block: each set
+ * is guarded by a sequence counter and lookups simply retry if they raced with
+ * a writer.
+ *
+ * New entries are appended to a flat file of fixed-size, checksummed records
+ * and reloaded on startup. A torn or corrupt tail is truncated on load.
+ * Appends happen on a background thread, one write per batch, so callers
+ * computing hashes never wait for the disk. Once the file holds more than
+ * twice as many records as the table can, it is rewritten from the table so
+ * evicted entries do not pile up on disk.
+ *
+ * Callers decide what is worth caching: lookups never insert.
+ */
+class PowCache
+{
+public:
+    struct Stats {
+        size_t entries;
+        size_t capacity;
+        size_t usage;
+        size_t file_records;
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    /**
+     * @param[in] max_bytes  Memory budget for the in-memory table.
+     * @param[in] path       Backing file, or empty to keep the cache in memory only.
+     */
+    PowCache(size_t max_bytes, fs::path path);
+    ~PowCache();
+
+    PowCache(const PowCache&) = delete;
+    PowCache& operator=(const PowCache&) = delete;
+
+    std::optional<uint256> Get(const uint256& key) const;
+    void Put(const uint256& key, const uint256& value) EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex);
+
+    /**
+     * Hand the entries added so far to the background writer as one batch,
+     * e.g. after a HEADERS message or a block. Does not wait for the write.
+     */
+    void Commit() EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex);
+
+    //! Write out entries that have not reached the backing file yet.
+    void Flush() EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex, !m_file_mutex);
+
+    /**
+     * Rewrite the backing file with just the entries currently in the table,
+     * dropping records of evicted entries. Returns false if there is no
+     * backing file or it could not be rewritten.
+     */
+    bool Compact() EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex, !m_file_mutex);
+
+    Stats GetStats() const;
+
+    /** The process-wide cache, opened in the network data directory on first use. */
+    static PowCache& Instance();
+
+private:
+    static constexpr size_t WAYS{8};
+    static constexpr size_t WORDS{8}; //!< 4 words of key, then 4 words of value
+    static constexpr size_t STRIPES{64};
+
+    struct alignas(64) Set {
+        //! Odd while a writer is modifying the set.
+        std::atomic<uint32_t> seq{0};
+        //! CLOCK reference bit per way.
+        std::atomic<uint8_t> referenced{0};
+        //! Next way the CLOCK hand inspects.
+        uint8_t hand{0};
+        std::array<std::array<std::atomic<uint64_t>, WORDS>, WAYS> ways{};
+    };
+
+    struct Record {
+        uint256 key;
+        uint256 value;
+    };
+
+    std::unique_ptr<Set[]> m_sets;
+    size_t m_set_mask;
+    std::array<Mutex, STRIPES> m_stripes;
+    const uint64_t m_salt0;
+    const uint64_t m_salt1;
+
+    std::atomic<size_t> m_entries{0};
+    mutable std::atomic<uint64_t> m_hits{0};
+    mutable std::atomic<uint64_t> m_misses{0};
+
+    const fs::path m_path;
+    Mutex m_file_mutex;
+    FILE* m_file GUARDED_BY(m_file_mutex){nullptr};
+    //! Records in the backing file; written under m_file_mutex.
+    std::atomic<size_t> m_file_records{0};
+
+    Mutex m_pending_mutex;
+    std::condition_variable m_pending_cv;
+    std::vector<Record> m_pending GUARDED_BY(m_pending_mutex);
+    bool m_commit GUARDED_BY(m_pending_mutex){false};
+    bool m_stop GUARDED_BY(m_pending_mutex){false};
+    std::thread m_writer;
+
+    size_t SetIndex(const uint256& key) const;
+    //! Insert into the table only; returns false if the key was already present.
+    bool Insert(const uint256& key, const uint256& value);
+    void Load() EXCLUSIVE_LOCKS_REQUIRED(m_file_mutex);
+    //! Replace the backing file with the current table contents.
+    bool Rewrite() EXCLUSIVE_LOCKS_REQUIRED(m_file_mutex);
+    //! Rewrite the open backing file and reopen it for appending.
+    bool RewriteOpen() EXCLUSIVE_LOCKS_REQUIRED(m_file_mutex);
+    void WritePending() EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex, !m_file_mutex);
+    void ThreadWrite() EXCLUSIVE_LOCKS_REQUIRED(!m_pending_mutex, !m_file_mutex);
+};
+
+#endif // BITCOIN_POW_CACHE_H
@@ -5,39 +5,57 @@
 
 #include <primitives/block.h>
 
+#include <crypto/common.h>
+#include <crypto/flex/flex.h>
+#include <crypto/sha3.h>
 #include <hash.h>
+#include <pow_cache.h>
 #include <tinyformat.h>
 
+#include <cstring>
+
+//! The serialized header, as Hash3Writer and Hash4Writer would see it.
+static void SerializeHeader(const CBlockHeader& block, unsigned char (&header)[80])
+{
+    WriteLE32(header, block.nVersion);
+    std::memcpy(header + 4, block.hashPrevBlock.data(), 32);
+    std::memcpy(header + 36, block.hashMerkleRoot.data(), 32);
+    WriteLE32(header + 68, block.nTime);
+    WriteLE32(header + 72, block.nBits);
+    WriteLE32(header + 76, block.nNonce);
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-    return (Hash3Writer{} << *this).GetHash();
+    unsigned char header[80];
+    SerializeHeader(*this, header);
+    uint256 result;
+    SHA3_256d_80(result.data(), header);
+    return result;
 }
 
 uint256 CBlockHeader::GetHash2() const
 {
-    return (Hash4Writer{} << *this).GetHash();
+    unsigned char header[80];
+    SerializeHeader(*this, header);
+    uint256 result;
+    flex_hash(reinterpret_cast<const char*>(header), sizeof(header), result.data());
+    return result;
 }
 
 uint256 CBlockHeader::GetPoWHash() const
 {
-    uint256 hash;
-    uint256 hash2;
-    std::string result;
-    hash = GetHash();
-    if(nVersion & 0x8000) {
-        SQLiteCache cache("cache.db");
-        result = cache.get(hash.ToString());
-        if(result == "") {
-            hash2 = GetHash2();
-            cache.set(hash.ToString(), hash2.ToString());
-        } else {
-            hash2 = uint256S(result);
-        }
-        return hash2;
-    }
-    return hash;
+    const uint256 hash{GetHash()};
+    if (!(nVersion & 0x8000)) return hash;
+
+    if (const auto cached{PowCache::Instance().Get(hash)}) return *cached;
+    return GetHash2();
 }
 
+uint256 CBlockHeader::ComputePoWHash() const
+{
+    return (nVersion & 0x8000) ? GetHash2() : GetHash();
+}
 
 std::string CBlock::ToString() const
 {
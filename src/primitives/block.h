@@ -6,12 +6,14 @@
 #ifndef BITCOIN_PRIMITIVES_BLOCK_H
 #define BITCOIN_PRIMITIVES_BLOCK_H
 
-#include <pow_cache.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
 #include <uint256.h>
 #include <util/time.h>
 
+#include <optional>
+#include <utility>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -54,7 +56,14 @@ public:
 
     uint256 GetHash() const;
     uint256 GetHash2() const;
+    /**
+     * Proof-of-work hash, answered from the PoW cache when the header was
+     * seen before. Never adds to the cache: only headers accepted into the
+     * block index are worth keeping, and validation admits those itself.
+     */
     uint256 GetPoWHash() const;
+    //! Proof-of-work hash computed from scratch, for speculative headers such as mining candidates.
+    uint256 ComputePoWHash() const;
 
     NodeSeconds Time() const
     {
@@ -78,6 +87,9 @@ public:
     mutable bool fChecked;                            // CheckBlock()
     mutable bool m_checked_witness_commitment{false}; // CheckWitnessCommitment()
     mutable bool m_checked_merkle_root{false};        // CheckMerkleRoot()
+    //! Header hash and proof-of-work hash checked by CheckBlock(), or stored in the block index for a block
+    //! read from disk, so checking or accepting the header need not recompute it
+    mutable std::optional<std::pair<uint256, uint256>> m_checked_pow;
 
     CBlock()
     {
@@ -92,7 +104,7 @@ public:
 
     SERIALIZE_METHODS(CBlock, obj)
     {
-        READWRITE(AsBase<CBlockHeader>(obj), obj.vtx);
+        READWRITE(AsBase<CBlockHeader>(obj), Using<BatchHashedTransactions>(obj.vtx));
     }
 
     void SetNull()
@@ -102,6 +114,7 @@ public:
         fChecked = false;
         m_checked_witness_commitment = false;
         m_checked_merkle_root = false;
+        m_checked_pow.reset();
     }
 
     CBlockHeader GetBlockHeader() const
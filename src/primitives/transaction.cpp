@@ -7,14 +7,18 @@
 
 #include <consensus/amount.h>
 #include <crypto/hex_base.h>
+#include <crypto/sha3.h>
 #include <hash.h>
 #include <script/script.h>
 #include <serialize.h>
+#include <span.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <uint256.h>
 #include <util/transaction_identifier.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <stdexcept>
 
@@ -94,6 +98,96 @@ Wtxid CTransaction::ComputeWitnessHash() const
 
 CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), version{tx.version}, nLockTime{tx.nLockTime}, m_has_witness{ComputeHasWitness()}, hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
 CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), version{tx.version}, nLockTime{tx.nLockTime}, m_has_witness{ComputeHasWitness()}, hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+CTransaction::CTransaction(CMutableTransaction&& tx, const Txid& hash, const Wtxid& witness_hash) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), version{tx.version}, nLockTime{tx.nLockTime}, m_has_witness{ComputeHasWitness()}, hash{hash}, m_witness_hash{witness_hash} {}
+
+namespace {
+/** The parts of a transaction's witness serialization that make up its serialization without witness. */
+std::array<Span<const unsigned char>, 3> StripWitness(const CMutableTransaction& tx, Span<const unsigned char> bytes)
+{
+    // version | marker, flag | inputs, outputs | witnesses | lock time
+    const size_t stripped_size{::GetSerializeSize(TX_NO_WITNESS(tx))};
+    return {bytes.first(4), bytes.subspan(6, stripped_size - 8), bytes.last(4)};
+}
+} // namespace
+
+struct CTransaction::Decoded {
+    CMutableTransaction tx;
+    Txid hash;
+    Wtxid witness_hash;
+};
+
+CTransaction::Decoded CTransaction::Decode(const TransactionSerParams& params, SpanReader& reader)
+{
+    const Span<const unsigned char> start{reader.data(), reader.size()};
+    CMutableTransaction tx{deserialize, params, reader};
+    const auto bytes{start.first(start.size() - reader.size())};
+    const Wtxid witness_hash{Wtxid::FromUint256((Hash3Writer{} << bytes).GetHash())};
+    if (!tx.HasWitness()) {
+        return {std::move(tx), Txid::FromUint256(witness_hash.ToUint256()), witness_hash};
+    }
+    Hash3Writer hasher;
+    for (const auto part : StripWitness(tx, bytes)) hasher << part;
+    return {std::move(tx), Txid::FromUint256(hasher.GetHash()), witness_hash};
+}
+
+CTransaction::CTransaction(Decoded&& decoded) : CTransaction{std::move(decoded.tx), decoded.hash, decoded.witness_hash} {}
+CTransaction::CTransaction(const TransactionSerParams& params, SpanReader& reader) : CTransaction{Decode(params, reader)} {}
+
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs, Span<const Span<const unsigned char>> serialized)
+{
+    assert(serialized.empty() || serialized.size() == txs.size());
+    // Serialize the transactions without witness, then those with a witness
+    // again in full, and hash all of it at once. Bytes the transactions were
+    // read from are hashed in place instead, so that only the txids of
+    // transactions with a witness need a copy, which skips the witness.
+    std::vector<unsigned char> data;
+    std::vector<Span<const unsigned char>> inputs;
+    inputs.reserve(txs.size() * 2);
+    // Inputs written to data, by index and start, resolved once data stops growing
+    std::vector<std::pair<size_t, size_t>> buffered;
+    const auto buffer{[&](const auto& write) {
+        buffered.emplace_back(inputs.size(), data.size());
+        inputs.emplace_back();
+        write();
+    }};
+    for (size_t i = 0; i < txs.size(); ++i) {
+        if (serialized.empty()) {
+            buffer([&] { VectorWriter{data, data.size()} << TX_NO_WITNESS(txs[i]); });
+        } else if (txs[i].HasWitness()) {
+            buffer([&] {
+                for (const auto part : StripWitness(txs[i], serialized[i])) data.insert(data.end(), part.begin(), part.end());
+            });
+        } else {
+            inputs.push_back(serialized[i]);
+        }
+    }
+    for (size_t i = 0; i < txs.size(); ++i) {
+        if (!txs[i].HasWitness()) continue;
+        if (serialized.empty()) {
+            buffer([&] { VectorWriter{data, data.size()} << TX_WITH_WITNESS(txs[i]); });
+        } else {
+            inputs.push_back(serialized[i]);
+        }
+    }
+    for (size_t k = 0; k < buffered.size(); ++k) {
+        const auto [index, begin]{buffered[k]};
+        const size_t end{k + 1 < buffered.size() ? buffered[k + 1].second : data.size()};
+        inputs[index] = Span{data}.subspan(begin, end - begin);
+    }
+    std::vector<unsigned char> hashes(inputs.size() * uint256::size());
+    SHA3_256d_Many(hashes.data(), inputs.data(), inputs.size());
+
+    std::vector<CTransactionRef> result;
+    result.reserve(txs.size());
+    size_t witness_index{txs.size()};
+    for (size_t i = 0; i < txs.size(); ++i) {
+        const Txid hash{Txid::FromUint256(uint256{Span{hashes}.subspan(i * uint256::size(), uint256::size())})};
+        const size_t witness_hash_index{txs[i].HasWitness() ? witness_index++ : i};
+        const Wtxid witness_hash{Wtxid::FromUint256(uint256{Span{hashes}.subspan(witness_hash_index * uint256::size(), uint256::size())})};
+        result.push_back(std::make_shared<const CTransaction>(std::move(txs[i]), hash, witness_hash));
+    }
+    return result;
+}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -10,9 +10,11 @@
 #include <consensus/amount.h>
 #include <script/script.h>
 #include <serialize.h>
+#include <span.h>
 #include <uint256.h>
 #include <util/transaction_identifier.h> // IWYU pragma: export
 
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <ios>
@@ -24,6 +26,8 @@
 #include <utility>
 #include <vector>
 
+class SpanReader;
+
 /** An outpoint - a combination of a transaction hash and an index n into its vout */
 class COutPoint
 {
@@ -319,10 +323,22 @@ private:
 
     bool ComputeHasWitness() const;
 
+    struct Decoded;
+    explicit CTransaction(Decoded&& decoded);
+    static Decoded Decode(const TransactionSerParams& params, SpanReader& reader);
+
 public:
     /** Convert a CMutableTransaction into a CTransaction. */
     explicit CTransaction(const CMutableTransaction& tx);
     explicit CTransaction(CMutableTransaction&& tx);
+    /** Convert a CMutableTransaction whose txid and wtxid were already computed, e.g. in a batch (see MakeTransactionRefs). */
+    CTransaction(CMutableTransaction&& tx, const Txid& hash, const Wtxid& witness_hash);
+    /**
+     * Deserialize from the bytes of a SpanReader and hash those bytes in place
+     * instead of serializing the transaction again. The txid of a witness
+     * serialization skips the marker, flag and witnesses.
+     */
+    CTransaction(const TransactionSerParams& params, SpanReader& reader);
 
     template <typename Stream>
     inline void Serialize(Stream& s) const {
@@ -423,6 +439,47 @@ struct CMutableTransaction
 typedef std::shared_ptr<const CTransaction> CTransactionRef;
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/**
+ * Convert transactions into CTransactions, computing all txids and wtxids in
+ * one multi-lane SHA3-256d pass rather than one transaction at a time.
+ * serialized optionally holds the bytes each transaction was deserialized
+ * from, which are then hashed in place instead of serializing again.
+ */
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs, Span<const Span<const unsigned char>> serialized = {});
+
+/**
+ * Formatter for the transactions of a block. Deserialization reads all of them
+ * before hashing them together with MakeTransactionRefs; serialization is the
+ * same as for a plain vector.
+ */
+struct BatchHashedTransactions {
+    template <typename Stream>
+    void Ser(Stream& s, const std::vector<CTransactionRef>& txs)
+    {
+        s << txs;
+    }
+
+    template <typename Stream>
+    void Unser(Stream& s, std::vector<CTransactionRef>& txs)
+    {
+        std::vector<CMutableTransaction> mtxs;
+        if constexpr (requires { { s.GetStream() } -> std::same_as<SpanReader&>; }) {
+            // Reading from memory: keep the bytes of each transaction to hash
+            auto& reader{s.GetStream()};
+            std::vector<Span<const unsigned char>> serialized;
+            for (uint64_t count{ReadCompactSize(s)}; count > 0; --count) {
+                const Span<const unsigned char> start{reader.data(), reader.size()};
+                mtxs.emplace_back(deserialize, s);
+                serialized.push_back(start.first(start.size() - reader.size()));
+            }
+            txs = MakeTransactionRefs(std::move(mtxs), serialized);
+        } else {
+            s >> mtxs;
+            txs = MakeTransactionRefs(std::move(mtxs));
+        }
+    }
+};
+
 /** A generic txid reference (txid or wtxid). */
 class GenTxid
 {
@@ -315,15 +315,16 @@ static bool rest_block(const std::any& context,
         pos = pblockindex->GetBlockPos();
     }
 
-    std::vector<uint8_t> block_data{};
-    if (!chainman.m_blockman.ReadRawBlockFromDisk(block_data, pos)) {
+    node::RawBlock raw_block;
+    if (!chainman.m_blockman.ReadRawBlockFromDisk(raw_block, pos)) {
         return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
+    const Span<const uint8_t> block_data{raw_block.Data()};
 
     switch (rf) {
     case RESTResponseFormat::BINARY: {
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, std::as_bytes(std::span{block_data}));
+        req->WriteReply(HTTP_OK, std::as_bytes(std::span{block_data.data(), block_data.size()}));
         return true;
     }
 
@@ -336,8 +337,7 @@ static bool rest_block(const std::any& context,
 
     case RESTResponseFormat::JSON: {
         CBlock block{};
-        DataStream block_stream{block_data};
-        block_stream >> TX_WITH_WITNESS(block);
+        SpanReader{block_data} >> TX_WITH_WITNESS(block);
         UniValue objBlock = blockToJSON(chainman.m_blockman, block, *tip, *pblockindex, tx_verbosity);
         std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -79,9 +79,14 @@ static CUpdatedBlock latestblock GUARDED_BY(cs_blockchange);
  */
 double GetDifficulty(const CBlockIndex& blockindex)
 {
-    int nShift = (blockindex.nBits >> 24) & 0xff;
+    return GetDifficulty(blockindex.nBits);
+}
+
+double GetDifficulty(uint32_t bits)
+{
+    int nShift = (bits >> 24) & 0xff;
     double dDiff =
-        (double)0x0000ffff / (double)(blockindex.nBits & 0x00ffffff);
+        (double)0x0000ffff / (double)(bits & 0x00ffffff);
 
     while (nShift < 29)
     {
@@ -35,6 +35,9 @@ static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
  */
 double GetDifficulty(const CBlockIndex& blockindex);
 
+/** Get the difficulty of the compact target bits of a block. */
+double GetDifficulty(uint32_t bits);
+
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(const CBlockIndex*);
 
@@ -34,12 +34,19 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "utxoupdatepsbt", 1, "descriptors" },
     { "generatetoaddress", 0, "nblocks" },
     { "generatetoaddress", 2, "maxtries" },
+    { "generatetoaddress", 3, "threads" },
     { "generatetodescriptor", 0, "num_blocks" },
     { "generatetodescriptor", 2, "maxtries" },
+    { "generatetodescriptor", 3, "threads" },
     { "generateblock", 1, "transactions" },
     { "generateblock", 2, "submit" },
+    { "generateblock", 3, "threads" },
+    { "getpowcacheinfo", 0, "compact" },
     { "getnetworkhashps", 0, "nblocks" },
     { "getnetworkhashps", 1, "height" },
+    { "getdifficultyhistory", 0, "nblocks" },
+    { "getdifficultyhistory", 1, "height" },
+    { "getdifficultyhistory", 2, "step" },
     { "sendtoaddress", 1, "amount" },
     { "sendtoaddress", 4, "subtractfeefromamount" },
     { "sendtoaddress", 5 , "replaceable" },
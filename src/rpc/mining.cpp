@@ -20,6 +20,7 @@
 #include <interfaces/mining.h>
 #include <key_io.h>
 #include <net.h>
+#include <node/chainstats.h>
 #include <node/context.h>
 #include <node/miner.h>
 #include <node/warnings.h>
@@ -43,6 +44,7 @@
 #include <validationinterface.h>
 
 #include <memory>
+#include <set>
 #include <stdint.h>
 
 using node::BlockAssembler;
@@ -50,59 +52,60 @@ using node::CBlockTemplate;
 using interfaces::Mining;
 using node::NodeContext;
 using node::RegenerateCommitments;
+using node::SolveBlock;
 using node::UpdateTime;
 using util::ToString;
 
+/** Per-height chain statistics, caught up with the active chain by each query. */
+static node::ChainStats g_chain_stats;
+
+static const node::ChainStats& GetChainStats(ChainstateManager& chainman)
+{
+    WITH_LOCK(cs_main, g_chain_stats.Update(chainman.ActiveChain()));
+    return g_chain_stats;
+}
+
+static double HashesPerSecond(const node::ChainStats::Range& range)
+{
+    // In case there's a situation where minTime == maxTime, we don't want a divide by zero exception.
+    if (range.min_time == range.max_time) return 0;
+    return range.work.getdouble() / (range.max_time - range.min_time);
+}
+
 /**
  * Return average network hashes per second based on the last 'lookup' blocks,
  * or from the last difficulty change if 'lookup' is -1.
  * If 'height' is -1, compute the estimate from current chain tip.
  * If 'height' is a valid block height, compute the estimate at the time when a given block was found.
  */
-static UniValue GetNetworkHashPS(int lookup, int height, const CChain& active_chain) {
+static UniValue GetNetworkHashPS(int lookup, int height, const node::ChainStats& stats) {
     if (lookup < -1 || lookup == 0) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid nblocks. Must be a positive number or -1.");
     }
 
-    if (height < -1 || height > active_chain.Height()) {
+    const int tip_height{stats.Height()};
+    if (height < -1 || height > tip_height) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block does not exist at specified height");
     }
 
-    const CBlockIndex* pb = active_chain.Tip();
+    if (height == -1) height = tip_height;
 
-    if (height >= 0) {
-        pb = active_chain[height];
-    }
-
-    if (pb == nullptr || !pb->nHeight)
+    if (height <= 0)
         return 0;
 
     // If lookup is -1, then use blocks since last difficulty change.
     if (lookup == -1)
-        lookup = pb->nHeight % Params().GetConsensus().DifficultyAdjustmentInterval() + 1;
+        lookup = height % Params().GetConsensus().DifficultyAdjustmentInterval() + 1;
 
     // If lookup is larger than chain, then set it to chain length.
-    if (lookup > pb->nHeight)
-        lookup = pb->nHeight;
-
-    const CBlockIndex* pb0 = pb;
-    int64_t minTime = pb0->GetBlockTime();
-    int64_t maxTime = minTime;
-    for (int i = 0; i < lookup; i++) {
-        pb0 = pb0->pprev;
-        int64_t time = pb0->GetBlockTime();
-        minTime = std::min(time, minTime);
-        maxTime = std::max(time, maxTime);
-    }
-
-    // In case there's a situation where minTime == maxTime, we don't want a divide by zero exception.
-    if (minTime == maxTime)
-        return 0;
-
-    arith_uint256 workDiff = pb->nChainWork - pb0->nChainWork;
-    int64_t timeDiff = maxTime - minTime;
+    if (lookup > height)
+        lookup = height;
 
-    return workDiff.getdouble() / timeDiff;
+    const auto range{stats.GetRange(height - lookup, height)};
+    if (!range) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Chain changed during the request");
+    }
+    return HashesPerSecond(*range);
 }
 
 static RPCHelpMan getnetworkhashps()
@@ -124,27 +127,88 @@ static RPCHelpMan getnetworkhashps()
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
     ChainstateManager& chainman = EnsureAnyChainman(request.context);
-    LOCK(cs_main);
-    return GetNetworkHashPS(self.Arg<int>("nblocks"), self.Arg<int>("height"), chainman.ActiveChain());
+    return GetNetworkHashPS(self.Arg<int>("nblocks"), self.Arg<int>("height"), GetChainStats(chainman));
 },
     };
 }
 
-static bool GenerateBlock(ChainstateManager& chainman, Mining& miner, CBlock& block, uint64_t& max_tries, std::shared_ptr<const CBlock>& block_out, bool process_new_block)
+/** Maximum number of entries returned by getdifficultyhistory. */
+static constexpr int MAX_DIFFICULTY_HISTORY_ENTRIES{10000};
+
+static RPCHelpMan getdifficultyhistory()
+{
+    return RPCHelpMan{"getdifficultyhistory",
+                "\nReturns the difficulty and estimated network hashes per second over a range of blocks.\n"
+                "One entry is returned for every [step] blocks, ending at [height].\n",
+                {
+                    {"nblocks", RPCArg::Type::NUM, RPCArg::Default{120}, "The number of blocks to cover."},
+                    {"height", RPCArg::Type::NUM, RPCArg::Default{-1}, "The height of the last entry, or -1 for the current chain tip."},
+                    {"step", RPCArg::Type::NUM, RPCArg::Default{1}, "The number of blocks between two entries."},
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "Entries in increasing height order",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::NUM, "height", "The block height"},
+                            {RPCResult::Type::NUM_TIME, "time", "The block time expressed in " + UNIX_EPOCH_TIME},
+                            {RPCResult::Type::STR_HEX, "bits", "nBits: compact representation of the block difficulty target"},
+                            {RPCResult::Type::NUM, "difficulty", "The difficulty"},
+                            {RPCResult::Type::STR_HEX, "chainwork", "Expected number of hashes required to produce the chain up to this block (in hex)"},
+                            {RPCResult::Type::NUM, "networkhashps", "Hashes per second estimated over the blocks since the previous entry"},
+                        }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getdifficultyhistory", "")
+            + HelpExampleCli("getdifficultyhistory", "10080 -1 720")
+            + HelpExampleRpc("getdifficultyhistory", "10080, -1, 720")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    const int nblocks{self.Arg<int>("nblocks")};
+    const int step{self.Arg<int>("step")};
+    if (nblocks < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid nblocks. Must be a positive number.");
+    }
+    if (step < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid step. Must be a positive number.");
+    }
+    if ((nblocks - 1) / step + 1 > MAX_DIFFICULTY_HISTORY_ENTRIES) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Too many entries requested, use a step of at least %d", (nblocks - 1) / MAX_DIFFICULTY_HISTORY_ENTRIES + 1));
+    }
+
+    const node::ChainStats& stats{GetChainStats(EnsureAnyChainman(request.context))};
+    int height{self.Arg<int>("height")};
+    const int tip_height{stats.Height()};
+    if (height < -1 || height > tip_height) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block does not exist at specified height");
+    }
+    if (height == -1) height = tip_height;
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : stats.GetEntries(std::max(height - nblocks + 1, 0), height, step)) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", entry.height);
+        obj.pushKV("time", entry.time);
+        obj.pushKV("bits", strprintf("%08x", entry.bits));
+        obj.pushKV("difficulty", GetDifficulty(entry.bits));
+        obj.pushKV("chainwork", ArithToUint256(entry.chain_work).GetHex());
+        obj.pushKV("networkhashps", HashesPerSecond(entry.window));
+        result.push_back(std::move(obj));
+    }
+    return result;
+},
+    };
+}
+
+static bool GenerateBlock(ChainstateManager& chainman, Mining& miner, CBlock& block, uint64_t& max_tries, int threads, std::shared_ptr<const CBlock>& block_out, bool process_new_block)
 {
     block_out.reset();
     block.hashMerkleRoot = BlockMerkleRoot(block);
 
-    while (max_tries > 0 && block.nNonce < std::numeric_limits<uint32_t>::max() && !CheckProofOfWork(block.GetPoWHash(), block.nBits, chainman.GetConsensus()) && !chainman.m_interrupt) {
-        ++block.nNonce;
-        --max_tries;
-    }
-    if (max_tries == 0 || chainman.m_interrupt) {
+    if (!SolveBlock(block, chainman.GetConsensus(), max_tries, threads, chainman.m_interrupt)) {
         return false;
     }
-    if (block.nNonce == std::numeric_limits<uint32_t>::max()) {
-        return true;
-    }
 
     block_out = std::make_shared<const CBlock>(block);
 
@@ -157,7 +221,17 @@ static bool GenerateBlock(ChainstateManager& chainman, Mining& miner, CBlock& bl
     return true;
 }
 
-static UniValue generateBlocks(ChainstateManager& chainman, Mining& miner, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries)
+static int ParseMiningThreads(const UniValue& param)
+{
+    if (param.isNull()) return DEFAULT_MINING_THREADS;
+    const int threads{param.getInt<int>()};
+    if (threads < 1 || threads > MAX_MINING_THREADS) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("threads must be between 1 and %d", MAX_MINING_THREADS));
+    }
+    return threads;
+}
+
+static UniValue generateBlocks(ChainstateManager& chainman, Mining& miner, const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries, int threads)
 {
     UniValue blockHashes(UniValue::VARR);
     while (nGenerate > 0 && !chainman.m_interrupt) {
@@ -166,7 +240,7 @@ static UniValue generateBlocks(ChainstateManager& chainman, Mining& miner, const
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Couldn't create new block");
 
         std::shared_ptr<const CBlock> block_out;
-        if (!GenerateBlock(chainman, miner, pblocktemplate->block, nMaxTries, block_out, /*process_new_block=*/true)) {
+        if (!GenerateBlock(chainman, miner, pblocktemplate->block, nMaxTries, threads, block_out, /*process_new_block=*/true)) {
             break;
         }
 
@@ -221,6 +295,7 @@ static RPCHelpMan generatetodescriptor()
             {"num_blocks", RPCArg::Type::NUM, RPCArg::Optional::NO, "How many blocks are generated."},
             {"descriptor", RPCArg::Type::STR, RPCArg::Optional::NO, "The descriptor to send the newly generated kylacoin to."},
             {"maxtries", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_MAX_TRIES}, "How many iterations to try."},
+            {"threads", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_MINING_THREADS}, "How many threads to split the nonce search across."},
         },
         RPCResult{
             RPCResult::Type::ARR, "", "hashes of blocks generated",
@@ -234,6 +309,7 @@ static RPCHelpMan generatetodescriptor()
 {
     const auto num_blocks{self.Arg<int>("num_blocks")};
     const auto max_tries{self.Arg<uint64_t>("maxtries")};
+    const auto threads{ParseMiningThreads(request.params[3])};
 
     CScript coinbase_script;
     std::string error;
@@ -245,7 +321,7 @@ static RPCHelpMan generatetodescriptor()
     Mining& miner = EnsureMining(node);
     ChainstateManager& chainman = EnsureChainman(node);
 
-    return generateBlocks(chainman, miner, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, miner, coinbase_script, num_blocks, max_tries, threads);
 },
     };
 }
@@ -265,6 +341,7 @@ static RPCHelpMan generatetoaddress()
              {"nblocks", RPCArg::Type::NUM, RPCArg::Optional::NO, "How many blocks are generated."},
              {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to send the newly generated kylacoin to."},
              {"maxtries", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_MAX_TRIES}, "How many iterations to try."},
+             {"threads", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_MINING_THREADS}, "How many threads to split the nonce search across."},
          },
          RPCResult{
              RPCResult::Type::ARR, "", "hashes of blocks generated",
@@ -281,6 +358,7 @@ static RPCHelpMan generatetoaddress()
 {
     const int num_blocks{request.params[0].getInt<int>()};
     const uint64_t max_tries{request.params[2].isNull() ? DEFAULT_MAX_TRIES : request.params[2].getInt<int>()};
+    const int threads{ParseMiningThreads(request.params[3])};
 
     CTxDestination destination = DecodeDestination(request.params[1].get_str());
     if (!IsValidDestination(destination)) {
@@ -293,7 +371,7 @@ static RPCHelpMan generatetoaddress()
 
     CScript coinbase_script = GetScriptForDestination(destination);
 
-    return generateBlocks(chainman, miner, coinbase_script, num_blocks, max_tries);
+    return generateBlocks(chainman, miner, coinbase_script, num_blocks, max_tries, threads);
 },
     };
 }
@@ -312,6 +390,7 @@ static RPCHelpMan generateblock()
                 },
             },
             {"submit", RPCArg::Type::BOOL, RPCArg::Default{true}, "Whether to submit the block before the RPC call returns or to return it as hex."},
+            {"threads", RPCArg::Type::NUM, RPCArg::Default{DEFAULT_MINING_THREADS}, "How many threads to split the nonce search across."},
         },
         RPCResult{
             RPCResult::Type::OBJ, "", "",
@@ -366,6 +445,7 @@ static RPCHelpMan generateblock()
     }
 
     const bool process_new_block{request.params[2].isNull() ? true : request.params[2].get_bool()};
+    const int threads{ParseMiningThreads(request.params[3])};
     CBlock block;
 
     ChainstateManager& chainman = EnsureChainman(node);
@@ -394,7 +474,7 @@ static RPCHelpMan generateblock()
     std::shared_ptr<const CBlock> block_out;
     uint64_t max_tries{DEFAULT_MAX_TRIES};
 
-    if (!GenerateBlock(chainman, miner, block, max_tries, block_out, process_new_block) || !block_out) {
+    if (!GenerateBlock(chainman, miner, block, max_tries, threads, block_out, process_new_block) || !block_out) {
         throw JSONRPCError(RPC_MISC_ERROR, "Failed to make block.");
     }
 
@@ -410,6 +490,22 @@ static RPCHelpMan generateblock()
     };
 }
 
+/**
+ * Last getblocktemplate result. Only the header time (and with it the target on
+ * chains allowing min-difficulty blocks) changes between calls for the same
+ * template and client rules, so the transaction list is not rendered again.
+ */
+struct BlockTemplateResultCache {
+    uint256 tip;
+    //! Mempool sequence the template was created at
+    uint64_t mempool_sequence{0};
+    std::set<std::string> rules;
+    UniValue result;
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+static BlockTemplateResultCache g_template_result_cache GUARDED_BY(cs_main);
+
 static RPCHelpMan getmininginfo()
 {
     return RPCHelpMan{"getmininginfo",
@@ -424,6 +520,11 @@ static RPCHelpMan getmininginfo()
                         {RPCResult::Type::NUM, "difficulty", "The current difficulty"},
                         {RPCResult::Type::NUM, "networkhashps", "The network hashes per second"},
                         {RPCResult::Type::NUM, "pooledtx", "The size of the mempool"},
+                        {RPCResult::Type::OBJ, "templatecache", "Reuse of getblocktemplate results for an unchanged template",
+                        {
+                            {RPCResult::Type::NUM, "hits", "Results served from the cache"},
+                            {RPCResult::Type::NUM, "misses", "Results rendered from a template"},
+                        }},
                         {RPCResult::Type::STR, "chain", "current network name (" LIST_CHAIN_NAMES ")"},
                         (IsDeprecatedRPCEnabled("warnings") ?
                             RPCResult{RPCResult::Type::STR, "warnings", "any network and blockchain warnings (DEPRECATED)"} :
@@ -453,6 +554,10 @@ static RPCHelpMan getmininginfo()
     obj.pushKV("difficulty", GetDifficulty(*CHECK_NONFATAL(active_chain.Tip())));
     obj.pushKV("networkhashps",    getnetworkhashps().HandleRequest(request));
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
+    UniValue template_cache(UniValue::VOBJ);
+    template_cache.pushKV("hits", g_template_result_cache.hits);
+    template_cache.pushKV("misses", g_template_result_cache.misses);
+    obj.pushKV("templatecache", std::move(template_cache));
     obj.pushKV("chain", chainman.GetParams().GetChainTypeString());
     obj.pushKV("warnings", node::GetWarningsForRpc(*CHECK_NONFATAL(node.warnings), IsDeprecatedRPCEnabled("warnings")));
     return obj;
@@ -801,6 +906,7 @@ static RPCHelpMan getblocktemplate()
     static CBlockIndex* pindexPrev;
     static int64_t time_start;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    static uint64_t template_sequence;
     if (!pindexPrev || pindexPrev->GetBlockHash() != tip ||
         (miner.getTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - time_start > 5))
     {
@@ -809,6 +915,7 @@ static RPCHelpMan getblocktemplate()
 
         // Store the pindexBest used before createNewBlock, to avoid races
         nTransactionsUpdatedLast = miner.getTransactionsUpdated();
+        template_sequence = node.mempool ? WITH_LOCK(node.mempool->cs, return node.mempool->GetSequence()) : 0;
         CBlockIndex* pindexPrevNew = chainman.m_blockman.LookupBlockIndex(tip);
         time_start = GetTime();
 
@@ -829,6 +936,16 @@ static RPCHelpMan getblocktemplate()
     UpdateTime(pblock, consensusParams, pindexPrev);
     pblock->nNonce = 0;
 
+    BlockTemplateResultCache& cache{g_template_result_cache};
+    if (cache.result.isObject() && cache.tip == tip && cache.mempool_sequence == template_sequence && cache.rules == setClientRules) {
+        ++cache.hits;
+        UniValue result{cache.result};
+        result.pushKV("target", arith_uint256().SetCompact(pblock->nBits).GetHex());
+        result.pushKV("curtime", pblock->GetBlockTime());
+        result.pushKV("bits", strprintf("%08x", pblock->nBits));
+        return result;
+    }
+
     // NOTE: If at some point we support pre-segwit miners post-segwit-activation, this needs to take segwit support into consideration
     const bool fPreSegWit = !DeploymentActiveAfter(pindexPrev, chainman, Consensus::DEPLOYMENT_SEGWIT);
 
@@ -988,6 +1105,11 @@ static RPCHelpMan getblocktemplate()
         result.pushKV("default_witness_commitment", HexStr(pblocktemplate->vchCoinbaseCommitment));
     }
 
+    ++cache.misses;
+    cache.tip = tip;
+    cache.mempool_sequence = template_sequence;
+    cache.rules = setClientRules;
+    cache.result = result;
     return result;
 },
     };
@@ -1126,6 +1248,7 @@ void RegisterMiningRPCCommands(CRPCTable& t)
 {
     static const CRPCCommand commands[]{
         {"mining", &getnetworkhashps},
+        {"mining", &getdifficultyhistory},
         {"mining", &getmininginfo},
         {"mining", &prioritisetransaction},
         {"mining", &getprioritisedtransactions},
@@ -7,5 +7,8 @@
 
 /** Default max iterations to try in RPC generatetodescriptor, generatetoaddress, and generateblock. */
 static const uint64_t DEFAULT_MAX_TRIES{1000000};
+/** Default and maximum number of threads searching nonces in the same RPCs. */
+static const int DEFAULT_MINING_THREADS{1};
+static const int MAX_MINING_THREADS{64};
 
 #endif // BITCOIN_RPC_MINING_H
@@ -17,6 +17,7 @@
 #include <kernel/cs_main.h>
 #include <logging.h>
 #include <node/context.h>
+#include <pow_cache.h>
 #include <rpc/server.h>
 #include <rpc/server_util.h>
 #include <rpc/util.h>
@@ -118,6 +119,34 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCPowCacheInfo()
+{
+    const PowCache::Stats stats{PowCache::Instance().GetStats()};
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(stats.entries));
+    obj.pushKV("capacity", uint64_t(stats.capacity));
+    obj.pushKV("usage", uint64_t(stats.usage));
+    obj.pushKV("file_records", uint64_t(stats.file_records));
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    const uint64_t lookups{stats.hits + stats.misses};
+    obj.pushKV("hit_rate", lookups ? double(stats.hits) / lookups : 0.0);
+    return obj;
+}
+
+static std::vector<RPCResult> PowCacheInfoDescription()
+{
+    return {
+        {RPCResult::Type::NUM, "entries", "Number of cached hashes"},
+        {RPCResult::Type::NUM, "capacity", "Maximum number of cached hashes"},
+        {RPCResult::Type::NUM, "usage", "Number of bytes allocated for the cache"},
+        {RPCResult::Type::NUM, "file_records", "Number of records in the cache file, including evicted entries not compacted away yet"},
+        {RPCResult::Type::NUM, "hits", "Number of lookups answered from the cache"},
+        {RPCResult::Type::NUM, "misses", "Number of lookups that had to compute the hash"},
+        {RPCResult::Type::NUM, "hit_rate", "Fraction of lookups answered from the cache"},
+    };
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -162,6 +191,7 @@ static RPCHelpMan getmemoryinfo()
                                 {RPCResult::Type::NUM, "chunks_used", "Number allocated chunks"},
                                 {RPCResult::Type::NUM, "chunks_free", "Number unused chunks"},
                             }},
+                            {RPCResult::Type::OBJ, "powcache", "Information about the Flex proof-of-work cache", PowCacheInfoDescription()},
                         }
                     },
                     RPCResult{"mode \"mallocinfo\"",
@@ -178,6 +208,7 @@ static RPCHelpMan getmemoryinfo()
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("powcache", RPCPowCacheInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -210,6 +241,33 @@ static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     }
 }
 
+static RPCHelpMan getpowcacheinfo()
+{
+    return RPCHelpMan{"getpowcacheinfo",
+                "Returns the size and hit rate of the Flex proof-of-work cache, optionally compacting its file first.\n",
+                {
+                    {"compact", RPCArg::Type::BOOL, RPCArg::Default{false}, "Rewrite the cache file with only the entries still in memory."},
+                },
+                RPCResult{RPCResult::Type::OBJ, "", "", PowCacheInfoDescription()},
+                RPCExamples{
+                    HelpExampleCli("getpowcacheinfo", "")
+            + HelpExampleCli("getpowcacheinfo", "true")
+            + HelpExampleRpc("getpowcacheinfo", "true")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (self.Arg<bool>("compact")) {
+        PowCache& cache{PowCache::Instance()};
+        cache.Flush();
+        if (!cache.Compact()) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Unable to compact the PoW cache file");
+        }
+    }
+    return RPCPowCacheInfo();
+},
+    };
+}
+
 static RPCHelpMan logging()
 {
     return RPCHelpMan{"logging",
@@ -404,6 +462,7 @@ void RegisterNodeRPCCommands(CRPCTable& t)
 {
     static const CRPCCommand commands[]{
         {"control", &getmemoryinfo},
+        {"control", &getpowcacheinfo},
         {"control", &logging},
         {"util", &getindexinfo},
         {"hidden", &setmocktime},
@@ -115,6 +115,8 @@ public:
         return (*this);
     }
 
+    //! Start of the data not read yet
+    const unsigned char* data() const { return m_data.data(); }
     size_t size() const { return m_data.size(); }
     bool empty() const { return m_data.empty(); }
 
@@ -0,0 +1,128 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompression.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+#include <util/fs.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+/** Data that compresses: random bytes out of a small alphabet, with runs of a fixed pattern. */
+std::vector<uint8_t> MakeRecord(FastRandomContext& rng, size_t size)
+{
+    std::vector<uint8_t> data;
+    while (data.size() < size) {
+        if (rng.randbool()) {
+            for (uint8_t byte : {0x76, 0xa9, 0x14, 0xff, 0xff, 0xff, 0xff, 0x00}) data.push_back(byte);
+        } else {
+            data.push_back(rng.randrange(4));
+        }
+    }
+    data.resize(size);
+    return data;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(blockcompression_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockcompression_roundtrip)
+{
+    for (int i = 0; i < 200; ++i) {
+        const std::vector<uint8_t> data{MakeRecord(g_insecure_rand_ctx, g_insecure_rand_ctx.randrange(5000))};
+        const std::vector<uint8_t> dictionary{MakeRecord(g_insecure_rand_ctx, g_insecure_rand_ctx.randrange(1000))};
+        for (const auto& dict : {std::vector<uint8_t>{}, dictionary}) {
+            const auto compressed{CompressWithDictionary(data, dict)};
+            const auto decompressed{DecompressWithDictionary(compressed, dict, data.size())};
+            BOOST_REQUIRE(decompressed);
+            BOOST_CHECK(*decompressed == data);
+            // The decompressed size must match exactly
+            BOOST_CHECK(!DecompressWithDictionary(compressed, dict, data.size() + 1));
+            if (!data.empty()) {
+                BOOST_CHECK(!DecompressWithDictionary(compressed, dict, data.size() - 1));
+                BOOST_CHECK(!DecompressWithDictionary(Span{compressed}.first(compressed.size() - 1), dict, data.size()));
+            }
+        }
+    }
+
+    // Random bytes do not compress, but still round trip
+    const std::vector<uint8_t> random{g_insecure_rand_ctx.randbytes(10000)};
+    BOOST_CHECK(*DecompressWithDictionary(CompressWithDictionary(random, {}), {}, random.size()) == random);
+
+    // Matches reaching before the start of the data need a dictionary
+    const std::vector<uint8_t> dictionary(100, 0x42);
+    const std::vector<uint8_t> data(100, 0x42);
+    const auto compressed{CompressWithDictionary(data, dictionary)};
+    BOOST_CHECK_LT(compressed.size(), CompressWithDictionary(data, {}).size());
+    BOOST_CHECK(*DecompressWithDictionary(compressed, dictionary, data.size()) == data);
+    BOOST_CHECK(!DecompressWithDictionary(compressed, {}, data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(blockcompression_train_dictionary)
+{
+    std::vector<std::vector<uint8_t>> records;
+    for (int i = 0; i < 50; ++i) records.push_back(MakeRecord(g_insecure_rand_ctx, 2000));
+    const std::vector<Span<const uint8_t>> samples{records.begin(), records.end()};
+
+    const auto dictionary{TrainDictionary(samples, 1000)};
+    BOOST_CHECK(!dictionary.empty());
+    BOOST_CHECK_LE(dictionary.size(), 1000U);
+
+    // The dictionary helps with small records like the samples
+    const std::vector<uint8_t> record{MakeRecord(g_insecure_rand_ctx, 200)};
+    BOOST_CHECK_LT(CompressWithDictionary(record, dictionary).size(), CompressWithDictionary(record, {}).size());
+
+    BOOST_CHECK(TrainDictionary({}, 1000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(blockcompression_compressor_dictionaries)
+{
+    const fs::path dir{m_args.GetDataDirBase() / "compression"};
+    fs::create_directories(dir);
+    const std::vector<std::byte> xor_key{g_insecure_rand_ctx.randbytes<std::byte>(8)};
+
+    std::vector<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> records;
+    {
+        BlockFileCompressor compressor{dir, "blk", xor_key, /*sample_bytes=*/10000, /*retrain_bytes=*/50000};
+        BOOST_CHECK_EQUAL(compressor.CurrentDictionary(), 0U);
+        for (int i = 0; i < 100; ++i) {
+            auto record{MakeRecord(g_insecure_rand_ctx, 1000)};
+            auto payload{compressor.Compress(record)};
+            BOOST_REQUIRE(!payload.empty());
+            BOOST_CHECK_LT(payload.size(), record.size());
+            records.emplace_back(std::move(record), std::move(payload));
+        }
+        // Trained once enough records were sampled, then again after retrain_bytes
+        BOOST_CHECK_EQUAL(compressor.CurrentDictionary(), 2U);
+        BOOST_CHECK(fs::exists(dir / "blkdict00001.dat"));
+        BOOST_CHECK(fs::exists(dir / "blkdict00002.dat"));
+
+        // Records that do not get smaller are left uncompressed
+        BOOST_CHECK(compressor.Compress(g_insecure_rand_ctx.randbytes(1000)).empty());
+    }
+
+    // Dictionaries are read back from disk, and new records keep using the last one
+    const BlockFileCompressor compressor{dir, "blk", xor_key};
+    BOOST_CHECK_EQUAL(compressor.CurrentDictionary(), 2U);
+    for (const auto& [record, payload] : records) {
+        const auto decompressed{compressor.Decompress(payload)};
+        BOOST_REQUIRE(decompressed);
+        BOOST_CHECK(*decompressed == record);
+    }
+
+    // A payload whose dictionary is missing cannot be decompressed
+    const BlockFileCompressor other{dir, "rev", xor_key};
+    BOOST_CHECK_EQUAL(other.CurrentDictionary(), 0U);
+    BOOST_CHECK(!other.Decompress(records.back().second));
+    // Nor can one of an unknown version
+    auto payload{records.front().second};
+    payload[0] = COMPRESSED_RECORD_VERSION + 1;
+    BOOST_CHECK(!compressor.Decompress(payload));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
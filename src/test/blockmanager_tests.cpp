@@ -5,11 +5,13 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <clientversion.h>
+#include <consensus/validation.h>
 #include <node/blockstorage.h>
 #include <node/context.h>
 #include <node/kernel_notifications.h>
 #include <script/solver.h>
 #include <primitives/block.h>
+#include <undo.h>
 #include <util/chaintype.h>
 #include <validation.h>
 
@@ -198,4 +200,209 @@ BOOST_AUTO_TEST_CASE(blockmanager_flush_block_file)
     BOOST_CHECK_EQUAL(read_block.nVersion, 2);
 }
 
+BOOST_AUTO_TEST_CASE(blockmanager_read_block_expected_hash)
+{
+    KernelNotifications notifications{*Assert(m_node.shutdown), m_node.exit_status, *Assert(m_node.warnings)};
+    for (const bool paranoid : {false, true}) {
+        node::BlockManager::Options blockman_opts{
+            .chainparams = Params(),
+            .paranoid_block_reads = paranoid,
+            .blocks_dir = m_args.GetBlocksDirPath(),
+            .notifications = notifications,
+        };
+        BlockManager blockman{*Assert(m_node.shutdown), blockman_opts};
+
+        // A block without valid proof of work, as in blockmanager_flush_block_file
+        CBlock block;
+        block.nVersion = 1;
+        const FlatFilePos pos{blockman.SaveBlockToDisk(block, /*nHeight=*/1)};
+
+        CBlock read_block;
+        if (paranoid) {
+            ASSERT_DEBUG_LOG("ReadBlockFromDisk: Errors in block header");
+            BOOST_CHECK(!blockman.ReadBlockFromDisk(read_block, pos, block.GetHash()));
+        } else {
+            // The hash of an indexed header is trusted without recomputing its PoW
+            BOOST_CHECK(blockman.ReadBlockFromDisk(read_block, pos, block.GetHash()));
+            BOOST_CHECK(read_block.GetHash() == block.GetHash());
+        }
+        {
+            ASSERT_DEBUG_LOG("doesn't match index");
+            BOOST_CHECK(!blockman.ReadBlockFromDisk(read_block, pos, uint256::ONE));
+        }
+
+        // The proof-of-work hash stored in the index is kept with the block, so
+        // CheckBlock() checks it instead of recomputing it
+        if (paranoid) {
+            ASSERT_DEBUG_LOG("ReadBlockFromDisk: Errors in block header");
+            BOOST_CHECK(!blockman.ReadBlockFromDisk(read_block, pos, block.GetHash(), uint256::ZERO));
+        } else {
+            BlockValidationState state;
+            BOOST_CHECK(blockman.ReadBlockFromDisk(read_block, pos, block.GetHash()));
+            BOOST_CHECK(!CheckBlock(read_block, state, Params().GetConsensus()));
+            BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+
+            state = {};
+            BOOST_CHECK(blockman.ReadBlockFromDisk(read_block, pos, block.GetHash(), uint256::ZERO));
+            BOOST_CHECK(!CheckBlock(read_block, state, Params().GetConsensus()));
+            BOOST_CHECK(state.GetRejectReason() != "high-hash");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_mapped_block_files)
+{
+    KernelNotifications notifications{*Assert(m_node.shutdown), m_node.exit_status, *Assert(m_node.warnings)};
+    for (const bool use_xor : {false, true}) {
+        const fs::path blocks_dir{m_args.GetBlocksDirPath() / (use_xor ? "xor" : "plain")};
+        fs::create_directories(blocks_dir);
+        const BlockManager::Options file_opts{
+            .chainparams = Params(),
+            .use_xor = use_xor,
+            .fast_prune = true,
+            .blocks_dir = blocks_dir,
+            .notifications = notifications,
+        };
+        BlockManager file_blockman{*Assert(m_node.shutdown), file_opts};
+        BlockManager::Options mapped_opts{file_opts};
+        mapped_opts.max_mapped_block_files = 1;
+        BlockManager mapped_blockman{*Assert(m_node.shutdown), mapped_opts};
+
+        // Blocks spread over several small files that grow past their mapping
+        // while they are being read from
+        std::vector<std::pair<CBlock, FlatFilePos>> blocks;
+        const std::vector<unsigned char> script(20000, OP_TRUE);
+        for (int i = 0; i < 8; ++i) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back();
+            tx.vout.emplace_back(i, CScript{script.begin(), script.end()});
+            CBlock block;
+            block.nVersion = i;
+            block.vtx.push_back(MakeTransactionRef(tx));
+            blocks.emplace_back(block, file_blockman.SaveBlockToDisk(block, /*nHeight=*/i + 1));
+
+            for (const auto& [expected, pos] : blocks) {
+                DataStream expected_bytes;
+                expected_bytes << TX_WITH_WITNESS(expected);
+
+                node::RawBlock raw;
+                BOOST_REQUIRE(mapped_blockman.ReadRawBlockFromDisk(raw, pos));
+                DataStream served;
+                served << raw;
+                BOOST_CHECK_EQUAL(HexStr(served), HexStr(expected_bytes));
+                BOOST_CHECK_EQUAL(HexStr(raw.Data()), HexStr(expected_bytes));
+
+                CBlock read_block;
+                BOOST_CHECK(mapped_blockman.ReadBlockFromDisk(read_block, pos, expected.GetHash()));
+                BOOST_CHECK(read_block.vtx.at(0)->GetHash() == expected.vtx[0]->GetHash());
+            }
+        }
+        BOOST_CHECK_GT(blocks.back().second.nFile, 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_compressed_block_files)
+{
+    KernelNotifications notifications{*Assert(m_node.shutdown), m_node.exit_status, *Assert(m_node.warnings)};
+    const BlockManager::Options plain_opts{
+        .chainparams = Params(),
+        .blocks_dir = m_args.GetBlocksDirPath(),
+        .notifications = notifications,
+    };
+    BlockManager::Options compressed_opts{plain_opts};
+    compressed_opts.compress_blocks = true;
+    BlockManager blockman{*Assert(m_node.shutdown), compressed_opts};
+
+    // A block that compresses well, with a script small enough to be kept as
+    // it is in the undo data
+    const std::vector<unsigned char> script(MAX_SCRIPT_SIZE, OP_TRUE);
+    CMutableTransaction tx;
+    tx.vin.emplace_back();
+    tx.vout.emplace_back(1, CScript{script.begin(), script.end()});
+    CBlock block;
+    block.nVersion = 1;
+    block.vtx.push_back(MakeTransactionRef(tx));
+    const FlatFilePos pos{blockman.SaveBlockToDisk(block, /*nHeight=*/1)};
+    BOOST_CHECK_LT(blockman.CalculateCurrentUsage(), ::GetSerializeSize(TX_WITH_WITNESS(block)) / 10);
+
+    // Compressed blocks are read back whether or not new blocks are stored
+    // compressed, with file I/O or from mapped files
+    BlockManager plain_blockman{*Assert(m_node.shutdown), plain_opts};
+    BlockManager::Options mapped_opts{plain_opts};
+    mapped_opts.max_mapped_block_files = 1;
+    BlockManager mapped_blockman{*Assert(m_node.shutdown), mapped_opts};
+    DataStream expected_bytes;
+    expected_bytes << TX_WITH_WITNESS(block);
+    for (const BlockManager* reader : {&blockman, &plain_blockman, &mapped_blockman}) {
+        CBlock read_block;
+        BOOST_CHECK(reader->ReadBlockFromDisk(read_block, pos, block.GetHash()));
+        BOOST_CHECK(read_block.vtx.at(0)->GetHash() == block.vtx[0]->GetHash());
+
+        std::vector<uint8_t> raw;
+        BOOST_CHECK(reader->ReadRawBlockFromDisk(raw, pos));
+        BOOST_CHECK_EQUAL(HexStr(raw), HexStr(expected_bytes));
+        node::RawBlock raw_block;
+        BOOST_CHECK(reader->ReadRawBlockFromDisk(raw_block, pos));
+        BOOST_CHECK_EQUAL(HexStr(raw_block.Data()), HexStr(expected_bytes));
+    }
+
+    // Undo data is compressed as well
+    CBlockUndo blockundo;
+    blockundo.vtxundo.emplace_back().vprevout.emplace_back(tx.vout[0], /*nHeightIn=*/1, /*fCoinBaseIn=*/false);
+    LOCK(::cs_main);
+    const uint256 prev_hash{block.GetHash()};
+    CBlockIndex prev;
+    prev.phashBlock = &prev_hash;
+    CBlockIndex index;
+    index.pprev = &prev;
+    index.nHeight = 2;
+    index.nFile = pos.nFile;
+    BlockValidationState state;
+    const uint64_t usage_before_undo{blockman.CalculateCurrentUsage()};
+    BOOST_CHECK(blockman.WriteUndoDataForBlock(blockundo, state, index));
+    BOOST_CHECK_LT(blockman.CalculateCurrentUsage() - usage_before_undo, ::GetSerializeSize(blockundo) / 10);
+    CBlockUndo read_undo;
+    BOOST_CHECK(plain_blockman.UndoReadFromDisk(read_undo, index));
+    BOOST_REQUIRE_EQUAL(read_undo.vtxundo.size(), 1U);
+    BOOST_CHECK(read_undo.vtxundo[0].vprevout.at(0).out == tx.vout[0]);
+}
+
+BOOST_AUTO_TEST_CASE(blockmanager_pow_hash_serialization)
+{
+    LOCK(::cs_main);
+    CBlockIndex index;
+    index.nHeight = 10;
+    index.nVersion = 0x20008000;
+    index.nBits = 0x1e0ffff0;
+    index.hashPoW = uint256S("00000abcdef0123456789abcdef0123456789abcdef0123456789abcdef01234");
+    index.nStatus = BLOCK_VALID_TREE | BLOCK_HAVE_POW_HASH;
+    BOOST_CHECK(index.GetPoWHash() == index.hashPoW);
+
+    // The PoW hash survives a round trip through the block index format
+    DataStream ss{};
+    ss << CDiskBlockIndex{&index};
+    CDiskBlockIndex loaded;
+    ss >> loaded;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(loaded.nStatus & BLOCK_HAVE_POW_HASH);
+    BOOST_CHECK(loaded.hashPoW == index.hashPoW);
+    BOOST_CHECK(loaded.GetPoWHash() == index.hashPoW);
+
+    // An entry rewritten by an older client keeps the status flag but not the
+    // hash; the flag must then be ignored rather than misparse the entry.
+    int old_version{259900};
+    int height{index.nHeight};
+    uint32_t status{index.nStatus};
+    unsigned int tx{0};
+    uint256 prev{};
+    ss << VARINT_MODE(old_version, VarIntMode::NONNEGATIVE_SIGNED) << VARINT_MODE(height, VarIntMode::NONNEGATIVE_SIGNED)
+       << VARINT(status) << VARINT(tx) << index.nVersion << prev << index.hashMerkleRoot << index.nTime << index.nBits << index.nNonce;
+    CDiskBlockIndex legacy;
+    ss >> legacy;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(!(legacy.nStatus & BLOCK_HAVE_POW_HASH));
+    BOOST_CHECK(legacy.nStatus & BLOCK_VALID_TREE);
+    BOOST_CHECK(!legacy.GetPoWHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,78 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <net.h>
+#include <node/blockmessagecache.h>
+#include <protocol.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using node::BlockMessageCache;
+using node::BlockWireFormat;
+
+namespace {
+CSerializedNetMsg MakeMessage(size_t size, unsigned char fill)
+{
+    CSerializedNetMsg msg;
+    msg.m_type = NetMsgType::BLOCK;
+    msg.data.assign(size, fill);
+    return msg;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(blockmessagecache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockmessagecache_lru)
+{
+    const size_t msg_usage{MakeMessage(1000, 0).GetMemoryUsage()};
+    BlockMessageCache cache{3 * msg_usage};
+    const uint256 a{InsecureRand256()}, b{InsecureRand256()}, c{InsecureRand256()};
+
+    BOOST_CHECK(!cache.Get(a, BlockWireFormat::BLOCK));
+    cache.Put(a, BlockWireFormat::BLOCK, MakeMessage(1000, 1));
+    cache.Put(a, BlockWireFormat::WITNESS_BLOCK, MakeMessage(1000, 2));
+    cache.Put(b, BlockWireFormat::WITNESS_BLOCK, MakeMessage(1000, 3));
+    BOOST_CHECK_EQUAL(cache.Usage(), 3 * msg_usage);
+
+    // Formats of the same block are cached separately
+    const auto block_msg{cache.Get(a, BlockWireFormat::BLOCK)};
+    BOOST_REQUIRE(block_msg);
+    BOOST_CHECK_EQUAL(block_msg->data.at(0), 1);
+    BOOST_CHECK_EQUAL(block_msg->m_type, NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(cache.Get(a, BlockWireFormat::WITNESS_BLOCK)->data.at(0), 2);
+    BOOST_CHECK(!cache.Get(a, BlockWireFormat::CMPCT_BLOCK));
+
+    // The least recently used message makes room, while a reader still holds it
+    const auto evicted{cache.Get(b, BlockWireFormat::WITNESS_BLOCK)};
+    cache.Get(a, BlockWireFormat::BLOCK);
+    cache.Get(a, BlockWireFormat::WITNESS_BLOCK);
+    cache.Put(c, BlockWireFormat::CMPCT_BLOCK, MakeMessage(1000, 4));
+    BOOST_CHECK(!cache.Get(b, BlockWireFormat::WITNESS_BLOCK));
+    BOOST_CHECK_EQUAL(evicted->data.at(0), 3);
+    BOOST_CHECK(cache.Get(c, BlockWireFormat::CMPCT_BLOCK));
+    BOOST_CHECK_EQUAL(cache.Usage(), 3 * msg_usage);
+
+    // Replacing a message keeps a single entry
+    cache.Put(c, BlockWireFormat::CMPCT_BLOCK, MakeMessage(1000, 5));
+    BOOST_CHECK_EQUAL(cache.Get(c, BlockWireFormat::CMPCT_BLOCK)->data.at(0), 5);
+    BOOST_CHECK_EQUAL(cache.Usage(), 3 * msg_usage);
+
+    // A message over the limit is not cached and evicts nothing
+    cache.Put(b, BlockWireFormat::BLOCK, MakeMessage(4000, 6));
+    BOOST_CHECK(!cache.Get(b, BlockWireFormat::BLOCK));
+    BOOST_CHECK_EQUAL(cache.Usage(), 3 * msg_usage);
+
+    // A larger message evicts as many as needed
+    cache.Put(b, BlockWireFormat::BLOCK, MakeMessage(2000, 7));
+    BOOST_CHECK(cache.Get(b, BlockWireFormat::BLOCK));
+    BOOST_CHECK(cache.Get(c, BlockWireFormat::CMPCT_BLOCK));
+    BOOST_CHECK(!cache.Get(a, BlockWireFormat::BLOCK));
+    BOOST_CHECK(!cache.Get(a, BlockWireFormat::WITNESS_BLOCK));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,107 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <node/chainstats.h>
+#include <pow.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <deque>
+
+using node::ChainStats;
+
+namespace {
+struct TestBlocks {
+    std::deque<uint256> hashes;
+    std::deque<CBlockIndex> blocks;
+
+    CBlockIndex& Extend(CBlockIndex* prev)
+    {
+        CBlockIndex& block{blocks.emplace_back()};
+        block.phashBlock = &hashes.emplace_back(InsecureRand256());
+        block.pprev = prev;
+        block.nHeight = prev ? prev->nHeight + 1 : 0;
+        // Block times are only roughly increasing
+        block.nTime = 1700000000 + block.nHeight * 60 + InsecureRandRange(600);
+        block.nBits = 0x1d00ffff - InsecureRandRange(0x10000);
+        block.nChainWork = (prev ? prev->nChainWork : arith_uint256{0}) + GetBlockProof(block);
+        return block;
+    }
+};
+
+void CheckRanges(const ChainStats& stats, const CChain& chain)
+{
+    BOOST_REQUIRE_EQUAL(stats.Height(), chain.Height());
+    for (int i = 0; i < 200; ++i) {
+        const int last = InsecureRandRange(chain.Height() + 1);
+        const int first = InsecureRandRange(last + 1);
+        const auto range{stats.GetRange(first, last)};
+        BOOST_REQUIRE(range);
+        int64_t min_time{chain[first]->GetBlockTime()}, max_time{min_time};
+        for (int height = first; height <= last; ++height) {
+            min_time = std::min(min_time, chain[height]->GetBlockTime());
+            max_time = std::max(max_time, chain[height]->GetBlockTime());
+        }
+        BOOST_CHECK(range->work == chain[last]->nChainWork - chain[first]->nChainWork);
+        BOOST_CHECK_EQUAL(range->min_time, min_time);
+        BOOST_CHECK_EQUAL(range->max_time, max_time);
+    }
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(chainstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(chainstats_follow_chain)
+{
+    LOCK(::cs_main);
+    TestBlocks test;
+    CBlockIndex* tip{nullptr};
+    for (int i = 0; i < 1000; ++i) tip = &test.Extend(tip);
+    CChain chain;
+    chain.SetTip(*tip);
+
+    ChainStats stats;
+    BOOST_CHECK_EQUAL(stats.Height(), -1);
+    BOOST_CHECK(!stats.GetRange(0, 0));
+    stats.Update(chain);
+    CheckRanges(stats, chain);
+    BOOST_CHECK(!stats.GetRange(0, 1000));
+    BOOST_CHECK(!stats.GetRange(5, 4));
+
+    const auto entries{stats.GetEntries(10, 999, 100)};
+    BOOST_REQUIRE_EQUAL(entries.size(), 10U);
+    BOOST_CHECK_EQUAL(entries.front().height, 99);
+    BOOST_CHECK_EQUAL(entries.back().height, 999);
+    for (const auto& entry : entries) {
+        BOOST_CHECK_EQUAL(entry.time, chain[entry.height]->GetBlockTime());
+        BOOST_CHECK_EQUAL(entry.bits, chain[entry.height]->nBits);
+        BOOST_CHECK(entry.chain_work == chain[entry.height]->nChainWork);
+        BOOST_CHECK(entry.window.work == entry.chain_work - chain[std::max(entry.height - 100, 0)]->nChainWork);
+    }
+
+    // A reorg to a longer fork only replaces the blocks after the fork point
+    CBlockIndex* fork{chain[600]};
+    for (int i = 0; i < 517; ++i) fork = &test.Extend(fork);
+    chain.SetTip(*fork);
+    stats.Update(chain);
+    CheckRanges(stats, chain);
+
+    // Back to a shorter chain, then growing one block at a time
+    tip = chain[300];
+    chain.SetTip(*tip);
+    stats.Update(chain);
+    CheckRanges(stats, chain);
+    for (int i = 0; i < 50; ++i) {
+        tip = &test.Extend(tip);
+        chain.SetTip(*tip);
+        stats.Update(chain);
+    }
+    CheckRanges(stats, chain);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
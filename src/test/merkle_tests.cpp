@@ -242,6 +242,7 @@ BOOST_AUTO_TEST_CASE(merkle_test)
                     std::vector<uint256> newBranch = BlockMerkleBranch(block, mtx);
                     std::vector<uint256> oldBranch = BlockGetMerkleBranch(block, merkleTree, mtx);
                     BOOST_CHECK(oldBranch == newBranch);
+                    BOOST_CHECK(TransactionMerklePath(block, mtx) == newBranch);
                     BOOST_CHECK(ComputeMerkleRootFromBranch(block.vtx[mtx]->GetHash(), newBranch, mtx) == oldRoot);
                 }
             }
@@ -250,6 +251,44 @@ BOOST_AUTO_TEST_CASE(merkle_test)
 }
 
 
+BOOST_AUTO_TEST_CASE(merkle_tree_update)
+{
+    MerkleTree tree;
+    std::vector<uint256> leaves;
+    BOOST_CHECK(tree.Update(leaves).IsNull());
+    for (int round = 0; round < 200; round++) {
+        // Change the first leaf as a new coinbase would, then append, erase or truncate
+        if (!leaves.empty()) leaves[0] = InsecureRand256();
+        switch (InsecureRandRange(4)) {
+        case 0:
+            for (int i = InsecureRandRange(40); i > 0; i--) leaves.push_back(InsecureRand256());
+            break;
+        case 1:
+            if (!leaves.empty()) leaves.erase(leaves.begin() + InsecureRandRange(leaves.size()));
+            break;
+        case 2:
+            leaves.resize(InsecureRandRange(leaves.size() + 1));
+            break;
+        default:
+            if (!leaves.empty()) leaves[InsecureRandRange(leaves.size())] = InsecureRand256();
+        }
+        BOOST_CHECK(tree.Update(leaves) == ComputeMerkleRoot(leaves));
+        BOOST_CHECK(tree.Root() == ComputeMerkleRoot(leaves));
+
+        // The path of the first leaf, and of a random one, leads to the root
+        if (leaves.empty()) continue;
+        for (size_t position : {size_t{0}, size_t(InsecureRandRange(leaves.size()))}) {
+            uint256 hash{leaves[position]};
+            size_t index{position};
+            for (const uint256& sibling : tree.Path(position)) {
+                hash = (index & 1) ? Hash(sibling, hash) : Hash(hash, sibling);
+                index >>= 1;
+            }
+            BOOST_CHECK(hash == tree.Root());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(merkle_test_empty_block)
 {
     bool mutated = false;
@@ -8,27 +8,36 @@
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
+#include <consensus/validation.h>
 #include <node/miner.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <test/util/random.h>
 #include <test/util/txmempool.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/check.h>
+#include <util/signalinterrupt.h>
 #include <util/strencodings.h>
 #include <util/time.h>
 #include <util/translation.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <versionbits.h>
 
 #include <test/util/setup_common.h>
 
+#include <limits>
 #include <memory>
+#include <optional>
+#include <set>
 
 #include <boost/test/unit_test.hpp>
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::IncrementalBlockAssembler;
+using node::SolveBlock;
 
 namespace miner_tests {
 struct MinerTestingSetup : public TestingSetup {
@@ -658,4 +667,125 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     TestPrioritisedMining(scriptPubKey, txFirst);
 }
 
+BOOST_AUTO_TEST_CASE(SolveBlock_threads)
+{
+    const Consensus::Params& params{m_node.chainman->GetConsensus()};
+    util::SignalInterrupt interrupt;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbase.vout.emplace_back(50 * COIN, CScript() << OP_TRUE);
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = InsecureRand256();
+    block.nTime = 1700000000;
+    block.nBits = 0x2000ffff;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    // The lowest valid nonce wins, however many threads share the search
+    std::optional<uint32_t> solution;
+    for (int threads : {1, 2, 4, 7, 2}) {
+        CBlock solved{block};
+        uint64_t max_tries{10000};
+        BOOST_REQUIRE(SolveBlock(solved, params, max_tries, threads, interrupt));
+        BOOST_CHECK(CheckProofOfWork(solved.GetHash(), solved.nBits, params));
+        BOOST_CHECK_EQUAL(max_tries, 10000U - solved.nNonce);
+        BOOST_CHECK(solved.vtx[0]->vin[0].scriptSig == coinbase.vin[0].scriptSig);
+        if (!solution) solution = solved.nNonce;
+        BOOST_CHECK_EQUAL(solved.nNonce, *solution);
+    }
+    for (uint32_t nonce = 0; nonce < *solution; ++nonce) {
+        CBlockHeader candidate{block};
+        candidate.nNonce = nonce;
+        BOOST_CHECK(!CheckProofOfWork(candidate.GetHash(), candidate.nBits, params));
+    }
+
+    // Running out of tries before the solution fails and consumes them all
+    if (*solution > 0) {
+        CBlock unsolved{block};
+        uint64_t max_tries{*solution};
+        BOOST_CHECK(!SolveBlock(unsolved, params, max_tries, /*threads=*/3, interrupt));
+        BOOST_CHECK_EQUAL(max_tries, 0U);
+    }
+
+    // Past the last nonce the search moves on to the next extranonce
+    block.nNonce = std::numeric_limits<uint32_t>::max();
+    std::optional<uint256> rolled;
+    for (int threads : {1, 3}) {
+        CBlock solved{block};
+        uint64_t max_tries{10000};
+        BOOST_REQUIRE(SolveBlock(solved, params, max_tries, threads, interrupt));
+        BOOST_CHECK(CheckProofOfWork(solved.GetHash(), solved.nBits, params));
+        BOOST_CHECK(solved.hashMerkleRoot == BlockMerkleRoot(solved));
+        if (solved.vtx[0]->vin[0].scriptSig != coinbase.vin[0].scriptSig) {
+            BOOST_CHECK(solved.vtx[0]->vin[0].scriptSig == (CScript{coinbase.vin[0].scriptSig} << CScriptNum{1}));
+            BOOST_CHECK_EQUAL(max_tries, 10000U - 1 - solved.nNonce);
+        }
+        if (!rolled) rolled = solved.GetHash();
+        BOOST_CHECK(solved.GetHash() == *rolled);
+    }
+
+    // An interrupt stops every worker
+    BOOST_REQUIRE(interrupt());
+    CBlock interrupted{block};
+    uint64_t max_tries{10000};
+    BOOST_CHECK(!SolveBlock(interrupted, params, max_tries, /*threads=*/4, interrupt));
+}
+
+BOOST_FIXTURE_TEST_CASE(incremental_block_assembler, TestChain100Setup)
+{
+    BlockAssembler::Options options;
+    ApplyArgsManOptions(*m_node.args, options);
+    const auto assembler{std::make_shared<IncrementalBlockAssembler>(*m_node.chainman, *m_node.mempool, options)};
+    m_node.validation_signals->RegisterSharedValidationInterface(assembler);
+    const CScript script{GetScriptForRawPubKey(coinbaseKey.GetPubKey())};
+
+    // Each template holds what a full CreateNewBlock selects, with correct merkle roots
+    const auto check_template = [&](size_t expected_txs) {
+        m_node.validation_signals->SyncWithValidationInterfaceQueue();
+        const auto block_template{assembler->CreateNewBlock(script)};
+        BOOST_REQUIRE(block_template);
+        const CBlock& block{block_template->block};
+        BOOST_CHECK_EQUAL(block.vtx.size(), expected_txs);
+        BOOST_CHECK(block.hashMerkleRoot == BlockMerkleRoot(block));
+
+        const auto full{BlockAssembler{m_node.chainman->ActiveChainstate(), m_node.mempool.get(), options}.CreateNewBlock(script)};
+        std::set<Txid> txids, full_txids;
+        for (const auto& tx : block.vtx) txids.insert(tx->GetHash());
+        for (const auto& tx : full->block.vtx) full_txids.insert(tx->GetHash());
+        txids.erase(block.vtx[0]->GetHash());
+        full_txids.erase(full->block.vtx[0]->GetHash());
+        BOOST_CHECK(txids == full_txids);
+
+        LOCK(::cs_main);
+        BlockValidationState state;
+        BOOST_CHECK_MESSAGE(TestBlockValidity(state, m_node.chainman->GetParams(), m_node.chainman->ActiveChainstate(), block,
+                                              m_node.chainman->ActiveChain().Tip(), /*fCheckPOW=*/false, /*fCheckMerkleRoot=*/true),
+                            state.ToString());
+    };
+    check_template(1);
+
+    // A parent, its child and an unrelated transaction are appended
+    const CTransactionRef parent{MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/1, coinbaseKey, script))};
+    check_template(2);
+    CreateValidMempoolTransaction(parent, /*input_vout=*/0, /*input_height=*/101, coinbaseKey, script, /*output_amount=*/COIN / 2);
+    CreateValidMempoolTransaction(m_coinbase_txns[1], /*input_vout=*/0, /*input_height=*/2, coinbaseKey, script);
+    check_template(4);
+
+    // Removing the parent drops its child too
+    {
+        LOCK(m_node.mempool->cs);
+        m_node.mempool->removeRecursive(*parent, MemPoolRemovalReason::CONFLICT);
+    }
+    check_template(2);
+
+    // A new tip starts over from the mempool
+    CreateAndProcessBlock({}, script);
+    check_template(2);
+
+    m_node.validation_signals->UnregisterSharedValidationInterface(assembler);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
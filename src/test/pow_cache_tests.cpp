@@ -0,0 +1,162 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pow_cache.h>
+#include <primitives/block.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+#include <util/fs.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(pow_cache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pow_cache_bounded)
+{
+    PowCache cache{/*max_bytes=*/64 << 10, /*path=*/{}};
+    const auto capacity{cache.GetStats().capacity};
+    BOOST_CHECK(capacity > 0);
+
+    std::vector<std::pair<uint256, uint256>> entries;
+    for (size_t i = 0; i < capacity * 4; ++i) {
+        entries.emplace_back(InsecureRand256(), InsecureRand256());
+        cache.Put(entries.back().first, entries.back().second);
+    }
+
+    // Memory stays bounded, and whatever is still cached maps to the right value
+    const auto stats{cache.GetStats()};
+    BOOST_CHECK(stats.entries <= stats.capacity);
+    BOOST_CHECK_EQUAL(stats.capacity, capacity);
+    size_t found{0};
+    for (const auto& [key, value] : entries) {
+        if (const auto cached{cache.Get(key)}) {
+            BOOST_CHECK(*cached == value);
+            ++found;
+        }
+    }
+    BOOST_CHECK(found > 0);
+    BOOST_CHECK_EQUAL(found, stats.entries);
+    BOOST_CHECK_EQUAL(cache.GetStats().hits + cache.GetStats().misses, entries.size());
+
+    // Recently read entries survive later insertions into a full table
+    const auto& [hot_key, hot_value]{entries.back()};
+    for (size_t i = 0; i < capacity; ++i) {
+        BOOST_CHECK(cache.Get(hot_key) == hot_value);
+        cache.Put(InsecureRand256(), InsecureRand256());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pow_cache_concurrent)
+{
+    PowCache cache{/*max_bytes=*/1 << 20, /*path=*/{}};
+    std::vector<std::pair<uint256, uint256>> entries;
+    for (int i = 0; i < 1000; ++i) entries.emplace_back(InsecureRand256(), InsecureRand256());
+
+    // Readers racing with writers must only ever see complete entries
+    std::vector<std::thread> threads;
+    std::atomic<bool> torn{false};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 20; ++round) {
+                for (size_t i = t; i < entries.size(); i += 2) {
+                    if (t % 2 == 0) cache.Put(entries[i].first, entries[i].second);
+                    const auto cached{cache.Get(entries[i].first)};
+                    if (cached && *cached != entries[i].second) torn = true;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    BOOST_CHECK(!torn);
+}
+
+BOOST_AUTO_TEST_CASE(pow_cache_persistence)
+{
+    const fs::path path{m_args.GetDataDirNet() / "powcache_test.dat"};
+    std::vector<std::pair<uint256, uint256>> entries;
+    for (int i = 0; i < 300; ++i) entries.emplace_back(InsecureRand256(), InsecureRand256());
+
+    {
+        PowCache cache{/*max_bytes=*/1 << 20, path};
+        for (const auto& [key, value] : entries) cache.Put(key, value);
+    }
+    {
+        PowCache cache{/*max_bytes=*/1 << 20, path};
+        BOOST_CHECK_EQUAL(cache.GetStats().entries, entries.size());
+        for (const auto& [key, value] : entries) BOOST_CHECK(cache.Get(key) == value);
+    }
+
+    // A torn final record is dropped without losing the records before it
+    fs::resize_file(path, fs::file_size(path) - 10);
+    {
+        PowCache cache{/*max_bytes=*/1 << 20, path};
+        BOOST_CHECK_EQUAL(cache.GetStats().entries, entries.size() - 1);
+        BOOST_CHECK(!cache.Get(entries.back().first));
+        cache.Put(entries.back().first, entries.back().second);
+    }
+    {
+        PowCache cache{/*max_bytes=*/1 << 20, path};
+        BOOST_CHECK_EQUAL(cache.GetStats().entries, entries.size());
+        BOOST_CHECK(cache.Get(entries.back().first) == entries.back().second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pow_cache_compaction)
+{
+    const fs::path path{m_args.GetDataDirNet() / "powcache_compact.dat"};
+    PowCache cache{/*max_bytes=*/64 << 10, path};
+    const auto capacity{cache.GetStats().capacity};
+
+    // Churning through many more entries than fit keeps the file bounded
+    for (size_t i = 0; i < capacity * 8; ++i) {
+        cache.Put(InsecureRand256(), InsecureRand256());
+        if (i % 1000 == 0) cache.Flush();
+    }
+    cache.Flush();
+    BOOST_CHECK(cache.GetStats().file_records <= 2 * capacity);
+
+    // An explicit compaction leaves one record per live entry
+    BOOST_CHECK(cache.Compact());
+    const auto stats{cache.GetStats()};
+    BOOST_CHECK_EQUAL(stats.file_records, stats.entries);
+    const uint256 key{InsecureRand256()}, value{InsecureRand256()};
+    cache.Put(key, value);
+    cache.Flush();
+    BOOST_CHECK_EQUAL(cache.GetStats().file_records, stats.entries + 1);
+
+    PowCache reloaded{/*max_bytes=*/64 << 10, path};
+    BOOST_CHECK(reloaded.Get(key) == value);
+
+    // Nothing to compact without a backing file
+    PowCache memory_only{/*max_bytes=*/64 << 10, /*path=*/{}};
+    BOOST_CHECK(!memory_only.Compact());
+}
+
+BOOST_AUTO_TEST_CASE(pow_cache_lookup_does_not_admit)
+{
+    CBlockHeader header;
+    header.nVersion = 0x20008000;
+    header.hashPrevBlock = InsecureRand256();
+    header.nBits = 0x1e0fffff;
+
+    // Hashing a header nobody indexed leaves the cache untouched
+    PowCache& cache{PowCache::Instance()};
+    const auto before{cache.GetStats()};
+    const uint256 pow_hash{header.GetPoWHash()};
+    BOOST_CHECK(pow_hash == header.ComputePoWHash());
+    BOOST_CHECK(pow_hash == header.GetHash2());
+    BOOST_CHECK(!cache.Get(header.GetHash()));
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, before.entries);
+
+    // Once admitted, lookups are answered from the cache
+    cache.Put(header.GetHash(), pow_hash);
+    const auto hits{cache.GetStats().hits};
+    BOOST_CHECK(header.GetPoWHash() == pow_hash);
+    BOOST_CHECK_EQUAL(cache.GetStats().hits, hits + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <primitives/block.h>
 #include <pow.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
@@ -156,6 +157,66 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/** Grow a chain under params and check DifficultyContext against GetNextWorkRequired at every height. */
+static void CheckDifficultyContext(const Consensus::Params& params)
+{
+    // Long enough for one legacy retarget, then every 2023 era
+    const int count{int(params.n2023DiffAlgoHeight5) + 500};
+    std::vector<CBlockIndex> blocks(count);
+    std::vector<uint256> hashes(count);
+    DifficultyContext context{params};
+    int mismatches{0};
+    for (int i = 0; i < count; ++i) {
+        CBlockHeader header;
+        header.nVersion = 0x20008000;
+        header.nTime = i ? blocks[i - 1].nTime + 1 + InsecureRandRange(3 * params.nPowTargetSpacing) : 1700000000;
+        header.nBits = 0x1e0fffff;
+        if (i > 0) {
+            header.nBits = GetNextWorkRequired(&blocks[i - 1], &header, params);
+            if (context.GetNextWorkRequired(header) != header.nBits) ++mismatches;
+        }
+        hashes[i] = header.GetHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = header.nTime;
+        blocks[i].nBits = header.nBits;
+        blocks[i].BuildSkip();
+        context.Connect(header, hashes[i]);
+        BOOST_CHECK(context.IsTip(hashes[i]));
+
+        // A context rebuilt from the index agrees with the incremental one
+        if (i % 1009 == 0 || i == count - 1) {
+            DifficultyContext fresh{params};
+            fresh.Reset(blocks[i]);
+            CBlockHeader next{header};
+            next.nTime += 1 + InsecureRandRange(3 * params.nPowTargetSpacing);
+            BOOST_CHECK_EQUAL(fresh.Height(), i);
+            BOOST_CHECK_EQUAL(fresh.GetNextWorkRequired(next), context.GetNextWorkRequired(next));
+        }
+    }
+    BOOST_CHECK_EQUAL(mismatches, 0);
+}
+
+BOOST_AUTO_TEST_CASE(difficulty_context_matches)
+{
+    Consensus::Params params{CreateChainParams(*m_node.args, ChainType::MAIN)->GetConsensus()};
+    params.n2023DiffAlgoHeight = params.DifficultyAdjustmentInterval() + 5000;
+    params.n2023DiffAlgoHeight2 = params.n2023DiffAlgoHeight + 200;
+    params.n2023DiffAlgoHeight3 = params.n2023DiffAlgoHeight2 + 200;
+    params.n2023DiffAlgoHeight4 = params.n2023DiffAlgoHeight3 + 200;
+    params.n2023DiffAlgoHeight5 = params.n2023DiffAlgoHeight4 + 200;
+    params.nFlexhashHeight = params.n2023DiffAlgoHeight5 + 100;
+
+    for (const bool min_difficulty : {false, true}) {
+        for (const bool bip94 : {false, true}) {
+            params.fPowAllowMinDifficultyBlocks = min_difficulty;
+            params.enforce_BIP94 = bip94;
+            CheckDifficultyContext(params);
+        }
+    }
+}
+
 void sanity_check_chainparams(const ArgsManager& args, ChainType chain_type)
 {
     const auto chainParams = CreateChainParams(args, chain_type);
@@ -0,0 +1,193 @@
+// Copyright (c) 2024 The Kylacoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <crypto/common.h>
+#include <hash.h>
+#include <interfaces/mining.h>
+#include <netbase.h>
+#include <node/miner.h>
+#include <node/stratum.h>
+#include <pow.h>
+#include <script/script.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <univalue.h>
+#include <util/sock.h>
+#include <util/strencodings.h>
+#include <util/threadinterrupt.h>
+#include <util/translation.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+using node::AssembleStratumBlock;
+using node::MakeStratumJob;
+using node::StratumJob;
+using node::StratumOptions;
+using node::StratumServer;
+
+namespace {
+//! Stand-in for a miner: speaks newline-delimited JSON over a loopback socket.
+struct StratumTestClient {
+    std::unique_ptr<Sock> sock;
+    CThreadInterrupt interrupt;
+
+    void Send(const std::string& method, const UniValue& params, int id)
+    {
+        UniValue request{UniValue::VOBJ};
+        request.pushKV("id", id);
+        request.pushKV("method", method);
+        request.pushKV("params", params);
+        const std::string line{request.write() + "\n"};
+        sock->SendComplete(line, std::chrono::seconds{10}, interrupt);
+    }
+
+    UniValue Receive()
+    {
+        UniValue message;
+        BOOST_REQUIRE(message.read(sock->RecvUntilTerminator('\n', std::chrono::seconds{60}, interrupt, 1 << 20)));
+        return message;
+    }
+};
+
+//! Build the header a miner would hash for a mining.notify, with the given extra nonce.
+CBlockHeader HeaderForJob(const UniValue& params, const std::vector<unsigned char>& extranonce)
+{
+    std::vector<unsigned char> coinbase{ParseHex(params[2].get_str())};
+    coinbase.insert(coinbase.end(), extranonce.begin(), extranonce.end());
+    const auto coinb2{ParseHex(params[3].get_str())};
+    coinbase.insert(coinbase.end(), coinb2.begin(), coinb2.end());
+
+    CBlockHeader header;
+    header.hashMerkleRoot = Hash(coinbase);
+    for (const UniValue& hash : params[4].getValues()) {
+        header.hashMerkleRoot = Hash(header.hashMerkleRoot, uint256{ParseHex(hash.get_str())});
+    }
+    header.hashPrevBlock = uint256{ParseHex(params[1].get_str())};
+    header.nVersion = ReadBE32(ParseHex(params[5].get_str()).data());
+    header.nBits = ReadBE32(ParseHex(params[6].get_str()).data());
+    header.nTime = ReadBE32(ParseHex(params[7].get_str()).data());
+    return header;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(stratum_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(stratum_job_roundtrip)
+{
+    auto mining{interfaces::MakeMining(m_node)};
+    CreateValidMempoolTransaction(m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/1, coinbaseKey, GetScriptForRawPubKey(coinbaseKey.GetPubKey()), /*output_amount=*/40 * CENT);
+    const auto block_template{mining->createNewBlock(GetScriptForRawPubKey(coinbaseKey.GetPubKey()))};
+    BOOST_REQUIRE(block_template);
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 2U);
+
+    // The incremental assembler hands out the coinbase branch from its tree
+    BOOST_REQUIRE(block_template->coinbase_merkle_path);
+    BOOST_CHECK(*block_template->coinbase_merkle_path == TransactionMerklePath(block_template->block, 0));
+
+    const StratumJob job{MakeStratumJob("1", block_template->block, block_template->coinbase_merkle_path)};
+    BOOST_CHECK_EQUAL(job.merkle_branch.size(), 1U);
+    BOOST_CHECK(job.merkle_branch == MakeStratumJob("1", block_template->block).merkle_branch);
+
+    const std::vector<unsigned char> extranonce{1, 2, 3, 4, 5, 6, 7, 8};
+    const CBlock block{AssembleStratumBlock(job, extranonce, block_template->block.nTime, /*nonce=*/42)};
+    BOOST_CHECK_EQUAL(block.nNonce, 42U);
+    BOOST_CHECK(block.hashMerkleRoot == BlockMerkleRoot(block));
+
+    // The coinbase is exactly what a miner assembles from the job
+    std::vector<unsigned char> coinbase{job.coinb1};
+    coinbase.insert(coinbase.end(), extranonce.begin(), extranonce.end());
+    coinbase.insert(coinbase.end(), job.coinb2.begin(), job.coinb2.end());
+    DataStream stream;
+    stream << TX_NO_WITNESS(*block.vtx[0]);
+    BOOST_CHECK_EQUAL(HexStr(coinbase), HexStr(stream));
+
+    BlockValidationState state;
+    BOOST_CHECK_MESSAGE(mining->testBlockValidity(block, /*check_merkle_root=*/true, state), state.ToString());
+}
+
+BOOST_AUTO_TEST_CASE(stratum_server_mines_block)
+{
+    auto mining{interfaces::MakeMining(m_node)};
+    StratumOptions options;
+    options.bind = LookupNumeric("127.0.0.1", 0);
+    options.coinbase_script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    options.job_interval = std::chrono::milliseconds{0};
+    StratumServer server{*mining, options};
+    bilingual_str error;
+    BOOST_REQUIRE_MESSAGE(server.Start(error), error.original);
+
+    StratumTestClient client;
+    client.sock = ConnectDirectly(LookupNumeric("127.0.0.1", server.GetPort()), /*manual_connection=*/true);
+    BOOST_REQUIRE(client.sock);
+
+    client.Send("mining.subscribe", UniValue{UniValue::VARR}, 1);
+    const UniValue subscribed{client.Receive()};
+    BOOST_CHECK_EQUAL(subscribed["id"].getInt<int>(), 1);
+    BOOST_CHECK(subscribed["error"].isNull());
+    const auto extranonce1{ParseHex(subscribed["result"][1].get_str())};
+    BOOST_CHECK_EQUAL(extranonce1.size(), node::STRATUM_EXTRANONCE1_SIZE);
+    BOOST_CHECK_EQUAL(subscribed["result"][2].getInt<int>(), int{node::STRATUM_EXTRANONCE2_SIZE});
+
+    // The first job builds on the tip and asks miners to drop older work
+    const UniValue first{client.Receive()};
+    BOOST_CHECK_EQUAL(first["method"].get_str(), "mining.notify");
+    const uint256 tip{WITH_LOCK(::cs_main, return m_node.chainman->ActiveChain().Tip()->GetBlockHash())};
+    BOOST_CHECK_EQUAL(first["params"][1].get_str(), HexStr(tip));
+    BOOST_CHECK(first["params"][4].empty());
+    BOOST_CHECK(first["params"][8].get_bool());
+
+    // A mempool change only sends a new branch and coinbase outputs
+    const CMutableTransaction tx{CreateValidMempoolTransaction(m_coinbase_txns[0], /*input_vout=*/0, /*input_height=*/1, coinbaseKey, GetScriptForRawPubKey(coinbaseKey.GetPubKey()), /*output_amount=*/40 * CENT)};
+    const UniValue second{client.Receive()};
+    const UniValue& params{second["params"]};
+    BOOST_CHECK_EQUAL(params[1].get_str(), first["params"][1].get_str());
+    BOOST_CHECK_EQUAL(params[2].get_str(), first["params"][2].get_str());
+    BOOST_CHECK_EQUAL(params[4].size(), 1U);
+    BOOST_CHECK_EQUAL(params[4][0].get_str(), HexStr(tx.GetHash().ToUint256()));
+    BOOST_CHECK(!params[8].get_bool());
+
+    std::vector<unsigned char> extranonce{extranonce1};
+    const std::vector<unsigned char> extranonce2{0, 0, 0, 1};
+    extranonce.insert(extranonce.end(), extranonce2.begin(), extranonce2.end());
+    CBlockHeader header{HeaderForJob(params, extranonce)};
+    while (!CheckProofOfWork(header.ComputePoWHash(), header.nBits, m_node.chainman->GetConsensus())) ++header.nNonce;
+
+    UniValue submit{UniValue::VARR};
+    submit.push_back("worker");
+    submit.push_back(params[0]);
+    submit.push_back(HexStr(extranonce2));
+    submit.push_back(params[7]);
+    submit.push_back(strprintf("%08x", header.nNonce));
+    client.Send("mining.submit", submit, 2);
+    const UniValue accepted{client.Receive()};
+    BOOST_CHECK_EQUAL(accepted["id"].getInt<int>(), 2);
+    BOOST_CHECK_MESSAGE(accepted["result"].isTrue(), accepted.write());
+    {
+        LOCK(::cs_main);
+        const CBlockIndex* new_tip{m_node.chainman->ActiveChain().Tip()};
+        BOOST_CHECK(new_tip->GetBlockHash() == header.GetHash());
+        BOOST_CHECK_EQUAL(new_tip->nHeight, 101);
+        BOOST_CHECK_EQUAL(new_tip->nTx, 2U);
+    }
+
+    // The next job is clean, and work for the old tip is stale
+    const UniValue third{client.Receive()};
+    BOOST_CHECK_EQUAL(third["params"][1].get_str(), HexStr(header.GetHash()));
+    BOOST_CHECK(third["params"][8].get_bool());
+    client.Send("mining.submit", submit, 3);
+    const UniValue stale{client.Receive()};
+    BOOST_CHECK(stale["result"].isNull());
+    BOOST_CHECK_EQUAL(stale["error"][0].getInt<int>(), 21);
+
+    server.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,7 @@
 #include <key.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <primitives/block.h>
 #include <script/script.h>
 #include <script/script_error.h>
 #include <script/sigcache.h>
@@ -421,6 +422,67 @@ BOOST_AUTO_TEST_CASE(basic_transaction_tests)
     BOOST_CHECK_MESSAGE(!CheckTransaction(CTransaction(tx), state) || !state.IsValid(), "Transaction with duplicate txins should be invalid.");
 }
 
+BOOST_AUTO_TEST_CASE(batch_hashed_transactions)
+{
+    // Transactions with and without witness, of varied sizes
+    std::vector<CMutableTransaction> txs;
+    for (int i = 0; i < 40; ++i) {
+        CMutableTransaction tx;
+        tx.version = i;
+        tx.vin.resize(1 + InsecureRandRange(30));
+        for (auto& in : tx.vin) {
+            in.prevout = COutPoint{Txid::FromUint256(InsecureRand256()), uint32_t(InsecureRand32())};
+            if (i % 3 == 0) in.scriptWitness.stack.push_back(g_insecure_rand_ctx.randbytes(InsecureRandRange(100)));
+        }
+        tx.vout.emplace_back(i, CScript() << OP_TRUE);
+        txs.push_back(tx);
+    }
+
+    const std::vector<CTransactionRef> batched{MakeTransactionRefs(std::vector<CMutableTransaction>{txs})};
+    BOOST_REQUIRE_EQUAL(batched.size(), txs.size());
+    for (size_t i = 0; i < txs.size(); ++i) {
+        const CTransaction tx{txs[i]};
+        BOOST_CHECK_EQUAL(batched[i]->GetHash(), tx.GetHash());
+        BOOST_CHECK_EQUAL(batched[i]->GetWitnessHash(), tx.GetWitnessHash());
+        BOOST_CHECK_EQUAL(batched[i]->HasWitness(), tx.HasWitness());
+        BOOST_CHECK(batched[i]->vin == tx.vin);
+    }
+
+    // Blocks deserialize through the batched path
+    CBlock block;
+    for (const auto& tx : txs) block.vtx.push_back(MakeTransactionRef(tx));
+    DataStream stream;
+    stream << TX_WITH_WITNESS(block);
+    CBlock read;
+    stream >> TX_WITH_WITNESS(read);
+    BOOST_REQUIRE_EQUAL(read.vtx.size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        BOOST_CHECK_EQUAL(read.vtx[i]->GetWitnessHash(), block.vtx[i]->GetWitnessHash());
+    }
+
+    // Reading from memory hashes the bytes read, skipping the witness for txids
+    DataStream block_bytes;
+    block_bytes << TX_WITH_WITNESS(block);
+    CBlock read_span;
+    SpanReader{MakeUCharSpan(block_bytes)} >> TX_WITH_WITNESS(read_span);
+    BOOST_REQUIRE_EQUAL(read_span.vtx.size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        BOOST_CHECK_EQUAL(read_span.vtx[i]->GetHash(), block.vtx[i]->GetHash());
+        BOOST_CHECK_EQUAL(read_span.vtx[i]->GetWitnessHash(), block.vtx[i]->GetWitnessHash());
+    }
+
+    for (const auto& tx : block.vtx) {
+        DataStream tx_bytes;
+        tx_bytes << TX_WITH_WITNESS(tx) << uint8_t{0xff};
+        SpanReader reader{MakeUCharSpan(tx_bytes)};
+        const CTransaction from_span{TX_WITH_WITNESS, reader};
+        BOOST_CHECK_EQUAL(reader.size(), 1U);
+        BOOST_CHECK_EQUAL(from_span.GetHash(), tx->GetHash());
+        BOOST_CHECK_EQUAL(from_span.GetWitnessHash(), tx->GetWitnessHash());
+        BOOST_CHECK(from_span.vin == tx->vin);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_Get)
 {
     FillableSigningProvider keystore;
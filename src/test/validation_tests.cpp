@@ -2,12 +2,14 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <consensus/amount.h>
 #include <consensus/merkle.h>
 #include <core_io.h>
 #include <hash.h>
 #include <net.h>
+#include <pow.h>
 #include <signet.h>
 #include <uint256.h>
 #include <util/chaintype.h>
@@ -150,6 +152,44 @@ BOOST_AUTO_TEST_CASE(test_assumeutxo)
     BOOST_CHECK_EQUAL(out110_2.m_chain_tx_count, 111U);
 }
 
+BOOST_AUTO_TEST_CASE(headers_pow_parallel)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    auto& pow_check_queue = m_node.chainman->GetPoWCheckQueue();
+    BOOST_REQUIRE(pow_check_queue.HasThreads());
+
+    std::vector<CBlockHeader> headers(100);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        headers[i].nVersion = 0x20000000;
+        headers[i].nTime = 1700000000 + i;
+        headers[i].nBits = UintToArith256(params.powLimit).GetCompact();
+        while (!CheckProofOfWork(headers[i].GetPoWHash(), headers[i].nBits, params)) ++headers[i].nNonce;
+    }
+    BOOST_CHECK(HasValidProofOfWork(headers, params));
+    BOOST_CHECK(HasValidProofOfWork(headers, params, &pow_check_queue));
+
+    // A single bad header anywhere in the batch fails it, in parallel as well.
+    for (size_t bad : {size_t{0}, size_t{57}, headers.size() - 1}) {
+        std::vector<CBlockHeader> invalid{headers};
+        while (CheckProofOfWork(invalid[bad].GetPoWHash(), invalid[bad].nBits, params)) ++invalid[bad].nNonce;
+        BOOST_CHECK(!HasValidProofOfWork(invalid, params));
+        BOOST_CHECK(!HasValidProofOfWork(invalid, params, &pow_check_queue));
+    }
+
+    // The queue is reusable after a failed batch.
+    BOOST_CHECK(HasValidProofOfWork(headers, params, &pow_check_queue));
+
+    // The hashes that were checked are handed back, so they need not be computed again.
+    for (auto* queue : {static_cast<CCheckQueue<CHeaderPoWCheck>*>(nullptr), &pow_check_queue}) {
+        std::vector<uint256> pow_hashes;
+        BOOST_CHECK(HasValidProofOfWork(headers, params, queue, &pow_hashes));
+        BOOST_REQUIRE_EQUAL(pow_hashes.size(), headers.size());
+        for (size_t i = 0; i < headers.size(); ++i) {
+            BOOST_CHECK(pow_hashes[i] == headers[i].GetPoWHash());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(block_malleation)
 {
     // Test utilities that calls `IsBlockMutated` and then clears the validity
@@ -8,6 +8,7 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockcompression.h>
 #include <chain.h>
 #include <checkqueue.h>
 #include <clientversion.h>
@@ -37,6 +38,7 @@
 #include <policy/settings.h>
 #include <policy/truc_policy.h>
 #include <pow.h>
+#include <pow_cache.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <random.h>
@@ -58,6 +60,7 @@
 #include <util/signalinterrupt.h>
 #include <util/strencodings.h>
 #include <util/string.h>
+#include <util/threadnames.h>
 #include <util/time.h>
 #include <util/trace.h>
 #include <util/translation.h>
@@ -66,12 +69,16 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <numeric>
 #include <optional>
 #include <ranges>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_set>
 #include <utility>
 
 using kernel::CCoinsStats;
@@ -3943,14 +3950,22 @@ void ChainstateManager::ReceivedBlockTransactions(const CBlock& block, CBlockInd
     }
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+/**
+ * @param[out] pow_hash If non-null and fCheckPOW is set, receives the proof-of-work hash that was checked.
+ * @param[in] known_pow_hash If non-null, the proof-of-work hash of this header, checked instead of computing it.
+ */
+static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, uint256* pow_hash = nullptr, const uint256* known_pow_hash = nullptr)
 {
     if (fCheckPOW && (block.nVersion != 0x1 && block.nVersion != 0x20000000 && block.nVersion != 0x30000000 && block.nVersion != 0x20008000))
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "invalid-block-version", "block version not supported");
 
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
-        return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
+    if (fCheckPOW) {
+        const uint256 hash{known_pow_hash ? *known_pow_hash : block.GetPoWHash()};
+        if (!CheckProofOfWork(hash, block.nBits, consensusParams))
+            return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
+        if (pow_hash) *pow_hash = hash;
+    }
 
     return true;
 }
@@ -4044,8 +4059,11 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
         return true;
 
     // Check that the header is valid (particularly PoW).  This is mostly
-    // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    // redundant with the call in AcceptBlockHeader. A block read back for an
+    // index entry carries the proof-of-work hash stored there.
+    uint256 pow_hash;
+    const uint256* known_pow_hash{block.m_checked_pow && block.m_checked_pow->first == block.GetHash() ? &block.m_checked_pow->second : nullptr};
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, &pow_hash, known_pow_hash))
         return false;
 
     // Signet only: check block solution
@@ -4095,8 +4113,10 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
     if (nSigOps * WITNESS_SCALE_FACTOR > MAX_BLOCK_SIGOPS_COST)
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-sigops", "out-of-bounds SigOpCount");
 
-    if (fCheckPOW && fCheckMerkleRoot)
+    if (fCheckPOW && fCheckMerkleRoot) {
         block.fChecked = true;
+        block.m_checked_pow.emplace(block.GetHash(), pow_hash);
+    }
 
     return true;
 }
@@ -4114,12 +4134,17 @@ void ChainstateManager::UpdateUncommittedBlockStructures(CBlock& block, const CB
 }
 
 std::vector<unsigned char> ChainstateManager::GenerateCoinbaseCommitment(CBlock& block, const CBlockIndex* pindexPrev) const
+{
+    return GenerateCoinbaseCommitment(block, pindexPrev, BlockWitnessMerkleRoot(block, nullptr));
+}
+
+std::vector<unsigned char> ChainstateManager::GenerateCoinbaseCommitment(CBlock& block, const CBlockIndex* pindexPrev, const uint256& witness_root) const
 {
     std::vector<unsigned char> commitment;
     int commitpos = GetWitnessCommitmentIndex(block);
     std::vector<unsigned char> ret(32, 0x00);
     if (commitpos == NO_WITNESS_COMMITMENT) {
-        uint256 witnessroot = BlockWitnessMerkleRoot(block, nullptr);
+        uint256 witnessroot = witness_root;
         CHash256().Write(witnessroot).Write(ret).Finalize(witnessroot);
         CTxOut out;
         out.nValue = 0;
@@ -4140,10 +4165,33 @@ std::vector<unsigned char> ChainstateManager::GenerateCoinbaseCommitment(CBlock&
     return commitment;
 }
 
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams)
+bool CHeaderPoWCheck::operator()() const
+{
+    const uint256 pow_hash{m_header->GetPoWHash()};
+    if (m_pow_hash) *m_pow_hash = pow_hash;
+    return CheckProofOfWork(pow_hash, m_header->nBits, *m_params);
+}
+
+bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, CCheckQueue<CHeaderPoWCheck>* pow_check_queue, std::vector<uint256>* pow_hashes)
 {
-    return std::all_of(headers.cbegin(), headers.cend(),
-            [&](const auto& header) { return CheckProofOfWork(header.GetPoWHash(), header.nBits, consensusParams);});
+    if (pow_hashes) pow_hashes->assign(headers.size(), uint256{});
+    const auto pow_hash{[&](size_t i) { return pow_hashes ? &(*pow_hashes)[i] : nullptr; }};
+
+    if (pow_check_queue == nullptr || !pow_check_queue->HasThreads() || headers.size() <= 1) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (!CHeaderPoWCheck(headers[i], consensusParams, pow_hash(i))()) return false;
+        }
+        return true;
+    }
+
+    std::vector<CHeaderPoWCheck> checks;
+    checks.reserve(headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        checks.emplace_back(headers[i], consensusParams, pow_hash(i));
+    }
+    CCheckQueueControl<CHeaderPoWCheck> control(pow_check_queue);
+    control.Add(std::move(checks));
+    return control.Wait();
 }
 
 bool IsBlockMutated(const CBlock& block, bool check_witness_root)
@@ -4195,8 +4243,10 @@ arith_uint256 CalculateClaimedHeadersWork(const std::vector<CBlockHeader>& heade
  *  enforced in this function (eg by adding a new consensus rule). See comment
  *  in ConnectBlock().
  *  Note that -reindex-chainstate skips the validation that happens here!
+ *  @param[in] difficulty  If non-null, the difficulty context to check against,
+ *                         reset to pindexPrev first unless it already is there.
  */
-static bool ContextualCheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, BlockManager& blockman, const ChainstateManager& chainman, const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+static bool ContextualCheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, BlockManager& blockman, const ChainstateManager& chainman, const CBlockIndex* pindexPrev, DifficultyContext* difficulty = nullptr) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
 {
     AssertLockHeld(::cs_main);
     assert(pindexPrev != nullptr);
@@ -4204,7 +4254,9 @@ static bool ContextualCheckBlockHeader(const CBlockHeader& block, BlockValidatio
 
     // Check proof of work
     const Consensus::Params& consensusParams = chainman.GetConsensus();
-    if (block.nBits != GetNextWorkRequired(pindexPrev, &block, consensusParams))
+    if (difficulty && !difficulty->IsTip(pindexPrev->GetBlockHash())) difficulty->Reset(*pindexPrev);
+    const unsigned int expected_bits{difficulty ? difficulty->GetNextWorkRequired(block) : GetNextWorkRequired(pindexPrev, &block, consensusParams)};
+    if (block.nBits != expected_bits)
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "bad-diffbits", "incorrect proof of work");
 
     // Check against checkpoints
@@ -4314,12 +4366,13 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
-bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked)
+bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked, const uint256* checked_pow_hash)
 {
     AssertLockHeld(cs_main);
 
     // Check for duplicate
     uint256 hash = block.GetHash();
+    uint256 pow_hash;
     BlockMap::iterator miSelf{m_blockman.m_block_index.find(hash)};
     if (hash != GetConsensus().hashGenesisBlock) {
         if (miSelf != m_blockman.m_block_index.end()) {
@@ -4334,7 +4387,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, GetConsensus())) {
+        if (!CheckBlockHeader(block, state, GetConsensus(), /*fCheckPOW=*/true, &pow_hash, checked_pow_hash)) {
             LogPrint(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -4355,7 +4408,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
             LogPrint(BCLog::VALIDATION, "header %s has prev block invalid: %s\n", hash.ToString(), block.hashPrevBlock.ToString());
             return state.Invalid(BlockValidationResult::BLOCK_INVALID_PREV, "bad-prevblk");
         }
-        if (!ContextualCheckBlockHeader(block, state, m_blockman, *this, pindexPrev)) {
+        if (!ContextualCheckBlockHeader(block, state, m_blockman, *this, pindexPrev, &m_difficulty)) {
             LogPrint(BCLog::VALIDATION, "%s: Consensus::ContextualCheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -4404,6 +4457,15 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
         return state.Invalid(BlockValidationResult::BLOCK_HEADER_LOW_WORK, "too-little-chainwork");
     }
     CBlockIndex* pindex{m_blockman.AddToBlockIndex(block, m_best_header)};
+    if (pindex->pprev && m_difficulty.IsTip(pindex->pprev->GetBlockHash())) m_difficulty.Connect(block, hash);
+    if ((block.nVersion & 0x8000) && !pow_hash.IsNull()) {
+        // Record the Flex hash so later re-checks of this header are a lookup
+        pindex->hashPoW = pow_hash;
+        pindex->nStatus |= BLOCK_HAVE_POW_HASH;
+        // Only indexed headers enter the PoW cache; rejected or speculative
+        // ones would never be looked up again.
+        PowCache::Instance().Put(hash, pow_hash);
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -4429,14 +4491,15 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
 }
 
 // Exposed wrapper for AcceptBlockHeader
-bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex)
+bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex, const std::vector<uint256>* pow_hashes)
 {
     AssertLockNotHeld(cs_main);
+    if (pow_hashes && !Assume(pow_hashes->size() == headers.size())) pow_hashes = nullptr;
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            bool accepted{AcceptBlockHeader(header, state, &pindex, min_pow_checked)};
+            bool accepted{AcceptBlockHeader(headers[i], state, &pindex, min_pow_checked, pow_hashes ? &(*pow_hashes)[i] : nullptr)};
             CheckBlockIndex();
 
             if (!accepted) {
@@ -4447,6 +4510,8 @@ bool ChainstateManager::ProcessNewBlockHeaders(const std::vector<CBlockHeader>&
             }
         }
     }
+    // Persist the PoW hashes computed for this batch of headers in one write
+    PowCache::Instance().Commit();
     if (NotifyHeaderTip()) {
         if (IsInitialBlockDownload() && ppindex && *ppindex) {
             const CBlockIndex& last_accepted{**ppindex};
@@ -4495,7 +4560,9 @@ bool ChainstateManager::AcceptBlock(const std::shared_ptr<const CBlock>& pblock,
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    bool accepted_header{AcceptBlockHeader(block, state, &pindex, min_pow_checked)};
+    // Reuse the proof-of-work hash if CheckBlock() already checked this header
+    const uint256* checked_pow_hash{block.m_checked_pow && block.m_checked_pow->first == block.GetHash() ? &block.m_checked_pow->second : nullptr};
+    bool accepted_header{AcceptBlockHeader(block, state, &pindex, min_pow_checked, checked_pow_hash)};
     CheckBlockIndex();
 
     if (!accepted_header)
@@ -4618,6 +4685,7 @@ bool ChainstateManager::ProcessNewBlock(const std::shared_ptr<const CBlock>& blo
         }
     }
 
+    PowCache::Instance().Commit();
     NotifyHeaderTip();
 
     BlockValidationState state; // Only used to report errors, not invalidity - ignore it
@@ -5067,6 +5135,233 @@ bool Chainstate::LoadGenesisBlock()
     return true;
 }
 
+namespace {
+//! Bytes of the blocks read ahead of the one being connected while importing a block file
+constexpr size_t MAX_IMPORT_READ_AHEAD_BYTES{64 << 20};
+
+/**
+ * Pipeline importing the blocks of a block file. A reader thread locates the
+ * blocks in the file, worker threads deserialize, hash and check them, and
+ * Next() hands them out in file order to be connected. The blocks in flight
+ * are bounded by MAX_IMPORT_READ_AHEAD_BYTES.
+ *
+ * Blocks that will likely be skipped, because their parent is unknown or they
+ * are stored already, are left to be decoded by the caller if it needs them
+ * after all.
+ */
+class BlockImportPipeline
+{
+public:
+    struct Item {
+        //! Position of the block in the file, after its message start and size
+        uint64_t pos;
+        unsigned int size;
+        CBlockHeader header;
+        uint256 hash;
+        //! Serialized block, until it is decoded
+        std::vector<uint8_t> raw;
+        //! The block with CheckBlock() results memoized, once decoded
+        std::shared_ptr<CBlock> block;
+        //! Why the block could not be deserialized
+        std::string error;
+        //! Whether workers decode the block
+        bool decode;
+        bool done{false};
+    };
+
+    //! Whether a block, by hash and parent hash, is likely to be connected rather than skipped
+    using NeedsBlockFn = std::function<bool(const uint256&, const uint256&)>;
+
+    BlockImportPipeline(AutoFile& file, const CChainParams& params, const node::BlockManager& blockman, const util::SignalInterrupt& interrupt, NeedsBlockFn needs_block, int workers)
+        : m_file{file}, m_params{params}, m_blockman{blockman}, m_interrupt{interrupt}, m_needs_block{std::move(needs_block)}
+    {
+        m_reader = std::thread{[this] {
+            util::ThreadRename("loadblk.read");
+            ReadBlocks();
+        }};
+        for (int n = 0; n < workers; ++n) {
+            m_workers.emplace_back([this, n] {
+                util::ThreadRename(strprintf("loadblk.%i", n));
+                DecodeBlocks();
+            });
+        }
+    }
+
+    ~BlockImportPipeline()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cv.notify_all();
+        m_reader.join();
+        for (auto& worker : m_workers) worker.join();
+    }
+
+    /** The next block in file order once workers are done with it, or nullptr after the last one. */
+    std::unique_ptr<Item> Next() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return (!m_items.empty() && m_items.front()->done) || (m_read_done && m_items.empty());
+        });
+        if (m_items.empty()) return nullptr;
+        auto item{std::move(m_items.front())};
+        m_items.pop_front();
+        --m_next_decode;
+        m_bytes -= item->size;
+        m_cv.notify_all();
+        return item;
+    }
+
+    /** Deserialize the block of an item and run the context-free checks on it. */
+    static void Decode(Item& item, const Consensus::Params& consensus)
+    {
+        try {
+            auto block{std::make_shared<CBlock>()};
+            SpanReader{item.raw} >> TX_WITH_WITNESS(*block);
+            // Passing checks are memoized in the block, including its
+            // proof-of-work hash; failing ones are repeated and reported
+            // when the block is accepted.
+            BlockValidationState state;
+            CheckBlock(*block, state, consensus);
+            item.block = std::move(block);
+        } catch (const std::exception& e) {
+            item.error = e.what();
+        }
+        item.raw = {};
+    }
+
+    /** Error that stopped reading the file early, if any. */
+    std::optional<std::string> ReadError() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        LOCK(m_mutex);
+        return m_read_error;
+    }
+
+private:
+    void ReadBlocks() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        // Blocks found in the file so far, as parents that will be known
+        std::unordered_set<uint256, BlockHasher> read_hashes;
+        try {
+            BufferedFile blkdat{m_file, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8};
+            // nRewind indicates where to resume scanning in case something goes wrong,
+            // such as a block fails to deserialize.
+            uint64_t nRewind = blkdat.GetPos();
+            while (!blkdat.eof()) {
+                if (m_interrupt) break;
+
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                bool compressed;
+                try {
+                    // locate a header
+                    MessageStartChars buf;
+                    blkdat.FindByte(std::byte(m_params.MessageStart()[0]));
+                    nRewind = blkdat.GetPos() + 1;
+                    blkdat >> buf;
+                    if (buf != m_params.MessageStart()) {
+                        continue;
+                    }
+                    // read size, of the compressed payload for compressed blocks
+                    blkdat >> nSize;
+                    compressed = nSize & COMPRESSED_RECORD_FLAG;
+                    nSize &= ~COMPRESSED_RECORD_FLAG;
+                    if ((!compressed && nSize < 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    // (this happens at the end of every blk.dat file)
+                    break;
+                }
+                try {
+                    // read the whole block for the workers, and its header
+                    auto item{std::make_unique<Item>()};
+                    item->pos = blkdat.GetPos();
+                    blkdat.SetLimit(item->pos + nSize);
+                    nRewind = item->pos + nSize;
+                    item->raw.resize(nSize);
+                    blkdat.read(MakeWritableByteSpan(item->raw));
+                    if (compressed) {
+                        auto block{m_blockman.DecompressBlock(item->raw)};
+                        if (!block || block->size() < 80) throw std::ios_base::failure{"cannot decompress block"};
+                        item->raw = std::move(*block);
+                    }
+                    item->size = item->raw.size();
+                    SpanReader{item->raw} >> item->header;
+                    item->hash = item->header.GetHash();
+                    item->decode = read_hashes.contains(item->header.hashPrevBlock) || m_needs_block(item->hash, item->header.hashPrevBlock);
+                    read_hashes.insert(item->hash);
+                    if (!Push(std::move(item))) break;
+                } catch (const std::exception& e) {
+                    // See LoadExternalBlockFile for why unexpected data is not fatal.
+                    LogPrint(BCLog::REINDEX, "LoadExternalBlockFile: unexpected data at file offset 0x%x - %s. continuing\n", (nRewind - 1), e.what());
+                }
+            }
+        } catch (const std::runtime_error& e) {
+            WITH_LOCK(m_mutex, m_read_error = e.what());
+        }
+        WITH_LOCK(m_mutex, m_read_done = true);
+        m_cv.notify_all();
+    }
+
+    /** Queue a block for the workers, waiting for room. Returns false if the pipeline stopped. */
+    bool Push(std::unique_ptr<Item> item) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return m_stop || m_items.empty() || m_bytes + item->size <= MAX_IMPORT_READ_AHEAD_BYTES;
+        });
+        if (m_stop) return false;
+        m_bytes += item->size;
+        m_items.push_back(std::move(item));
+        m_cv.notify_all();
+        return true;
+    }
+
+    void DecodeBlocks() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex)
+    {
+        while (true) {
+            Item* item;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                    return m_stop || m_next_decode < m_items.size() || m_read_done;
+                });
+                if (m_stop || m_next_decode == m_items.size()) return;
+                item = m_items[m_next_decode++].get();
+            }
+
+            if (item->decode) Decode(*item, m_params.GetConsensus());
+
+            WITH_LOCK(m_mutex, item->done = true);
+            m_cv.notify_all();
+        }
+    }
+
+    AutoFile& m_file;
+    const CChainParams& m_params;
+    const node::BlockManager& m_blockman;
+    const util::SignalInterrupt& m_interrupt;
+    const NeedsBlockFn m_needs_block;
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Blocks read and not yet taken by Next(), in file order
+    std::deque<std::unique_ptr<Item>> m_items GUARDED_BY(m_mutex);
+    //! Index in m_items of the first block no worker took yet
+    size_t m_next_decode GUARDED_BY(m_mutex){0};
+    //! Size of the blocks in m_items
+    size_t m_bytes GUARDED_BY(m_mutex){0};
+    bool m_read_done GUARDED_BY(m_mutex){false};
+    std::optional<std::string> m_read_error GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+
+    std::thread m_reader;
+    std::vector<std::thread> m_workers;
+};
+} // namespace
+
 void ChainstateManager::LoadExternalBlockFile(
     AutoFile& file_in,
     FlatFilePos* dbp,
@@ -5080,48 +5375,23 @@ void ChainstateManager::LoadExternalBlockFile(
 
     int nLoaded = 0;
     try {
-        BufferedFile blkdat{file_in, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8};
-        // nRewind indicates where to resume scanning in case something goes wrong,
-        // such as a block fails to deserialize.
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        // Blocks are read, deserialized, hashed and checked ahead on other
+        // threads; this one connects them in file order.
+        const auto needs_block{[&](const uint256& hash, const uint256& prev_hash) {
+            LOCK(cs_main);
+            const CBlockIndex* pindex{m_blockman.LookupBlockIndex(hash)};
+            if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA)) return false;
+            return hash == params.GetConsensus().hashGenesisBlock || m_blockman.LookupBlockIndex(prev_hash);
+        }};
+        BlockImportPipeline pipeline{file_in, params, m_blockman, m_interrupt, needs_block, std::max(1, m_options.worker_threads_num)};
+        while (const auto item{pipeline.Next()}) {
             if (m_interrupt) return;
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
             try {
-                // locate a header
-                MessageStartChars buf;
-                blkdat.FindByte(std::byte(params.MessageStart()[0]));
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> buf;
-                if (buf != params.MessageStart()) {
-                    continue;
-                }
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                // (this happens at the end of every blk.dat file)
-                break;
-            }
-            try {
-                // read block header
-                const uint64_t nBlockPos{blkdat.GetPos()};
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                CBlockHeader header;
-                blkdat >> header;
-                const uint256 hash{header.GetHash()};
-                // Skip the rest of this block (this may read from disk into memory); position to the marker before the
-                // next block, but it's still possible to rewind to the start of the current block (without a disk read).
-                nRewind = nBlockPos + nSize;
-                blkdat.SkipTo(nRewind);
+                    dbp->nPos = item->pos;
+                const CBlockHeader& header{item->header};
+                const uint256& hash{item->hash};
 
                 std::shared_ptr<CBlock> pblock{}; // needs to remain available after the cs_main lock is released to avoid duplicate reads from disk
 
@@ -5140,11 +5410,13 @@ void ChainstateManager::LoadExternalBlockFile(
                     // process in case the block isn't known yet
                     const CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
                     if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        // This block can be processed immediately; rewind to its start, read and deserialize it.
-                        blkdat.SetPos(nBlockPos);
-                        pblock = std::make_shared<CBlock>();
-                        blkdat >> TX_WITH_WITNESS(*pblock);
-                        nRewind = blkdat.GetPos();
+                        // This block can be processed immediately, unless it failed to deserialize.
+                        if (!item->decode) BlockImportPipeline::Decode(*item, params.GetConsensus());
+                        if (!item->block) {
+                            LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - %s. continuing\n", __func__, item->pos, item->error);
+                            continue;
+                        }
+                        pblock = item->block;
 
                         BlockValidationState state;
                         if (AcceptBlock(pblock, state, nullptr, true, dbp, nullptr, true)) {
@@ -5236,9 +5508,10 @@ void ChainstateManager::LoadExternalBlockFile(
                 // the reindex process is not the place to attempt to clean and/or compact the block files. if so desired, a studious node operator
                 // may use knowledge of the fact that the block files are not entirely pristine in order to prepare a set of pristine, and
                 // perhaps ordered, block files for later reindexing.
-                LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - %s. continuing\n", __func__, (nRewind - 1), e.what());
+                LogPrint(BCLog::REINDEX, "%s: unexpected data at file offset 0x%x - %s. continuing\n", __func__, item->pos, e.what());
             }
         }
+        if (const auto error{pipeline.ReadError()}) throw std::runtime_error{*error};
     } catch (const std::runtime_error& e) {
         GetNotifications().fatalError(strprintf(_("System error while loading external block file: %s"), e.what()));
     }
@@ -6297,6 +6570,7 @@ static ChainstateManager::Options&& Flatten(ChainstateManager::Options&& opts)
 
 ChainstateManager::ChainstateManager(const util::SignalInterrupt& interrupt, Options options, node::BlockManager::Options blockman_options)
     : m_script_check_queue{/*batch_size=*/128, options.worker_threads_num},
+      m_pow_check_queue{/*batch_size=*/8, options.worker_threads_num, "powcheck"},
       m_interrupt{interrupt},
       m_options{Flatten(std::move(options))},
       m_blockman{interrupt, std::move(blockman_options)},
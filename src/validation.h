@@ -21,6 +21,7 @@
 #include <policy/feerate.h>
 #include <policy/packages.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <script/script_error.h>
 #include <script/sigcache.h>
 #include <sync.h>
@@ -400,8 +401,26 @@ bool TestBlockValidity(BlockValidationState& state,
                        bool fCheckPOW = true,
                        bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-/** Check with the proof of work on each blockheader matches the value in nBits */
-bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams);
+/** Closure representing the proof-of-work check of a single header. */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader* m_header;
+    const Consensus::Params* m_params;
+    uint256* m_pow_hash;
+
+public:
+    CHeaderPoWCheck(const CBlockHeader& header, const Consensus::Params& params, uint256* pow_hash = nullptr) : m_header(&header), m_params(&params), m_pow_hash(pow_hash) {}
+
+    bool operator()() const;
+};
+
+/** Check with the proof of work on each blockheader matches the value in nBits.
+ *  If pow_check_queue has worker threads the headers are checked in parallel,
+ *  and checking stops once any header fails. If pow_hashes is given and this
+ *  returns true, it holds the proof-of-work hash of each header, so that
+ *  ProcessNewBlockHeaders need not hash them again. */
+bool HasValidProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, CCheckQueue<CHeaderPoWCheck>* pow_check_queue = nullptr, std::vector<uint256>* pow_hashes = nullptr);
 
 /** Check if a block has been mutated (with respect to its merkle root and witness commitments). */
 bool IsBlockMutated(const CBlock& block, bool check_witness_root);
@@ -929,12 +948,16 @@ private:
      * Caller must set min_pow_checked=true in order to add a new header to the
      * block index (permanent memory storage), indicating that the header is
      * known to be part of a sufficiently high-work chain (anti-dos check).
+     * checked_pow_hash is the proof-of-work hash of this header if the caller
+     * already computed it; CheckBlockHeader then uses it instead of hashing
+     * the header again.
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
         BlockValidationState& state,
         CBlockIndex** ppindex,
-        bool min_pow_checked) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        bool min_pow_checked,
+        const uint256* checked_pow_hash = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     friend Chainstate;
 
     /** Most recent headers presync progress update, for rate-limiting. */
@@ -954,6 +977,9 @@ private:
     //! A queue for script verifications that have to be performed by worker threads.
     CCheckQueue<CScriptCheck> m_script_check_queue;
 
+    //! A queue for header proof-of-work checks, used when processing HEADERS messages.
+    CCheckQueue<CHeaderPoWCheck> m_pow_check_queue;
+
     //! Timers and counters used for benchmarking validation in both background
     //! and active chainstates.
     SteadyClock::duration GUARDED_BY(::cs_main) time_check{};
@@ -1068,6 +1094,10 @@ public:
     /** Best header we've seen so far (used for getheaders queries' starting points). */
     CBlockIndex* m_best_header GUARDED_BY(::cs_main){nullptr};
 
+    /** Difficulty inputs of the last header accepted, so a run of headers
+     * building on each other is checked without walking ancestors. */
+    DifficultyContext m_difficulty GUARDED_BY(::cs_main){GetConsensus()};
+
     //! The total number of bytes available for us to use across all in-memory
     //! coins caches. This will be split somehow across chainstates.
     int64_t m_total_coinstip_cache{0};
@@ -1221,8 +1251,9 @@ public:
      * @param[in]  min_pow_checked  True if proof-of-work anti-DoS checks have been done by caller for headers chain
      * @param[out] state This may be set to an Error state if any error occurred processing them
      * @param[out] ppindex If set, the pointer will be set to point to the last new block index object for the given headers
+     * @param[in]  pow_hashes If set, the proof-of-work hash of each header, as returned by HasValidProofOfWork
      */
-    bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex = nullptr) LOCKS_EXCLUDED(cs_main);
+    bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex = nullptr, const std::vector<uint256>* pow_hashes = nullptr) LOCKS_EXCLUDED(cs_main);
 
     /**
      * Sufficiently validate a block for disk storage (and store on disk).
@@ -1268,6 +1299,8 @@ public:
 
     /** Produce the necessary coinbase commitment for a block (modifies the hash, don't call for mined blocks). */
     std::vector<unsigned char> GenerateCoinbaseCommitment(CBlock& block, const CBlockIndex* pindexPrev) const;
+    /** As above, with the witness merkle root of the block already computed. */
+    std::vector<unsigned char> GenerateCoinbaseCommitment(CBlock& block, const CBlockIndex* pindexPrev, const uint256& witness_root) const;
 
     /** This is used by net_processing to report pre-synchronization progress of headers, as
      *  headers are not yet fed to validation during that time, but validation is (for now)
@@ -1321,6 +1354,7 @@ public:
     std::optional<int> GetSnapshotBaseHeight() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     CCheckQueue<CScriptCheck>& GetCheckQueue() { return m_script_check_queue; }
+    CCheckQueue<CHeaderPoWCheck>& GetPoWCheckQueue() { return m_pow_check_queue; }
 
     ~ChainstateManager();
 };
@@ -189,6 +189,18 @@ class MiningTest(BitcoinTestFramework):
         assert_equal(mining_info['networkhashps'], Decimal('0.003333333333333334'))
         assert_equal(mining_info['pooledtx'], 0)
 
+        self.log.info('getdifficultyhistory')
+        history = node.getdifficultyhistory(nblocks=100, step=10)
+        assert_equal([entry['height'] for entry in history], list(range(110, 201, 10)))
+        for entry in history:
+            header = node.getblockheader(node.getblockhash(entry['height']))
+            assert_equal(entry['time'], header['time'])
+            assert_equal(entry['bits'], header['bits'])
+            assert_equal(entry['chainwork'], header['chainwork'])
+            assert_equal(entry['difficulty'], header['difficulty'])
+            assert_equal(entry['networkhashps'], node.getnetworkhashps(10, entry['height']))
+        assert_raises_rpc_error(-8, "Too many entries requested", node.getdifficultyhistory, 20000)
+
         self.log.info("getblocktemplate: Test default witness commitment")
         txid = int(self.wallet.send_self_transfer(from_node=node)['wtxid'], 16)
         tmpl = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
@@ -210,6 +222,15 @@ class MiningTest(BitcoinTestFramework):
         assert 'proposal' in tmpl['capabilities']
         assert 'coinbasetxn' not in tmpl
 
+        self.log.info("getblocktemplate: Test result reuse for an unchanged template")
+        cache = node.getmininginfo()['templatecache']
+        tmpl_again = node.getblocktemplate(NORMAL_GBT_REQUEST_PARAMS)
+        assert_equal(node.getmininginfo()['templatecache']['hits'], cache['hits'] + 1)
+        tmpl_again['curtime'] = tmpl['curtime']
+        assert_equal(tmpl_again, tmpl)
+        node.getblocktemplate({'rules': ['segwit', 'testdummy']})
+        assert_equal(node.getmininginfo()['templatecache']['misses'], cache['misses'] + 1)
+
         next_height = int(tmpl["height"])
         coinbase_tx = create_coinbase(height=next_height)
         # sequence numbers must not be max for nLockTime to have effect
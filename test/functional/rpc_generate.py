@@ -27,6 +27,12 @@ class RPCGenerateTest(BitcoinTestFramework):
         self.generatetoaddress(self.nodes[0], 1, 'mneYUmWYsuk7kySiURxCi3AGxrAqZxLgPZ')
         assert_raises_rpc_error(-5, "Invalid address", self.generatetoaddress, self.nodes[0], 1, '3J98t1WpEZ73CNmQviecrnyiWrnqRhWNLy')
 
+        self.log.info('Split the nonce search across several threads')
+        hashes = self.generatetoaddress(self.nodes[0], 2, 'mneYUmWYsuk7kySiURxCi3AGxrAqZxLgPZ', maxtries=1000000, threads=4)
+        assert_equal(len(hashes), 2)
+        assert_equal(hashes[-1], self.nodes[0].getbestblockhash())
+        assert_raises_rpc_error(-8, "threads must be between 1 and 64", self.nodes[0].generatetoaddress, 1, 'mneYUmWYsuk7kySiURxCi3AGxrAqZxLgPZ', 1000000, 0)
+
     def test_generateblock(self):
         node = self.nodes[0]
         miniwallet = MiniWallet(node)
@@ -41,6 +41,15 @@ class RpcMiscTest(BitcoinTestFramework):
         assert_greater_than(memory['chunks_used'], 0)
         assert_greater_than(memory['chunks_free'], 0)
         assert_equal(memory['used'] + memory['free'], memory['total'])
+        powcache = node.getmemoryinfo()['powcache']
+        assert_greater_than(powcache['capacity'], 0)
+        assert_greater_than(powcache['usage'], 0)
+        assert_greater_than_or_equal(powcache['capacity'], powcache['entries'])
+
+        self.log.info("test getpowcacheinfo")
+        powcache = node.getpowcacheinfo(compact=True)
+        assert_equal(powcache['file_records'], powcache['entries'])
+        assert_greater_than_or_equal(1, powcache['hit_rate'])
 
         self.log.info("test mallocinfo")
         try: